@@ -0,0 +1,34 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/compressed_set.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> l1 = {0,2,4,6,8,10,300,1000};
+  vector<int> r1 = {0,1,2,3,4,5,300,2000};
+  cout << "left: ";
+  for(auto i: l1) cout << i << " ";
+  cout << endl << "right: ";
+  for(auto i: r1) cout << i << " ";
+  cout << endl;
+  vstl::seq::compressed_set<int> lc1(l1), rc1(r1);
+  cout << "intersection: ";
+  for(auto i: vstl::seq::set_intersection(lc1, rc1)) cout << i << " ";
+  cout << endl << "union: ";
+  for(auto i: vstl::seq::set_union(lc1, rc1)) cout << i << " ";
+  cout << endl;
+
+  auto left = vstl::seq::set_unique(gen_left<int>(argc, argv));
+  auto right = vstl::seq::set_unique(gen_right<int>(argc, argv));
+  auto t1 = vstl::get_dtime();
+  vstl::seq::compressed_set<int> left_set(left), right_set(right);
+  auto t2 = vstl::get_dtime();
+  auto out = vstl::seq::set_intersection(left_set, right_set);
+  auto t3 = vstl::get_dtime();
+  auto size = left.size();
+  cout << "time of " << size << " data: compression " << t2-t1
+       << " sec, intersection " << t3-t2 << " sec" << endl;
+  cout << "memory: " << left.size() * sizeof(int) << " bytes -> "
+       << left_set.memory_size() << " bytes" << endl;
+}
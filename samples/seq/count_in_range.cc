@@ -0,0 +1,33 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/equal_range.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> s1 = {0,2,4,5,5,5,6,8,10};
+  vector<int> l1 = {3,5,9};
+  vector<int> h1 = {5,8,7};
+  cout << "sorted: ";
+  for(auto i: s1) cout << i << " ";
+  cout << endl << "ranges: ";
+  for(size_t i = 0; i < l1.size(); i++)
+    cout << "[" << l1[i] << "," << h1[i] << "] ";
+  cout << endl;
+  auto res = vstl::seq::count_in_range(s1, l1, h1);
+  cout << "count_in_range: " << endl;
+  for(auto i: res) cout << i << " ";
+  cout << endl;
+
+  auto sorted = gen_sorted<int>(argc, argv);
+  auto lows = gen_random2<int>(argc, argv);
+  auto highs = lows;
+  for(size_t i = 0; i < highs.size(); i++) highs[i] += 100;
+  auto t1 = vstl::get_dtime();
+  vstl::seq::count_in_range(sorted, lows, highs);
+  auto t2 = vstl::get_dtime();
+  auto sorted_size = sorted.size();
+  auto range_size = lows.size();
+  cout << "time of " << sorted_size << " sorted data and "
+       << range_size << " ranges: " << t2-t1 << " sec" << endl;
+}
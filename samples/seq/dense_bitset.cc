@@ -0,0 +1,53 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/dense_bitset.hpp>
+#include <vstl/seq/core/set_operations.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> l1 = {0,2,4,6,8,10,70};
+  vector<int> r1 = {0,1,2,3,4,5,70};
+  cout << "left: ";
+  for(auto i: l1) cout << i << " ";
+  cout << endl << "right: ";
+  for(auto i: r1) cout << i << " ";
+  cout << endl;
+  vstl::seq::dense_bitset<int> lb1(l1), rb1(r1);
+  auto i1 = vstl::seq::set_intersection(lb1, rb1);
+  cout << "intersection: ";
+  for(auto i: i1.to_vector()) cout << i << " ";
+  cout << "(count: " << i1.count() << ")" << endl;
+  cout << "union: ";
+  for(auto i: vstl::seq::set_union(lb1, rb1).to_vector()) cout << i << " ";
+  cout << endl << "difference: ";
+  for(auto i: vstl::seq::set_difference(lb1, rb1).to_vector()) cout << i << " ";
+  cout << endl;
+
+  // each input is dense, but the union is not: merged without bitset
+  vector<long> l2(70000), r2(70000);
+  for(size_t i = 0; i < l2.size(); i++) {
+    l2[i] = i;
+    r2[i] = (1L << 46) + i;
+  }
+  auto u2 = vstl::seq::set_union(l2, r2);
+  cout << "union of disjoint dense inputs: " << u2.size()
+       << (u2.size() == 140000 && u2[69999] == 69999 &&
+           u2[70000] == (1L << 46) ? " (ok)" : " (NG)") << endl;
+  // many duplicated values
+  vector<long> d2(70000, 5);
+  auto i2 = vstl::seq::set_intersection(d2, d2);
+  cout << "intersection of duplicated values: " << i2.size()
+       << (i2.size() == 70000 ? " (ok)" : " (NG)") << endl;
+
+  auto left = vstl::seq::set_unique(gen_left<int>(argc, argv));
+  auto right = vstl::seq::set_unique(gen_right<int>(argc, argv));
+  auto t1 = vstl::get_dtime();
+  vstl::seq::dense_bitset<int> left_set(left), right_set(right);
+  auto t2 = vstl::get_dtime();
+  auto out = vstl::seq::set_intersection(left_set, right_set).to_vector();
+  auto t3 = vstl::get_dtime();
+  auto size = left.size();
+  cout << "time of " << size << " data: conversion " << t2-t1
+       << " sec, intersection " << t3-t2 << " sec" << endl;
+}
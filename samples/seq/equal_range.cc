@@ -0,0 +1,31 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/equal_range.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> s1 = {0,2,4,5,5,5,6,8,10};
+  vector<int> f1 = {8,3,5};
+  cout << "sorted: ";
+  for(auto i: s1) cout << i << " ";
+  cout << endl << "to_find: ";
+  for(auto i: f1) cout << i << " ";
+  cout << endl;
+  vector<size_t> lo, hi;
+  vstl::seq::equal_range(s1, f1, lo, hi);
+  cout << "equal_range: " << endl;
+  for(size_t i = 0; i < f1.size(); i++)
+    cout << "[" << lo[i] << "," << hi[i] << ") ";
+  cout << endl;
+
+  auto sorted = gen_sorted<int>(argc, argv);
+  auto to_find = gen_random2<int>(argc, argv);
+  auto t1 = vstl::get_dtime();
+  vstl::seq::equal_range(sorted, to_find, lo, hi);
+  auto t2 = vstl::get_dtime();
+  auto sorted_size = sorted.size();
+  auto to_find_size = to_find.size();
+  cout << "time of " << sorted_size << " sorted data and "
+       << to_find_size << " to find data: " << t2-t1 << " sec" << endl;
+}
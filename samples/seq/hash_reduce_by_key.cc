@@ -0,0 +1,48 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/hash_group.hpp>
+#include <vstl/seq/core/reduce_by_key.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> k1 = {3,1,0,1,2,3};
+  vector<int> v1 = {0,1,2,3,4,5};
+  cout << "key: ";
+  for(auto i: k1) cout << i << " ";
+  cout << endl << "val: ";
+  for(auto i: v1) cout << i << " ";
+  cout << endl;
+  std::vector<int> o1, ov1;
+  vstl::seq::hash_reduce_by_key(k1, v1, o1, ov1);
+  cout << "out key: ";
+  for(auto i: o1) cout << i << " ";
+  cout << endl << "out val: ";
+  for(auto i: ov1) cout << i << " ";
+  cout << endl;
+  vstl::seq::hash_reduce_by_key(k1, v1, o1, ov1, vstl::max<int>(), true);
+  cout << "sorted out key: ";
+  for(auto i: o1) cout << i << " ";
+  cout << endl << "sorted out val (max): ";
+  for(auto i: ov1) cout << i << " ";
+  cout << endl;
+
+  // 1000 groups
+  auto key = gen_random<int>(argc, argv);
+  auto size = key.size();
+  for(size_t i = 0; i < size; i++) key[i] %= 1000;
+  std::vector<int> val(size);
+  auto valp = val.data();
+  for(size_t i = 0; i < size; i++) valp[i] = i;
+  std::vector<int> out, outval;
+  auto t1 = vstl::get_dtime();
+  vstl::seq::hash_reduce_by_key(key, val, out, outval);
+  auto t2 = vstl::get_dtime();
+  vstl::seq::radix_sort(key, val);
+  vstl::seq::reduce_by_key(key, val, out, outval);
+  auto t3 = vstl::get_dtime();
+  cout << "time of " << size << " data with " << out.size() << " groups: "
+       << endl;
+  cout << "hash_reduce_by_key: " << t2-t1 << " sec" << endl;
+  cout << "radix_sort + reduce_by_key: " << t3-t2 << " sec" << endl;
+}
@@ -0,0 +1,46 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/hash_group.hpp>
+#include <vstl/seq/core/set_operations.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+void bench(std::vector<int>& key, size_t distinct) {
+  auto size = key.size();
+  for(size_t i = 0; i < size; i++) key[i] %= distinct;
+  auto t1 = vstl::get_dtime();
+  auto u = vstl::seq::hash_unique(key);
+  auto t2 = vstl::get_dtime();
+  auto idx = vstl::seq::hash_unique_index(key);
+  auto t3 = vstl::get_dtime();
+  auto sorted = key;
+  vstl::seq::radix_sort(sorted);
+  auto s = vstl::seq::set_unique(sorted);
+  auto t4 = vstl::get_dtime();
+  cout << "time of " << size << " data with " << u.size()
+       << " distinct values: " << endl;
+  cout << "hash_unique: " << t2-t1 << " sec, hash_unique_index: "
+       << t3-t2 << " sec, radix_sort + set_unique: " << t4-t3 << " sec"
+       << endl;
+}
+
+int main(int argc, char* argv[]){
+  vector<int> k1 = {4,0,2,4,3,0,5,4};
+  cout << "key: ";
+  for(auto i: k1) cout << i << " ";
+  cout << endl;
+  auto u1 = vstl::seq::hash_unique(k1);
+  cout << "hash_unique: ";
+  for(auto i: u1) cout << i << " ";
+  cout << endl;
+  auto i1 = vstl::seq::hash_unique_index(k1);
+  cout << "hash_unique_index: ";
+  for(auto i: i1) cout << i << " ";
+  cout << endl;
+
+  // high duplication data
+  auto key = gen_random<int>(argc, argv);
+  bench(key, 1000);
+  key = gen_random<int>(argc, argv);
+  bench(key, key.size() / 64);
+}
@@ -42,4 +42,15 @@ int main(int argc, char* argv[]){
        << to_find_size << " to find data: " << endl;
   cout << "creation time: " << t2-t1 << " sec" << endl;
   cout << "find time: " << t3-t2 << " sec" << endl;
+  cout << "memory usage: " << hashtable.memory_usage() << " bytes" << endl;
+
+  // smaller table with more conflicts
+  auto t4 = vstl::get_dtime();
+  vstl::seq::unique_hashtable<int,int> small_hashtable(key,value,0.5);
+  auto t5 = vstl::get_dtime();
+  auto small_found = small_hashtable.lookup(to_find, missed);
+  auto t6 = vstl::get_dtime();
+  cout << "load factor 0.5: creation time: " << t5-t4 << " sec, "
+       << "find time: " << t6-t5 << " sec, memory usage: "
+       << small_hashtable.memory_usage() << " bytes" << endl;
 }
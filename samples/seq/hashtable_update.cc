@@ -0,0 +1,56 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/hashtable.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> k1 = {0,2,4,5,6,8,10};
+  vector<int> v1 = {0,1,2,3,4,5,6};
+  vstl::seq::unique_hashtable<int,int> h1(k1,v1);
+  vector<int> ik = {4,12}, iv = {100,101};
+  vector<int> uk = {2,14}, uv = {200,201};
+  vector<int> ek = {0,12,13};
+  h1.insert(ik,iv); // 4 is not changed
+  h1.upsert(uk,uv); // 2 is changed
+  h1.erase(ek);
+  vector<int> f1 = {0,2,4,12,14};
+  cout << "to_find: ";
+  for(auto i: f1) cout << i << " ";
+  cout << endl;
+  std::vector<size_t> m1;
+  auto r1 = h1.lookup(f1,m1);
+  cout << "found value: " << endl;
+  for(auto i: r1) cout << i << " ";
+  cout << endl;
+  cout << "missed: " << endl;
+  for(auto i: m1) cout << i << " ";
+  cout << endl;
+  cout << "size: " << h1.size() << endl;
+
+  auto key = gen_unique<int>(argc, argv);
+  auto key_size = key.size();
+  std::vector<int> value(key_size);
+  auto valuep = value.data();
+  for(size_t i = 0; i < key_size; i++) valuep[i] = i;
+  // batch of updates: the last 1/64 of the keys are added later
+  size_t batch_size = key_size / 64;
+  size_t base_size = key_size - batch_size;
+  std::vector<int> base_key(key.begin(), key.begin() + base_size);
+  std::vector<int> base_value(value.begin(), value.begin() + base_size);
+  std::vector<int> batch_key(key.begin() + base_size, key.end());
+  std::vector<int> batch_value(value.begin() + base_size, value.end());
+  vstl::seq::unique_hashtable<int,int> hashtable(base_key,base_value);
+  auto t1 = vstl::get_dtime();
+  hashtable.upsert(batch_key,batch_value);
+  auto t2 = vstl::get_dtime();
+  hashtable.erase(batch_key);
+  auto t3 = vstl::get_dtime();
+  vstl::seq::unique_hashtable<int,int> rebuilt(key,value);
+  auto t4 = vstl::get_dtime();
+  cout << "time of " << batch_size << " updates to " << base_size
+       << " key data: " << endl;
+  cout << "upsert time: " << t2-t1 << " sec" << endl;
+  cout << "erase time: " << t3-t2 << " sec" << endl;
+  cout << "rebuild time: " << t4-t3 << " sec" << endl;
+}
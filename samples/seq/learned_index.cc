@@ -0,0 +1,46 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/lower_bound.hpp>
+#include <vstl/seq/core/learned_index.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> s1 = {0,2,4,5,6,8,10};
+  vector<int> f1 = {8,3,5};
+  cout << "sorted: ";
+  for(auto i: s1) cout << i << " ";
+  cout << endl << "to_find: ";
+  for(auto i: f1) cout << i << " ";
+  cout << endl;
+  vstl::seq::learned_index<int> index1(s1);
+  cout << "lower_bound: " << endl;
+  for(auto i: index1.lower_bound(f1)) cout << i << " ";
+  cout << endl;
+
+  // auto-increment like IDs with gaps
+  int pow = argc < 2 ? 20 : atoi(argv[1]);
+  size_t size = size_t(1) << pow;
+  vector<int> sorted(size);
+  int id = 0;
+  for(size_t i = 0; i < size; i++) {
+    id += 1 + (drand48() < 0.1 ? 10 * drand48() : 0);
+    sorted[i] = id;
+  }
+  auto to_find = gen_random2<int>(argc, argv);
+  for(auto& v: to_find) v = static_cast<int>(id * drand48());
+  auto t1 = vstl::get_dtime();
+  vstl::seq::learned_index<int> index(sorted);
+  auto t2 = vstl::get_dtime();
+  auto res = index.lower_bound(to_find);
+  auto t3 = vstl::get_dtime();
+  auto ref = vstl::seq::lower_bound(sorted, to_find);
+  auto t4 = vstl::get_dtime();
+  if(res != ref) cout << "result differs from lower_bound" << endl;
+  auto to_find_size = to_find.size();
+  cout << "time of " << size << " sorted data ("
+       << index.num_segments() << " segments) and "
+       << to_find_size << " to find data: build " << t2-t1
+       << " sec, learned_index " << t3-t2 << " sec, lower_bound "
+       << t4-t3 << " sec" << endl;
+}
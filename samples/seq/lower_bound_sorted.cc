@@ -0,0 +1,33 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/lower_bound.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> s1 = {0,2,4,5,6,8,10};
+  vector<int> f1 = {3,5,8};
+  cout << "sorted: ";
+  for(auto i: s1) cout << i << " ";
+  cout << endl << "to_find (sorted): ";
+  for(auto i: f1) cout << i << " ";
+  cout << endl;
+  auto res = vstl::seq::lower_bound_sorted(s1,f1);
+  cout << "lower_bound_sorted: " << endl;
+  for(auto i: res) cout << i << " ";
+  cout << endl;
+
+  auto sorted = gen_sorted<int>(argc, argv);
+  auto to_find = gen_random2<int>(argc, argv);
+  vstl::seq::radix_sort(to_find);
+  auto t1 = vstl::get_dtime();
+  vstl::seq::lower_bound_sorted(sorted, to_find);
+  auto t2 = vstl::get_dtime();
+  vstl::seq::lower_bound(sorted, to_find);
+  auto t3 = vstl::get_dtime();
+  auto sorted_size = sorted.size();
+  auto to_find_size = to_find.size();
+  cout << "time of " << sorted_size << " sorted data and "
+       << to_find_size << " to find data: lower_bound_sorted " << t2-t1
+       << " sec, lower_bound " << t3-t2 << " sec" << endl;
+}
@@ -0,0 +1,56 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/merge_cursor.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<vector<int>> data = {{0,2,4,6,8,10}, {0,1,2,3,4,5}, {3,7,11}};
+  for(size_t i = 0; i < data.size(); i++) {
+    cout << "source " << i << ": ";
+    for(auto j: data[i]) cout << j << " ";
+    cout << endl;
+  }
+  // each source returns its data in chunks of 2
+  vector<size_t> pos(data.size());
+  vector<vstl::seq::merge_cursor<int>::source_type> sources;
+  for(size_t i = 0; i < data.size(); i++) {
+    sources.push_back([&, i](vector<int>& chunk) {
+        if(pos[i] == data[i].size()) return false;
+        auto end = min(pos[i] + 2, data[i].size());
+        chunk.assign(data[i].begin() + pos[i], data[i].begin() + end);
+        pos[i] = end;
+        return true;
+      });
+  }
+  vstl::seq::merge_cursor<int> cursor(sources, 4);
+  vector<int> batch;
+  while(cursor.next(batch)) {
+    cout << "batch: ";
+    for(auto i: batch) cout << i << " ";
+    cout << endl;
+  }
+
+  auto left = gen_left<int>(argc, argv);
+  auto right = gen_right<int>(argc, argv);
+  vector<vector<int>*> inputs = {&left, &right};
+  size_t chunk_size = 1 << 16;
+  vector<size_t> input_pos(2);
+  vector<vstl::seq::merge_cursor<int>::source_type> input_sources;
+  for(size_t i = 0; i < 2; i++) {
+    input_sources.push_back([&, i](vector<int>& chunk) {
+        auto& in = *inputs[i];
+        if(input_pos[i] == in.size()) return false;
+        auto end = min(input_pos[i] + chunk_size, in.size());
+        chunk.assign(in.begin() + input_pos[i], in.begin() + end);
+        input_pos[i] = end;
+        return true;
+      });
+  }
+  auto t1 = vstl::get_dtime();
+  vstl::seq::merge_cursor<int> input_cursor(input_sources, chunk_size);
+  size_t total = 0;
+  while(input_cursor.next(batch)) total += batch.size();
+  auto t2 = vstl::get_dtime();
+  cout << "time of " << total << " data: " << t2-t1 << " sec" << endl;
+}
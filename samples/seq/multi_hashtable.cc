@@ -0,0 +1,51 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/multi_hashtable.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> k1 = {0,2,4,2,6,4,2};
+  vector<int> v1 = {0,1,2,3,4,5,6};
+  vector<int> f1 = {2,3,4};
+  cout << "key: ";
+  for(auto i: k1) cout << i << " ";
+  cout << endl << "value: ";
+  for(auto i: v1) cout << i << " ";
+  cout << endl << "to_find: ";
+  for(auto i: f1) cout << i << " ";
+  cout << endl;
+  vstl::seq::multi_hashtable<int,int> h1(k1,v1);
+  vector<size_t> i1, m1;
+  vector<int> r1;
+  h1.lookup(f1,i1,r1,m1);
+  cout << "found index: " << endl;
+  for(auto i: i1) cout << i << " ";
+  cout << endl;
+  cout << "found value: " << endl;
+  for(auto i: r1) cout << i << " ";
+  cout << endl;
+  cout << "missed: " << endl;
+  for(auto i: m1) cout << i << " ";
+  cout << endl;
+
+  // each key has 4 values on average
+  auto key = gen_random<int>(argc, argv);
+  auto key_size = key.size();
+  for(size_t i = 0; i < key_size; i++) key[i] /= 4;
+  std::vector<int> value(key_size);
+  auto valuep = value.data();
+  for(size_t i = 0; i < key_size; i++) valuep[i] = i;
+  auto to_find = gen_random2<int>(argc, argv);
+  std::vector<size_t> idx_out;
+  std::vector<int> val_out;
+  auto t1 = vstl::get_dtime();
+  vstl::seq::multi_hashtable<int,int> hashtable(key,value);
+  auto t2 = vstl::get_dtime();
+  hashtable.lookup(to_find, idx_out, val_out);
+  auto t3 = vstl::get_dtime();
+  cout << "time of " << key_size << " key data and "
+       << to_find.size() << " to find data: " << endl;
+  cout << "creation time: " << t2-t1 << " sec, find time: " << t3-t2
+       << " sec, found: " << idx_out.size() << endl;
+}
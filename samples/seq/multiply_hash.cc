@@ -0,0 +1,68 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/hashtable.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+template <class H>
+void bench(const char* name, const vector<int>& key, const vector<int>& value,
+           const vector<int>& to_find) {
+  std::vector<size_t> missed;
+  auto t1 = vstl::get_dtime();
+  vstl::seq::unique_hashtable<int,int,H> hashtable(key,value);
+  auto t2 = vstl::get_dtime();
+  auto found = hashtable.lookup(to_find, missed);
+  auto t3 = vstl::get_dtime();
+  cout << name << ": creation time: " << t2-t1 << " sec ("
+       << key.size() / (t2-t1) / 1e6 << " M keys/sec), find time: "
+       << t3-t2 << " sec (" << to_find.size() / (t3-t2) / 1e6
+       << " M keys/sec), missed: " << missed.size() << endl;
+}
+
+int main(int argc, char* argv[]){
+  vector<int> k1 = {0,2,4,5,6,8,10};
+  vector<int> v1 = {0,1,2,3,4,5,6};
+  vector<int> f1 = {8,3,5};
+  cout << "key: ";
+  for(auto i: k1) cout << i << " ";
+  cout << endl << "value: ";
+  for(auto i: v1) cout << i << " ";
+  cout << endl << "to_find: ";
+  for(auto i: f1) cout << i << " ";
+  cout << endl;
+  vstl::seq::unique_hashtable<int,int,vstl::seq::multiply_hash> h1(k1,v1);
+  std::vector<size_t> m1;
+  auto r1 = h1.lookup(f1,m1);
+  cout << "found value: " << endl;
+  for(auto i: r1) cout << i << " ";
+  cout << endl;
+  cout << "missed: " << endl;
+  for(auto i: m1) cout << i << " ";
+  cout << endl;
+
+  // keys spread over the int range in random order; the sorted dense keys
+  // of gen_unique would favor modulo_hash, which then accesses the table
+  // sequentially without conflict
+  int pow = argc < 2 ? 20 : atoi(argv[1]);
+  std::vector<int> key(size_t(1) << pow);
+  for(auto& k : key) k = std::numeric_limits<int>::max() * drand48();
+  vstl::seq::radix_sort(key);
+  key = vstl::seq::set_unique(key);
+  auto key_size = key.size();
+  for(size_t i = key_size - 1; i > 0; i--) {
+    std::swap(key[i], key[size_t((i + 1) * drand48())]);
+  }
+  std::vector<int> value(key_size);
+  auto valuep = value.data();
+  for(size_t i = 0; i < key_size; i++) valuep[i] = i;
+  // half of them are found
+  std::vector<int> to_find(size_t(1) << (argc < 3 ? 20 : atoi(argv[2])));
+  for(auto& f : to_find) {
+    f = drand48() < 0.5 ? key[size_t(key_size * drand48())] :
+      std::numeric_limits<int>::max() * drand48();
+  }
+  cout << "time of " << key_size << " key data and "
+       << to_find.size() << " to find data: " << endl;
+  bench<vstl::seq::modulo_hash>("modulo_hash", key, value, to_find);
+  bench<vstl::seq::multiply_hash>("multiply_hash", key, value, to_find);
+}
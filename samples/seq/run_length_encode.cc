@@ -0,0 +1,38 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/set_operations.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> k1 = {0,0,2,3,4,4,4,5};
+  cout << "key: ";
+  for(auto i: k1) cout << i << " ";
+  cout << endl;
+  vector<int> uk1;
+  vector<size_t> c1, o1;
+  vstl::seq::run_length_encode(k1, uk1, c1, o1);
+  cout << "unique_keys: ";
+  for(auto i: uk1) cout << i << " ";
+  cout << endl << "counts: ";
+  for(auto i: c1) cout << i << " ";
+  cout << endl << "offsets: ";
+  for(auto i: o1) cout << i << " ";
+  cout << endl;
+  auto d1 = vstl::seq::run_length_decode(uk1, c1);
+  cout << "decoded: ";
+  for(auto i: d1) cout << i << " ";
+  cout << endl;
+
+  auto key = gen_left<int>(argc, argv);
+  vector<int> unique_keys;
+  vector<size_t> counts, offsets;
+  auto t1 = vstl::get_dtime();
+  vstl::seq::run_length_encode(key, unique_keys, counts, offsets);
+  auto t2 = vstl::get_dtime();
+  auto decoded = vstl::seq::run_length_decode(unique_keys, counts);
+  auto t3 = vstl::get_dtime();
+  auto size = key.size();
+  cout << "time of " << size << " data: encode " << t2-t1
+       << " sec, decode " << t3-t2 << " sec" << endl;
+}
@@ -0,0 +1,30 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/set_operations.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> l1 = {0,0,2,4,6,8,10};
+  vector<int> r1 = {0,1,2,3,4,5};
+  cout << "left: ";
+  for(auto i: l1) cout << i << " ";
+  cout << endl << "right: ";
+  for(auto i: r1) cout << i << " ";
+  cout << endl;
+  cout << "count_unique of left: " << vstl::seq::set_count_unique(l1) << endl;
+  cout << "count_intersection: " << vstl::seq::set_count_intersection(l1, r1)
+       << endl;
+
+  auto left = gen_left<int>(argc, argv);
+  auto right = gen_right<int>(argc, argv);
+  auto t1 = vstl::get_dtime();
+  auto count_unique = vstl::seq::set_count_unique(left);
+  auto t2 = vstl::get_dtime();
+  auto count_intersection = vstl::seq::set_count_intersection(left, right);
+  auto t3 = vstl::get_dtime();
+  auto size = left.size();
+  cout << "time of " << size << " data: count_unique " << t2-t1
+       << " sec (" << count_unique << "), count_intersection " << t3-t2
+       << " sec (" << count_intersection << ")" << endl;
+}
@@ -0,0 +1,33 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/set_operations.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> l1 = {0,2,4,6,8,10};
+  vector<int> r1 = {0,1,2,3,4,5};
+  cout << "left: ";
+  for(auto i: l1) cout << i << " ";
+  cout << endl << "right: ";
+  for(auto i: r1) cout << i << " ";
+  cout << endl;
+  std::vector<size_t> lp1, rp1;
+  vstl::seq::set_intersection_index(l1,r1,lp1,rp1);
+  cout << "intersection_index: " << endl;
+  cout << "left position: ";
+  for(auto i: lp1) cout << i << " ";
+  cout << endl;
+  cout << "right position: ";
+  for(auto i: rp1) cout << i << " ";
+  cout << endl;
+
+  auto left = gen_left<int>(argc, argv);
+  auto right = gen_right<int>(argc, argv);
+  auto t1 = vstl::get_dtime();
+  std::vector<size_t> left_pos, right_pos;
+  vstl::seq::set_intersection_index(left, right, left_pos, right_pos);
+  auto t2 = vstl::get_dtime();
+  auto size = left.size();
+  cout << "time of " << size << " data: " << t2-t1 << " sec" << endl;;
+}
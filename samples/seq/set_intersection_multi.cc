@@ -0,0 +1,29 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/set_operations.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<vector<int>> l1 = {{0,2,4,6,8,10}, {0,1,2,3,4,5}, {0,4,8}};
+  for(size_t i = 0; i < l1.size(); i++) {
+    cout << "list " << i << ": ";
+    for(auto j: l1[i]) cout << j << " ";
+    cout << endl;
+  }
+  auto r1 = vstl::seq::set_intersection_multi(l1);
+  cout << "intersection_multi: ";
+  for(auto i: r1) cout << i << " ";
+  cout << endl;
+
+  vector<vector<int>> lists(4);
+  lists[0] = gen_left<int>(argc, argv);
+  lists[1] = gen_right<int>(argc, argv);
+  lists[2] = gen_left<int>(argc, argv);
+  lists[3] = gen_right<int>(argc, argv);
+  auto t1 = vstl::get_dtime();
+  auto out = vstl::seq::set_intersection_multi(lists);
+  auto t2 = vstl::get_dtime();
+  auto size = lists[0].size();
+  cout << "time of 4 x " << size << " data: " << t2-t1 << " sec" << endl;;
+}
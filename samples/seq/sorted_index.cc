@@ -0,0 +1,39 @@
+#include <vstl/common/utility.hpp>
+#include <vstl/seq/core/lower_bound.hpp>
+#include <vstl/seq/core/sorted_index.hpp>
+#include "sample_util.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]){
+  vector<int> s1 = {0,2,4,5,6,8,10};
+  vector<int> f1 = {8,3,5};
+  cout << "sorted: ";
+  for(auto i: s1) cout << i << " ";
+  cout << endl << "to_find: ";
+  for(auto i: f1) cout << i << " ";
+  cout << endl;
+  vstl::seq::sorted_index<int> index1(s1);
+  cout << "lower_bound: " << endl;
+  for(auto i: index1.lower_bound(f1)) cout << i << " ";
+  cout << endl << "upper_bound: " << endl;
+  for(auto i: index1.upper_bound(f1)) cout << i << " ";
+  cout << endl;
+
+  auto sorted = gen_sorted<int>(argc, argv);
+  auto to_find = gen_random2<int>(argc, argv);
+  auto t1 = vstl::get_dtime();
+  vstl::seq::sorted_index<int> index(sorted);
+  auto t2 = vstl::get_dtime();
+  auto res = index.lower_bound(to_find);
+  auto t3 = vstl::get_dtime();
+  auto ref = vstl::seq::lower_bound(sorted, to_find);
+  auto t4 = vstl::get_dtime();
+  if(res != ref) cout << "result differs from lower_bound" << endl;
+  auto sorted_size = sorted.size();
+  auto to_find_size = to_find.size();
+  cout << "time of " << sorted_size << " sorted data and "
+       << to_find_size << " to find data: build " << t2-t1
+       << " sec, sorted_index " << t3-t2 << " sec, lower_bound "
+       << t4-t3 << " sec" << endl;
+}
@@ -0,0 +1,179 @@
+#ifndef BATCHED_SEARCH_HPP
+#define BATCHED_SEARCH_HPP
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstddef>
+
+#if defined(_SX) || defined(__ve__)
+#define BATCHED_SEARCH_VLEN 2048 // not vlen, but better than 256
+#else
+#ifndef BATCHED_SEARCH_VLEN
+#define BATCHED_SEARCH_VLEN 32 // queries searched at the same time
+#endif
+// prefetch only if the data is larger than this (bytes)
+#define BATCHED_SEARCH_PREFETCH_MIN (4 * 1024 * 1024)
+#endif
+
+namespace vstl {
+namespace seq {
+
+// Binary search of multiple values, shared by lower_bound, upper_bound
+// and vector_binary_search. go_right(elm, value) is true if the result
+// is right of elm:
+//   lower_bound: std::less, upper_bound: std::less_equal,
+//   (descending) lower_bound: std::greater, upper_bound: std::greater_equal
+// BATCHED_SEARCH_VLEN queries are searched at the same time; the length
+// is halved without branch, so that all the searches take the same
+// number of iterations. On x86, the next midpoint is prefetched if the
+// data does not fit in the cache and it is on another cache line.
+// https://stackoverflow.com/questions/6443569/implementation-of-c-lower-bound
+template <class T, class C>
+void batched_search(const T* sorted, size_t sorted_size,
+                    const T* to_find, size_t to_find_size,
+                    size_t* ret, C go_right) {
+  if(sorted_size == 0) {
+    for(size_t i = 0; i < to_find_size; i++) ret[i] = 0;
+    return;
+  }
+#if !defined(_SX) && !defined(__ve__)
+  bool prefetch = sorted_size * sizeof(T) > BATCHED_SEARCH_PREFETCH_MIN;
+#endif
+  size_t base[BATCHED_SEARCH_VLEN];
+  T values[BATCHED_SEARCH_VLEN];
+  for(size_t start = 0; start < to_find_size; start += BATCHED_SEARCH_VLEN) {
+    size_t len = std::min(to_find_size - start, size_t(BATCHED_SEARCH_VLEN));
+    for(size_t j = 0; j < len; j++) {
+      base[j] = 0;
+      values[j] = to_find[start + j];
+    }
+    size_t crnt_size = sorted_size;
+    while(crnt_size > 1) {
+      size_t half = crnt_size / 2;
+#if defined(_SX) || defined(__ve__)
+#pragma _NEC ivdep
+      for(size_t j = 0; j < len; j++) {
+        auto mid = base[j] + half;
+        base[j] = go_right(sorted[mid], values[j]) ? mid : base[j];
+      }
+#else
+      size_t next_half = (crnt_size - half) / 2;
+      bool crnt_prefetch = prefetch && next_half * sizeof(T) >= 64;
+      for(size_t j = 0; j < len; j++) {
+        // multiply instead of ?: to avoid branch
+        size_t b = base[j];
+        b += go_right(sorted[b + half], values[j]) * half;
+        if(crnt_prefetch) __builtin_prefetch(sorted + b + next_half);
+        base[j] = b;
+      }
+#endif
+      crnt_size -= half;
+    }
+    for(size_t j = 0; j < len; j++) {
+      ret[start + j] = base[j] + go_right(sorted[base[j]], values[j]);
+    }
+  }
+}
+
+// Two searches of each query in one pass, such as lower_bound of a[i]
+// and upper_bound of b[i] (equal_range, count_in_range). The two
+// cursors are halved by the same length as batched_search. They share
+// the descent: while they are at the same position, the element is
+// loaded once and both policies are applied to it. They split at the
+// level where the policies disagree, e.g. where sorted[mid] equals the
+// value for equal_range. On x86, the element is shared only at the
+// levels where it is prefetched; otherwise the second load hits the
+// cache and is cheaper than the branch.
+template <class T, class CA, class CB>
+void batched_search2(const T* sorted, size_t sorted_size,
+                     const T* a, const T* b, size_t to_find_size,
+                     size_t* ret_a, size_t* ret_b,
+                     CA go_right_a, CB go_right_b) {
+  if(sorted_size == 0) {
+    for(size_t i = 0; i < to_find_size; i++) {
+      ret_a[i] = 0;
+      ret_b[i] = 0;
+    }
+    return;
+  }
+#if !defined(_SX) && !defined(__ve__)
+  bool prefetch = sorted_size * sizeof(T) > BATCHED_SEARCH_PREFETCH_MIN;
+#endif
+  size_t base_a[BATCHED_SEARCH_VLEN];
+  size_t base_b[BATCHED_SEARCH_VLEN];
+  T values_a[BATCHED_SEARCH_VLEN];
+  T values_b[BATCHED_SEARCH_VLEN];
+  for(size_t start = 0; start < to_find_size; start += BATCHED_SEARCH_VLEN) {
+    size_t len = std::min(to_find_size - start, size_t(BATCHED_SEARCH_VLEN));
+    for(size_t j = 0; j < len; j++) {
+      base_a[j] = 0;
+      base_b[j] = 0;
+      values_a[j] = a[start + j];
+      values_b[j] = b[start + j];
+    }
+    size_t crnt_size = sorted_size;
+    while(crnt_size > 1) {
+      size_t half = crnt_size / 2;
+#if defined(_SX) || defined(__ve__)
+#pragma _NEC ivdep
+      for(size_t j = 0; j < len; j++) {
+        auto mid_a = base_a[j] + half;
+        auto mid_b = base_b[j] + half;
+        auto elm_a = sorted[mid_a];
+        auto elm_b = mid_a == mid_b ? elm_a : sorted[mid_b];
+        base_a[j] = go_right_a(elm_a, values_a[j]) ? mid_a : base_a[j];
+        base_b[j] = go_right_b(elm_b, values_b[j]) ? mid_b : base_b[j];
+      }
+#else
+      size_t next_half = (crnt_size - half) / 2;
+      bool crnt_prefetch = prefetch && next_half * sizeof(T) >= 64;
+      if(crnt_prefetch) {
+        for(size_t j = 0; j < len; j++) {
+          size_t ba = base_a[j];
+          size_t bb = base_b[j];
+          T elm_a = sorted[ba + half];
+          T elm_b = ba == bb ? elm_a : sorted[bb + half];
+          ba += go_right_a(elm_a, values_a[j]) * half;
+          bb += go_right_b(elm_b, values_b[j]) * half;
+          __builtin_prefetch(sorted + ba + next_half);
+          if(ba != bb) __builtin_prefetch(sorted + bb + next_half);
+          base_a[j] = ba;
+          base_b[j] = bb;
+        }
+      } else {
+        for(size_t j = 0; j < len; j++) {
+          base_a[j] += go_right_a(sorted[base_a[j] + half], values_a[j]) * half;
+          base_b[j] += go_right_b(sorted[base_b[j] + half], values_b[j]) * half;
+        }
+      }
+#endif
+      crnt_size -= half;
+    }
+    for(size_t j = 0; j < len; j++) {
+      ret_a[start + j] =
+        base_a[j] + go_right_a(sorted[base_a[j]], values_a[j]);
+      ret_b[start + j] =
+        base_b[j] + go_right_b(sorted[base_b[j]], values_b[j]);
+    }
+  }
+}
+
+// exact match: the position of the value if it exists; otherwise a
+// position of a different value. The result is always inside of sorted.
+template <class T>
+void batched_search_exact(const T* sorted, size_t sorted_size,
+                          const T* to_find, size_t to_find_size,
+                          size_t* ret) {
+  batched_search(sorted, sorted_size, to_find, to_find_size, ret,
+                 std::less<T>());
+  if(sorted_size == 0) return;
+  size_t last = sorted_size - 1;
+  for(size_t i = 0; i < to_find_size; i++) {
+    ret[i] = std::min(ret[i], last);
+  }
+}
+
+}
+}
+#endif
@@ -0,0 +1,703 @@
+#ifndef COMPRESSED_SET_HPP
+#define COMPRESSED_SET_HPP
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstddef>
+#include <stdint.h>
+#include "../../common/utility.hpp"
+#include "../core/prefix_sum.hpp"
+#include "../core/lower_bound.hpp"
+#include "../core/set_operations.hpp"
+
+#if defined(_SX) || defined(__ve__)
+#define COMPRESSED_SET_VLEN 256 // blocks processed in parallel
+#endif
+#define COMPRESSED_SET_BLOCK_SIZE 128
+
+namespace vstl {
+namespace seq {
+
+// number of bits to represent x; written without branch to be vectorized
+inline int compressed_set_bit_width(uint64_t x) {
+  int n = 0;
+  int b;
+  b = (x >> 32) != 0; n += b * 32; x >>= b * 32;
+  b = (x >> 16) != 0; n += b * 16; x >>= b * 16;
+  b = (x >> 8) != 0; n += b * 8; x >>= b * 8;
+  b = (x >> 4) != 0; n += b * 4; x >>= b * 4;
+  b = (x >> 2) != 0; n += b * 2; x >>= b * 2;
+  b = (x >> 1) != 0; n += b; x >>= b;
+  return n + static_cast<int>(x);
+}
+
+template <class T> class compressed_set;
+
+template <class T>
+std::vector<T> set_intersection(const compressed_set<T>& left,
+                                const compressed_set<T>& right);
+template <class T>
+std::vector<T> set_union(const compressed_set<T>& left,
+                         const compressed_set<T>& right);
+
+// Sorted set of integers stored as blocks of COMPRESSED_SET_BLOCK_SIZE
+// values. Each block keeps its first value (min) and last value (max);
+// the differences from the previous value are bit-packed with the
+// width of the largest one in the block, so that a block of width b
+// uses 2 * b words. Values should be unique.
+template <class T>
+class compressed_set {
+public:
+  compressed_set() : num_values(0) {}
+  compressed_set(const std::vector<T>& sorted);
+  compressed_set(const T* sortedp, size_t size);
+  std::vector<T> to_vector() const;
+  size_t size() const {return num_values;}
+  size_t num_blocks() const {return block_min.size();}
+  size_t memory_size() const; // in bytes
+  friend std::vector<T> set_intersection<>(const compressed_set<T>& left,
+                                           const compressed_set<T>& right);
+  friend std::vector<T> set_union<>(const compressed_set<T>& left,
+                                    const compressed_set<T>& right);
+private:
+  void build(const T* sortedp, size_t size);
+  size_t block_size(size_t block) const {
+    return block + 1 < block_min.size() ? COMPRESSED_SET_BLOCK_SIZE :
+      num_values - block * COMPRESSED_SET_BLOCK_SIZE;
+  }
+  // block_idxp[i] is written to outp + i * COMPRESSED_SET_BLOCK_SIZE;
+  // the whole block is written even if it is the last partial block
+  void decode(const size_t* block_idxp, size_t num, T* outp) const;
+  // block_idxp[i] is written to outp + destp[i]; the blocks whose
+  // destinations are contiguous are decoded at once (VE set_union)
+  void decode_to(const size_t* block_idxp, const size_t* destp,
+                 size_t num, T* outp) const;
+  size_t num_values;
+  std::vector<T> block_min;
+  std::vector<T> block_max;
+  std::vector<int> block_bits;
+  std::vector<size_t> block_offset; // in words of packed
+  std::vector<uint64_t> packed; // with 2 words of padding
+};
+
+template <class T>
+compressed_set<T>::compressed_set(const std::vector<T>& sorted) :
+  num_values(0) {
+  build(sorted.data(), sorted.size());
+}
+
+template <class T>
+compressed_set<T>::compressed_set(const T* sortedp, size_t size) :
+  num_values(0) {
+  build(sortedp, size);
+}
+
+template <class T>
+size_t compressed_set<T>::memory_size() const {
+  return block_min.size() * (2 * sizeof(T) + sizeof(int) + sizeof(size_t))
+    + packed.size() * sizeof(uint64_t);
+}
+
+template <class T>
+std::vector<T> compressed_set<T>::to_vector() const {
+  size_t num_blocks = block_min.size();
+  std::vector<size_t> block_idx(num_blocks);
+  for(size_t k = 0; k < num_blocks; k++) block_idx[k] = k;
+  std::vector<T> ret(num_blocks * COMPRESSED_SET_BLOCK_SIZE);
+  decode(block_idx.data(), num_blocks, ret.data());
+  ret.resize(num_values);
+  return ret;
+}
+
+#if defined(_SX) || defined(__ve__)
+
+// blocks are assigned to the lanes; each lane writes only to the words
+// of its own block
+template <class T>
+void compressed_set<T>::build(const T* sortedp, size_t size) {
+  num_values = size;
+  size_t num_blocks = ceil_div(size, size_t(COMPRESSED_SET_BLOCK_SIZE));
+  block_min.resize(num_blocks);
+  block_max.resize(num_blocks);
+  block_bits.resize(num_blocks);
+  block_offset.resize(num_blocks);
+  auto minp = block_min.data();
+  auto maxp = block_max.data();
+  auto bitsp = block_bits.data();
+  auto offsetp = block_offset.data();
+  for(size_t k = 0; k < num_blocks; k++) {
+    minp[k] = sortedp[k * COMPRESSED_SET_BLOCK_SIZE];
+    maxp[k] = sortedp[std::min((k + 1) * COMPRESSED_SET_BLOCK_SIZE, size)
+                      - 1];
+  }
+
+  uint64_t delta_or[COMPRESSED_SET_VLEN];
+#pragma _NEC vreg(delta_or)
+  for(size_t k0 = 0; k0 < num_blocks; k0 += COMPRESSED_SET_VLEN) {
+    size_t lanes = std::min(size_t(COMPRESSED_SET_VLEN), num_blocks - k0);
+    for(size_t l = 0; l < lanes; l++) delta_or[l] = 0;
+    for(size_t j = 1; j < COMPRESSED_SET_BLOCK_SIZE; j++) {
+#pragma _NEC ivdep
+      for(size_t l = 0; l < lanes; l++) {
+        size_t idx = (k0 + l) * COMPRESSED_SET_BLOCK_SIZE + j;
+        if(idx < size) {
+          delta_or[l] |= static_cast<uint64_t>(sortedp[idx]) -
+            static_cast<uint64_t>(sortedp[idx - 1]);
+        }
+      }
+    }
+    for(size_t l = 0; l < lanes; l++) {
+      bitsp[k0 + l] = compressed_set_bit_width(delta_or[l]);
+    }
+  }
+
+  std::vector<size_t> num_words(num_blocks), end(num_blocks);
+  auto num_wordsp = num_words.data();
+  auto endp = end.data();
+  for(size_t k = 0; k < num_blocks; k++) {
+    num_wordsp[k] = bitsp[k] * COMPRESSED_SET_BLOCK_SIZE / 64;
+  }
+  prefix_sum(num_wordsp, endp, num_blocks);
+  for(size_t k = 0; k < num_blocks; k++) {
+    offsetp[k] = endp[k] - num_wordsp[k];
+  }
+  size_t total_words = num_blocks == 0 ? 0 : endp[num_blocks - 1];
+  packed.assign(total_words + 2, 0);
+  auto packedp = packed.data();
+
+  size_t bits_vreg[COMPRESSED_SET_VLEN];
+  size_t offset_vreg[COMPRESSED_SET_VLEN];
+#pragma _NEC vreg(bits_vreg)
+#pragma _NEC vreg(offset_vreg)
+  for(size_t k0 = 0; k0 < num_blocks; k0 += COMPRESSED_SET_VLEN) {
+    size_t lanes = std::min(size_t(COMPRESSED_SET_VLEN), num_blocks - k0);
+    for(size_t l = 0; l < lanes; l++) {
+      bits_vreg[l] = bitsp[k0 + l];
+      offset_vreg[l] = offsetp[k0 + l];
+    }
+    for(size_t j = 1; j < COMPRESSED_SET_BLOCK_SIZE; j++) {
+#pragma _NEC ivdep
+      for(size_t l = 0; l < lanes; l++) {
+        size_t idx = (k0 + l) * COMPRESSED_SET_BLOCK_SIZE + j;
+        if(idx < size) {
+          uint64_t d = static_cast<uint64_t>(sortedp[idx]) -
+            static_cast<uint64_t>(sortedp[idx - 1]);
+          // d == 0 is skipped, because the word may belong to another
+          // block if the width is 0
+          if(d != 0) {
+            size_t bitpos = j * bits_vreg[l];
+            size_t w = offset_vreg[l] + (bitpos >> 6);
+            size_t s = bitpos & 63;
+            packedp[w] |= d << s;
+            if(s + bits_vreg[l] > 64) packedp[w + 1] |= d >> (64 - s);
+          }
+        }
+      }
+    }
+  }
+}
+
+template <class T>
+void compressed_set<T>::decode(const size_t* block_idxp, size_t num,
+                               T* outp) const {
+  auto minp = block_min.data();
+  auto bitsp = block_bits.data();
+  auto offsetp = block_offset.data();
+  auto packedp = packed.data();
+  uint64_t current_vreg[COMPRESSED_SET_VLEN];
+  uint64_t mask_vreg[COMPRESSED_SET_VLEN];
+  size_t bits_vreg[COMPRESSED_SET_VLEN];
+  size_t offset_vreg[COMPRESSED_SET_VLEN];
+#pragma _NEC vreg(current_vreg)
+#pragma _NEC vreg(mask_vreg)
+#pragma _NEC vreg(bits_vreg)
+#pragma _NEC vreg(offset_vreg)
+  for(size_t i0 = 0; i0 < num; i0 += COMPRESSED_SET_VLEN) {
+    size_t lanes = std::min(size_t(COMPRESSED_SET_VLEN), num - i0);
+    auto crnt_outp = outp + i0 * COMPRESSED_SET_BLOCK_SIZE;
+    for(size_t l = 0; l < lanes; l++) {
+      auto block = block_idxp[i0 + l];
+      current_vreg[l] = static_cast<uint64_t>(minp[block]);
+      bits_vreg[l] = bitsp[block];
+      offset_vreg[l] = offsetp[block];
+      mask_vreg[l] = bits_vreg[l] == 64 ? ~uint64_t(0) :
+        (uint64_t(1) << bits_vreg[l]) - 1;
+      crnt_outp[l * COMPRESSED_SET_BLOCK_SIZE] = minp[block];
+    }
+    for(size_t j = 1; j < COMPRESSED_SET_BLOCK_SIZE; j++) {
+#pragma _NEC ivdep
+      for(size_t l = 0; l < lanes; l++) {
+        size_t bitpos = j * bits_vreg[l];
+        size_t w = offset_vreg[l] + (bitpos >> 6);
+        size_t s = bitpos & 63;
+        // (x << 1) << (63 - s) is x << (64 - s) that is 0 if s == 0
+        uint64_t d = ((packedp[w] >> s) | ((packedp[w + 1] << 1) << (63 - s)))
+          & mask_vreg[l];
+        current_vreg[l] += d;
+        crnt_outp[l * COMPRESSED_SET_BLOCK_SIZE + j] =
+          static_cast<T>(current_vreg[l]);
+      }
+    }
+  }
+}
+
+template <class T>
+void compressed_set<T>::decode_to(const size_t* block_idxp,
+                                  const size_t* destp, size_t num,
+                                  T* outp) const {
+  size_t num_blocks = block_min.size();
+  bool last_partial =
+    block_size(num_blocks - 1) < COMPRESSED_SET_BLOCK_SIZE;
+  size_t start = 0;
+  while(start < num) {
+    size_t end = start + 1;
+    while(end < num &&
+          destp[end] == destp[end - 1] + COMPRESSED_SET_BLOCK_SIZE) end++;
+    // the last partial block is decoded to a buffer not to overwrite
+    // the data after it
+    size_t full_end = end;
+    if(last_partial && block_idxp[end - 1] == num_blocks - 1) full_end--;
+    decode(block_idxp + start, full_end - start, outp + destp[start]);
+    if(full_end != end) {
+      T buf[COMPRESSED_SET_BLOCK_SIZE];
+      decode(block_idxp + full_end, 1, buf);
+      size_t last_size = block_size(num_blocks - 1);
+      auto crnt_outp = outp + destp[full_end];
+      for(size_t j = 0; j < last_size; j++) crnt_outp[j] = buf[j];
+    }
+    start = end;
+  }
+}
+
+// blocks of left that overlap with any block of right, and the blocks
+// that do not (rest)
+template <class T>
+std::vector<size_t> compressed_set_overlap(const T* left_minp,
+                                           const T* left_maxp,
+                                           size_t left_num_blocks,
+                                           const T* right_minp,
+                                           const T* right_maxp,
+                                           size_t right_num_blocks,
+                                           std::vector<size_t>& rest) {
+  // first block of right whose max is not less than min of left
+  std::vector<size_t> pos(left_num_blocks);
+  auto posp = pos.data();
+  lower_bound(right_maxp, right_num_blocks, left_minp, left_num_blocks,
+              posp);
+  std::vector<size_t> ret(left_num_blocks);
+  rest.resize(left_num_blocks);
+  auto retp = ret.data();
+  auto restp = rest.data();
+  size_t out_idx = 0, rest_idx = 0;
+  for(size_t i = 0; i < left_num_blocks; i++) {
+    if(posp[i] < right_num_blocks && right_minp[posp[i]] <= left_maxp[i])
+      retp[out_idx++] = i;
+    else
+      restp[rest_idx++] = i;
+  }
+  ret.resize(out_idx);
+  rest.resize(rest_idx);
+  return ret;
+}
+
+template <class T>
+std::vector<size_t> compressed_set_overlap(const T* left_minp,
+                                           const T* left_maxp,
+                                           size_t left_num_blocks,
+                                           const T* right_minp,
+                                           const T* right_maxp,
+                                           size_t right_num_blocks) {
+  std::vector<size_t> rest;
+  return compressed_set_overlap(left_minp, left_maxp, left_num_blocks,
+                                right_minp, right_maxp, right_num_blocks,
+                                rest);
+}
+
+// Position in the union of the blocks that do not overlap with the
+// other set (minp: their min); the values before the block are the
+// preceding such blocks of the same set, those of the other set
+// (other_minp), and the merged values of the overlapping blocks.
+// other_pad is the unused part of the last block of other_minp.
+template <class T>
+std::vector<size_t> compressed_set_union_dest(const T* minp, size_t num,
+                                              const T* other_minp,
+                                              size_t other_num,
+                                              size_t other_pad,
+                                              const T* mergedp,
+                                              size_t merged_size) {
+  std::vector<size_t> other_before(num), merged_before(num), dest(num);
+  auto other_beforep = other_before.data();
+  auto merged_beforep = merged_before.data();
+  auto destp = dest.data();
+  lower_bound(other_minp, other_num, minp, num, other_beforep);
+  lower_bound(mergedp, merged_size, minp, num, merged_beforep);
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 0; i < num; i++) {
+    auto ob = other_beforep[i];
+    destp[i] = (i + ob) * COMPRESSED_SET_BLOCK_SIZE -
+      (ob == other_num ? other_pad : 0) + merged_beforep[i];
+  }
+  return dest;
+}
+
+// Only the blocks that overlap with the other set are decoded, and the
+// decoded values are intersected by the vectorized set_intersection.
+template <class T>
+std::vector<T> set_intersection(const compressed_set<T>& left,
+                                const compressed_set<T>& right) {
+  size_t left_num_blocks = left.block_min.size();
+  size_t right_num_blocks = right.block_min.size();
+  if(left_num_blocks == 0 || right_num_blocks == 0) return std::vector<T>();
+  auto left_block = compressed_set_overlap(left.block_min.data(),
+                                           left.block_max.data(),
+                                           left_num_blocks,
+                                           right.block_min.data(),
+                                           right.block_max.data(),
+                                           right_num_blocks);
+  auto right_block = compressed_set_overlap(right.block_min.data(),
+                                            right.block_max.data(),
+                                            right_num_blocks,
+                                            left.block_min.data(),
+                                            left.block_max.data(),
+                                            left_num_blocks);
+  size_t left_size = left_block.size() * COMPRESSED_SET_BLOCK_SIZE;
+  size_t right_size = right_block.size() * COMPRESSED_SET_BLOCK_SIZE;
+  std::vector<T> left_val(left_size), right_val(right_size);
+  left.decode(left_block.data(), left_block.size(), left_val.data());
+  right.decode(right_block.data(), right_block.size(), right_val.data());
+  // only the last block of the set can be partial
+  if(left_block.size() > 0 && left_block.back() == left_num_blocks - 1)
+    left_size -= COMPRESSED_SET_BLOCK_SIZE -
+      left.block_size(left_num_blocks - 1);
+  if(right_block.size() > 0 && right_block.back() == right_num_blocks - 1)
+    right_size -= COMPRESSED_SET_BLOCK_SIZE -
+      right.block_size(right_num_blocks - 1);
+  return set_intersection(left_val.data(), left_size,
+                          right_val.data(), right_size);
+}
+
+// Only the blocks that overlap with the other set are decoded and
+// merged by the vectorized set_union. Other blocks do not contain the
+// values of the other set, so they are decoded directly to their
+// position of the output, and the merged values fill the gaps.
+template <class T>
+std::vector<T> set_union(const compressed_set<T>& left,
+                         const compressed_set<T>& right) {
+  size_t left_num_blocks = left.block_min.size();
+  size_t right_num_blocks = right.block_min.size();
+  if(left_num_blocks == 0) return right.to_vector();
+  if(right_num_blocks == 0) return left.to_vector();
+  std::vector<size_t> left_rest, right_rest;
+  auto left_block = compressed_set_overlap(left.block_min.data(),
+                                           left.block_max.data(),
+                                           left_num_blocks,
+                                           right.block_min.data(),
+                                           right.block_max.data(),
+                                           right_num_blocks,
+                                           left_rest);
+  auto right_block = compressed_set_overlap(right.block_min.data(),
+                                            right.block_max.data(),
+                                            right_num_blocks,
+                                            left.block_min.data(),
+                                            left.block_max.data(),
+                                            left_num_blocks,
+                                            right_rest);
+  size_t left_size = left_block.size() * COMPRESSED_SET_BLOCK_SIZE;
+  size_t right_size = right_block.size() * COMPRESSED_SET_BLOCK_SIZE;
+  std::vector<T> left_val(left_size), right_val(right_size);
+  left.decode(left_block.data(), left_block.size(), left_val.data());
+  right.decode(right_block.data(), right_block.size(), right_val.data());
+  size_t left_pad =
+    COMPRESSED_SET_BLOCK_SIZE - left.block_size(left_num_blocks - 1);
+  size_t right_pad =
+    COMPRESSED_SET_BLOCK_SIZE - right.block_size(right_num_blocks - 1);
+  if(left_block.size() > 0 && left_block.back() == left_num_blocks - 1)
+    left_size -= left_pad;
+  if(right_block.size() > 0 && right_block.back() == right_num_blocks - 1)
+    right_size -= right_pad;
+  auto merged = set_union(left_val.data(), left_size,
+                          right_val.data(), right_size);
+  size_t merged_size = merged.size();
+
+  size_t left_rest_num = left_rest.size();
+  size_t right_rest_num = right_rest.size();
+  std::vector<T> left_rest_min(left_rest_num), right_rest_min(right_rest_num);
+  auto left_minp = left.block_min.data();
+  auto right_minp = right.block_min.data();
+  auto left_restp = left_rest.data();
+  auto right_restp = right_rest.data();
+  auto left_rest_minp = left_rest_min.data();
+  auto right_rest_minp = right_rest_min.data();
+  for(size_t i = 0; i < left_rest_num; i++)
+    left_rest_minp[i] = left_minp[left_restp[i]];
+  for(size_t i = 0; i < right_rest_num; i++)
+    right_rest_minp[i] = right_minp[right_restp[i]];
+  // the last block is not in the rest if it overlaps
+  bool left_rest_last =
+    left_rest_num > 0 && left_restp[left_rest_num - 1] == left_num_blocks - 1;
+  bool right_rest_last = right_rest_num > 0 &&
+    right_restp[right_rest_num - 1] == right_num_blocks - 1;
+  auto left_dest =
+    compressed_set_union_dest(left_rest_minp, left_rest_num,
+                              right_rest_minp, right_rest_num,
+                              right_rest_last ? right_pad : 0,
+                              merged.data(), merged_size);
+  auto right_dest =
+    compressed_set_union_dest(right_rest_minp, right_rest_num,
+                              left_rest_minp, left_rest_num,
+                              left_rest_last ? left_pad : 0,
+                              merged.data(), merged_size);
+  size_t left_rest_size = left.num_values - left_size;
+  size_t right_rest_size = right.num_values - right_size;
+  std::vector<T> ret(left_rest_size + right_rest_size + merged_size);
+  auto retp = ret.data();
+  left.decode_to(left_restp, left_dest.data(), left_rest_num, retp);
+  right.decode_to(right_restp, right_dest.data(), right_rest_num, retp);
+
+  // gaps between the decoded blocks
+  auto mergedp = merged.data();
+  auto left_destp = left_dest.data();
+  auto right_destp = right_dest.data();
+  size_t li = 0, ri = 0, out_idx = 0, merged_idx = 0;
+  while(li < left_rest_num || ri < right_rest_num) {
+    size_t dest, size;
+    if(ri == right_rest_num ||
+       (li < left_rest_num && left_destp[li] < right_destp[ri])) {
+      dest = left_destp[li];
+      size = left.block_size(left_restp[li++]);
+    } else {
+      dest = right_destp[ri];
+      size = right.block_size(right_restp[ri++]);
+    }
+    size_t gap = dest - out_idx;
+    auto crnt_retp = retp + out_idx;
+    auto crnt_mergedp = mergedp + merged_idx;
+    for(size_t j = 0; j < gap; j++) crnt_retp[j] = crnt_mergedp[j];
+    merged_idx += gap;
+    out_idx = dest + size;
+  }
+  auto crnt_retp = retp + out_idx;
+  auto crnt_mergedp = mergedp + merged_idx;
+  for(size_t j = 0; j < merged_size - merged_idx; j++)
+    crnt_retp[j] = crnt_mergedp[j];
+  return ret;
+}
+
+#else
+
+template <class T>
+void compressed_set<T>::build(const T* sortedp, size_t size) {
+  num_values = size;
+  size_t num_blocks = ceil_div(size, size_t(COMPRESSED_SET_BLOCK_SIZE));
+  block_min.resize(num_blocks);
+  block_max.resize(num_blocks);
+  block_bits.resize(num_blocks);
+  block_offset.resize(num_blocks);
+  auto minp = block_min.data();
+  auto maxp = block_max.data();
+  auto bitsp = block_bits.data();
+  auto offsetp = block_offset.data();
+  size_t total_words = 0;
+  for(size_t k = 0; k < num_blocks; k++) {
+    size_t start = k * COMPRESSED_SET_BLOCK_SIZE;
+    size_t end = std::min(start + COMPRESSED_SET_BLOCK_SIZE, size);
+    uint64_t delta_or = 0;
+    for(size_t i = start + 1; i < end; i++) {
+      delta_or |= static_cast<uint64_t>(sortedp[i]) -
+        static_cast<uint64_t>(sortedp[i - 1]);
+    }
+    minp[k] = sortedp[start];
+    maxp[k] = sortedp[end - 1];
+    bitsp[k] = compressed_set_bit_width(delta_or);
+    offsetp[k] = total_words;
+    total_words += bitsp[k] * COMPRESSED_SET_BLOCK_SIZE / 64;
+  }
+  packed.assign(total_words + 2, 0);
+  auto packedp = packed.data();
+  for(size_t k = 0; k < num_blocks; k++) {
+    size_t start = k * COMPRESSED_SET_BLOCK_SIZE;
+    size_t end = std::min(start + COMPRESSED_SET_BLOCK_SIZE, size);
+    size_t bits = bitsp[k];
+    auto wp = packedp + offsetp[k];
+    size_t bitpos = bits;
+    for(size_t i = start + 1; i < end; i++, bitpos += bits) {
+      uint64_t d = static_cast<uint64_t>(sortedp[i]) -
+        static_cast<uint64_t>(sortedp[i - 1]);
+      size_t w = bitpos >> 6;
+      size_t s = bitpos & 63;
+      wp[w] |= d << s;
+      wp[w + 1] |= (d >> 1) >> (63 - s); // d >> (64 - s), 0 if s == 0
+    }
+  }
+}
+
+template <class T>
+void compressed_set<T>::decode(const size_t* block_idxp, size_t num,
+                               T* outp) const {
+  auto minp = block_min.data();
+  auto bitsp = block_bits.data();
+  auto offsetp = block_offset.data();
+  auto packedp = packed.data();
+  for(size_t i = 0; i < num; i++) {
+    auto block = block_idxp[i];
+    size_t bits = bitsp[block];
+    auto wp = packedp + offsetp[block];
+    uint64_t mask = bits == 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+    uint64_t current = static_cast<uint64_t>(minp[block]);
+    auto crnt_outp = outp + i * COMPRESSED_SET_BLOCK_SIZE;
+    crnt_outp[0] = minp[block];
+    size_t bitpos = bits;
+    for(size_t j = 1; j < COMPRESSED_SET_BLOCK_SIZE; j++, bitpos += bits) {
+      size_t w = bitpos >> 6;
+      size_t s = bitpos & 63;
+      current += ((wp[w] >> s) | ((wp[w + 1] << 1) << (63 - s))) & mask;
+      crnt_outp[j] = static_cast<T>(current);
+    }
+  }
+}
+
+// Blocks are decoded one by one when needed, so that the decoded
+// values stay in the cache; blocks that do not overlap are skipped.
+template <class T>
+std::vector<T> set_intersection(const compressed_set<T>& left,
+                                const compressed_set<T>& right) {
+  size_t left_num_blocks = left.block_min.size();
+  size_t right_num_blocks = right.block_min.size();
+  // +1: the branchless loop writes one more data
+  std::vector<T> ret(std::min(left.num_values, right.num_values) + 1);
+  auto retp = ret.data();
+  auto left_minp = left.block_min.data();
+  auto left_maxp = left.block_max.data();
+  auto right_minp = right.block_min.data();
+  auto right_maxp = right.block_max.data();
+  T left_buf[COMPRESSED_SET_BLOCK_SIZE];
+  T right_buf[COMPRESSED_SET_BLOCK_SIZE];
+  size_t left_decoded = left_num_blocks, right_decoded = right_num_blocks;
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  size_t left_pos = 0, right_pos = 0; // position in the current block
+  while(left_idx < left_num_blocks && right_idx < right_num_blocks) {
+    auto left_current = left_pos == 0 ? left_minp[left_idx] :
+      left_buf[left_pos];
+    auto right_current = right_pos == 0 ? right_minp[right_idx] :
+      right_buf[right_pos];
+    if(left_pos == 0 && left_maxp[left_idx] < right_current) {
+      left_idx++;
+    } else if(right_pos == 0 && right_maxp[right_idx] < left_current) {
+      right_idx++;
+    } else {
+      if(left_decoded != left_idx) {
+        left.decode(&left_idx, 1, left_buf);
+        left_decoded = left_idx;
+      }
+      if(right_decoded != right_idx) {
+        right.decode(&right_idx, 1, right_buf);
+        right_decoded = right_idx;
+      }
+      size_t left_size = left.block_size(left_idx);
+      size_t right_size = right.block_size(right_idx);
+      while(left_pos < left_size && right_pos < right_size) {
+        auto leftelm = left_buf[left_pos];
+        auto rightelm = right_buf[right_pos];
+        int left_lt = leftelm < rightelm;
+        int right_lt = rightelm < leftelm;
+        retp[out_idx] = leftelm;
+        out_idx += !(left_lt | right_lt);
+        left_pos += !right_lt;
+        right_pos += !left_lt;
+      }
+      if(left_pos == left_size) {left_idx++; left_pos = 0;}
+      if(right_pos == right_size) {right_idx++; right_pos = 0;}
+    }
+  }
+  ret.resize(out_idx);
+  return ret;
+}
+
+// Blocks that are smaller than the current value of the other set are
+// decoded directly to the output; others are merged.
+template <class T>
+std::vector<T> set_union(const compressed_set<T>& left,
+                         const compressed_set<T>& right) {
+  size_t left_num_blocks = left.block_min.size();
+  size_t right_num_blocks = right.block_min.size();
+  // decode writes the whole block even at the end
+  std::vector<T> ret(left.num_values + right.num_values +
+                     COMPRESSED_SET_BLOCK_SIZE);
+  auto retp = ret.data();
+  auto left_minp = left.block_min.data();
+  auto left_maxp = left.block_max.data();
+  auto right_minp = right.block_min.data();
+  auto right_maxp = right.block_max.data();
+  T left_buf[COMPRESSED_SET_BLOCK_SIZE];
+  T right_buf[COMPRESSED_SET_BLOCK_SIZE];
+  size_t left_decoded = left_num_blocks, right_decoded = right_num_blocks;
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  size_t left_pos = 0, right_pos = 0; // position in the current block
+  while(left_idx < left_num_blocks && right_idx < right_num_blocks) {
+    auto left_current = left_pos == 0 ? left_minp[left_idx] :
+      left_buf[left_pos];
+    auto right_current = right_pos == 0 ? right_minp[right_idx] :
+      right_buf[right_pos];
+    if(left_pos == 0 && left_maxp[left_idx] < right_current) {
+      left.decode(&left_idx, 1, retp + out_idx);
+      out_idx += left.block_size(left_idx++);
+    } else if(right_pos == 0 && right_maxp[right_idx] < left_current) {
+      right.decode(&right_idx, 1, retp + out_idx);
+      out_idx += right.block_size(right_idx++);
+    } else {
+      if(left_decoded != left_idx) {
+        left.decode(&left_idx, 1, left_buf);
+        left_decoded = left_idx;
+      }
+      if(right_decoded != right_idx) {
+        right.decode(&right_idx, 1, right_buf);
+        right_decoded = right_idx;
+      }
+      size_t left_size = left.block_size(left_idx);
+      size_t right_size = right.block_size(right_idx);
+      while(left_pos < left_size && right_pos < right_size) {
+        auto leftelm = left_buf[left_pos];
+        auto rightelm = right_buf[right_pos];
+        int left_lt = leftelm < rightelm;
+        int right_lt = rightelm < leftelm;
+        retp[out_idx++] = right_lt ? rightelm : leftelm;
+        left_pos += !right_lt;
+        right_pos += !left_lt;
+      }
+      if(left_pos == left_size) {left_idx++; left_pos = 0;}
+      if(right_pos == right_size) {right_idx++; right_pos = 0;}
+    }
+  }
+  if(left_pos != 0) {
+    size_t left_size = left.block_size(left_idx);
+    for(; left_pos < left_size; left_pos++) {
+      retp[out_idx++] = left_buf[left_pos];
+    }
+    left_idx++;
+  }
+  for(; left_idx < left_num_blocks; left_idx++) {
+    left.decode(&left_idx, 1, retp + out_idx);
+    out_idx += left.block_size(left_idx);
+  }
+  if(right_pos != 0) {
+    size_t right_size = right.block_size(right_idx);
+    for(; right_pos < right_size; right_pos++) {
+      retp[out_idx++] = right_buf[right_pos];
+    }
+    right_idx++;
+  }
+  for(; right_idx < right_num_blocks; right_idx++) {
+    right.decode(&right_idx, 1, retp + out_idx);
+    out_idx += right.block_size(right_idx);
+  }
+  ret.resize(out_idx);
+  return ret;
+}
+
+#endif // _SX
+
+}
+}
+#endif
@@ -0,0 +1,304 @@
+#ifndef DENSE_BITSET_HPP
+#define DENSE_BITSET_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <stdint.h>
+#include "../../common/utility.hpp"
+#include "../core/lower_bound.hpp"
+#include "../core/prefix_sum.hpp"
+
+#if defined(_SX) || defined(__ve__)
+#define DENSE_BITSET_VLEN 256
+#endif
+
+namespace vstl {
+namespace seq {
+
+// SWAR popcount; vectorizable and no library call
+inline size_t dense_bitset_popcount(uint64_t w) {
+  w = w - ((w >> 1) & 0x5555555555555555ULL);
+  w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+  w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (w * 0x0101010101010101ULL) >> 56;
+}
+
+template <class T> class dense_bitset;
+
+template <class T>
+dense_bitset<T> set_intersection(const dense_bitset<T>& left,
+                                 const dense_bitset<T>& right);
+template <class T>
+dense_bitset<T> set_union(const dense_bitset<T>& left,
+                          const dense_bitset<T>& right);
+template <class T>
+dense_bitset<T> set_difference(const dense_bitset<T>& left,
+                               const dense_bitset<T>& right);
+
+// Set of integers as a bitmap from the first value (rounded down to
+// a multiple of 64) to the last value. Values are handled as uint64_t,
+// so negative values of signed types are also supported.
+template <class T>
+class dense_bitset {
+public:
+  dense_bitset() : base(0) {}
+  dense_bitset(const std::vector<T>& sorted);
+  dense_bitset(const T* sortedp, size_t size);
+  std::vector<T> to_vector() const; // sorted
+  size_t count() const;
+  bool test(T value) const;
+  size_t num_words() const {return words.size();}
+  friend dense_bitset<T> set_intersection<>(const dense_bitset<T>& left,
+                                            const dense_bitset<T>& right);
+  friend dense_bitset<T> set_union<>(const dense_bitset<T>& left,
+                                     const dense_bitset<T>& right);
+  friend dense_bitset<T> set_difference<>(const dense_bitset<T>& left,
+                                          const dense_bitset<T>& right);
+private:
+  void build(const T* sortedp, size_t size);
+  uint64_t base; // value of the first bit; multiple of 64
+  std::vector<uint64_t> words;
+};
+
+template <class T>
+dense_bitset<T>::dense_bitset(const std::vector<T>& sorted) : base(0) {
+  build(sorted.data(), sorted.size());
+}
+
+template <class T>
+dense_bitset<T>::dense_bitset(const T* sortedp, size_t size) : base(0) {
+  build(sortedp, size);
+}
+
+template <class T>
+size_t dense_bitset<T>::count() const {
+  size_t num_words = words.size();
+  auto wordsp = words.data();
+  size_t total = 0;
+  for(size_t i = 0; i < num_words; i++) {
+    total += dense_bitset_popcount(wordsp[i]);
+  }
+  return total;
+}
+
+template <class T>
+bool dense_bitset<T>::test(T value) const {
+  uint64_t off = static_cast<uint64_t>(value) - base;
+  if(off >= words.size() * 64) return false;
+  return (words[off >> 6] >> (off & 63)) & 1;
+}
+
+#if defined(_SX) || defined(__ve__)
+
+// The input is split at word boundaries, so that each lane owns its
+// words and accumulates the current word in a register.
+template <class T>
+void dense_bitset<T>::build(const T* sortedp, size_t size) {
+  if(size == 0) return;
+  base = static_cast<uint64_t>(sortedp[0]) & ~uint64_t(63);
+  size_t num_words = ((static_cast<uint64_t>(sortedp[size-1]) - base) >> 6)
+    + 1;
+  words.resize(num_words);
+  auto wordsp = words.data();
+
+  size_t each = ceil_div(size, size_t(DENSE_BITSET_VLEN));
+  size_t start[DENSE_BITSET_VLEN];
+  size_t stop[DENSE_BITSET_VLEN];
+  T split_value[DENSE_BITSET_VLEN];
+  for(size_t i = 0; i < DENSE_BITSET_VLEN; i++) {
+    size_t pos = std::min(each * i, size - 1);
+    auto v = sortedp[pos];
+    // first value of the word; no underflow since base is not less
+    // than the minimum of T
+    split_value[i] = v - static_cast<T>((static_cast<uint64_t>(v) - base)
+                                        & 63);
+  }
+  lower_bound(sortedp, size, split_value, DENSE_BITSET_VLEN, start);
+  start[0] = 0;
+  for(size_t i = 1; i < DENSE_BITSET_VLEN; i++) {
+    if(each * i >= size) start[i] = size;
+  }
+  for(size_t i = 0; i < DENSE_BITSET_VLEN - 1; i++) stop[i] = start[i+1];
+  stop[DENSE_BITSET_VLEN-1] = size;
+
+  size_t idx_vreg[DENSE_BITSET_VLEN];
+  size_t stop_vreg[DENSE_BITSET_VLEN];
+  size_t word_vreg[DENSE_BITSET_VLEN];
+  uint64_t acc_vreg[DENSE_BITSET_VLEN];
+#pragma _NEC vreg(idx_vreg)
+#pragma _NEC vreg(stop_vreg)
+#pragma _NEC vreg(word_vreg)
+#pragma _NEC vreg(acc_vreg)
+  size_t max_size = 0;
+  for(size_t i = 0; i < DENSE_BITSET_VLEN; i++) {
+    idx_vreg[i] = start[i];
+    stop_vreg[i] = stop[i];
+    acc_vreg[i] = 0;
+    if(start[i] < stop[i])
+      word_vreg[i] = (static_cast<uint64_t>(sortedp[start[i]]) - base) >> 6;
+    else word_vreg[i] = 0;
+    if(stop[i] - start[i] > max_size) max_size = stop[i] - start[i];
+  }
+  for(size_t j = 0; j < max_size; j++) {
+#pragma _NEC ivdep
+    for(size_t i = 0; i < DENSE_BITSET_VLEN; i++) {
+      if(idx_vreg[i] < stop_vreg[i]) {
+        uint64_t off = static_cast<uint64_t>(sortedp[idx_vreg[i]]) - base;
+        size_t w = off >> 6;
+        if(w != word_vreg[i]) {
+          wordsp[word_vreg[i]] = acc_vreg[i];
+          word_vreg[i] = w;
+          acc_vreg[i] = 0;
+        }
+        acc_vreg[i] |= uint64_t(1) << (off & 63);
+        idx_vreg[i]++;
+      }
+    }
+  }
+#pragma _NEC ivdep
+  for(size_t i = 0; i < DENSE_BITSET_VLEN; i++) {
+    if(start[i] < stop[i]) wordsp[word_vreg[i]] = acc_vreg[i];
+  }
+}
+
+// Each word writes its values from the position given by the prefix sum
+// of the popcount; the loop over the bits is outside so that the loop
+// over the words can be vectorized.
+template <class T>
+std::vector<T> dense_bitset<T>::to_vector() const {
+  size_t num_words = words.size();
+  if(num_words == 0) return std::vector<T>();
+  auto wordsp = words.data();
+  std::vector<size_t> count(num_words), end(num_words);
+  auto countp = count.data();
+  auto endp = end.data();
+  for(size_t i = 0; i < num_words; i++) {
+    countp[i] = dense_bitset_popcount(wordsp[i]);
+  }
+  prefix_sum(countp, endp, num_words);
+  size_t total = endp[num_words - 1];
+  std::vector<size_t> out_idx(num_words);
+  auto out_idxp = out_idx.data();
+  for(size_t i = 0; i < num_words; i++) {
+    out_idxp[i] = endp[i] - countp[i];
+  }
+  std::vector<T> ret(total);
+  auto retp = ret.data();
+  for(size_t b = 0; b < 64; b++) {
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < num_words; i++) {
+      if((wordsp[i] >> b) & 1) {
+        retp[out_idxp[i]++] = static_cast<T>(base + i * 64 + b);
+      }
+    }
+  }
+  return ret;
+}
+
+#else
+
+template <class T>
+void dense_bitset<T>::build(const T* sortedp, size_t size) {
+  if(size == 0) return;
+  base = static_cast<uint64_t>(sortedp[0]) & ~uint64_t(63);
+  size_t num_words = ((static_cast<uint64_t>(sortedp[size-1]) - base) >> 6)
+    + 1;
+  words.resize(num_words);
+  auto wordsp = words.data();
+  for(size_t i = 0; i < size; i++) {
+    uint64_t off = static_cast<uint64_t>(sortedp[i]) - base;
+    wordsp[off >> 6] |= uint64_t(1) << (off & 63);
+  }
+}
+
+template <class T>
+std::vector<T> dense_bitset<T>::to_vector() const {
+  size_t num_words = words.size();
+  auto wordsp = words.data();
+  std::vector<T> ret(count());
+  auto retp = ret.data();
+  size_t out_idx = 0;
+  for(size_t i = 0; i < num_words; i++) {
+    auto w = wordsp[i];
+    while(w) {
+      retp[out_idx++] = static_cast<T>(base + i * 64 + __builtin_ctzll(w));
+      w &= w - 1;
+    }
+  }
+  return ret;
+}
+
+#endif // _SX
+
+// Ranges of the two sets are compared as the distance from left.base,
+// which is correct as long as the values fit in int64_t.
+template <class T>
+dense_bitset<T> set_intersection(const dense_bitset<T>& left,
+                                 const dense_bitset<T>& right) {
+  dense_bitset<T> ret;
+  if(left.words.size() == 0 || right.words.size() == 0) return ret;
+  int64_t dist = static_cast<int64_t>(right.base - left.base);
+  int64_t lo = std::max(int64_t(0), dist);
+  int64_t hi = std::min(int64_t(left.words.size() * 64),
+                        dist + int64_t(right.words.size() * 64));
+  if(hi <= lo) return ret;
+  size_t num_words = (hi - lo) / 64;
+  ret.base = left.base + lo;
+  ret.words.resize(num_words);
+  auto retp = ret.words.data();
+  auto leftp = left.words.data() + lo / 64;
+  auto rightp = right.words.data() + (lo - dist) / 64;
+  for(size_t i = 0; i < num_words; i++) {
+    retp[i] = leftp[i] & rightp[i];
+  }
+  return ret;
+}
+
+template <class T>
+dense_bitset<T> set_union(const dense_bitset<T>& left,
+                          const dense_bitset<T>& right) {
+  if(left.words.size() == 0) return right;
+  if(right.words.size() == 0) return left;
+  int64_t dist = static_cast<int64_t>(right.base - left.base);
+  int64_t lo = std::min(int64_t(0), dist);
+  int64_t hi = std::max(int64_t(left.words.size() * 64),
+                        dist + int64_t(right.words.size() * 64));
+  dense_bitset<T> ret;
+  ret.base = left.base + lo;
+  ret.words.resize((hi - lo) / 64);
+  auto retp = ret.words.data();
+  auto ret_leftp = retp + (0 - lo) / 64;
+  auto ret_rightp = retp + (dist - lo) / 64;
+  auto leftp = left.words.data();
+  auto rightp = right.words.data();
+  size_t left_size = left.words.size();
+  size_t right_size = right.words.size();
+  for(size_t i = 0; i < left_size; i++) ret_leftp[i] = leftp[i];
+  for(size_t i = 0; i < right_size; i++) ret_rightp[i] |= rightp[i];
+  return ret;
+}
+
+template <class T>
+dense_bitset<T> set_difference(const dense_bitset<T>& left,
+                               const dense_bitset<T>& right) {
+  dense_bitset<T> ret(left);
+  if(left.words.size() == 0 || right.words.size() == 0) return ret;
+  int64_t dist = static_cast<int64_t>(right.base - left.base);
+  int64_t lo = std::max(int64_t(0), dist);
+  int64_t hi = std::min(int64_t(left.words.size() * 64),
+                        dist + int64_t(right.words.size() * 64));
+  if(hi <= lo) return ret;
+  size_t num_words = (hi - lo) / 64;
+  auto retp = ret.words.data() + lo / 64;
+  auto rightp = right.words.data() + (lo - dist) / 64;
+  for(size_t i = 0; i < num_words; i++) {
+    retp[i] &= ~rightp[i];
+  }
+  return ret;
+}
+
+}
+}
+#endif
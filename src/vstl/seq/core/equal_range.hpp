@@ -0,0 +1,63 @@
+#ifndef EQUAL_RANGE_HPP
+#define EQUAL_RANGE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <functional>
+#include "../core/batched_search.hpp"
+
+namespace vstl {
+namespace seq {
+
+// same as std::equal_range for each value; lo is lower_bound and hi is
+// upper_bound
+template <class T>
+void equal_range(const T* sorted, size_t sorted_size,
+                 const T* to_find, size_t to_find_size,
+                 size_t* lo, size_t* hi) {
+  batched_search2(sorted, sorted_size, to_find, to_find, to_find_size,
+                  lo, hi, std::less<T>(), std::less_equal<T>());
+}
+
+template <class T>
+void equal_range(const std::vector<T>& sorted,
+                 const std::vector<T>& to_find,
+                 std::vector<size_t>& lo,
+                 std::vector<size_t>& hi) {
+  lo.resize(to_find.size());
+  hi.resize(to_find.size());
+  equal_range(sorted.data(), sorted.size(), to_find.data(), to_find.size(),
+              lo.data(), hi.data());
+}
+
+// number of the sorted data in [lows[i], highs[i]] (BETWEEN)
+template <class T>
+void count_in_range(const T* sorted, size_t sorted_size,
+                    const T* lows, const T* highs, size_t size,
+                    size_t* ret) {
+  std::vector<size_t> hi(size);
+  auto hip = hi.data();
+  batched_search2(sorted, sorted_size, lows, highs, size, ret, hip,
+                  std::less<T>(), std::less_equal<T>());
+  for(size_t i = 0; i < size; i++) {
+    ret[i] = hip[i] > ret[i] ? hip[i] - ret[i] : 0;
+  }
+}
+
+template <class T>
+std::vector<size_t> count_in_range(const std::vector<T>& sorted,
+                                   const std::vector<T>& lows,
+                                   const std::vector<T>& highs) {
+  if(lows.size() != highs.size())
+    throw std::runtime_error("count_in_range: size mismatch");
+  std::vector<size_t> ret(lows.size());
+  count_in_range(sorted.data(), sorted.size(), lows.data(), highs.data(),
+                 lows.size(), ret.data());
+  return ret;
+}
+
+}
+}
+#endif
@@ -0,0 +1,428 @@
+#ifndef HASH_GROUP_HPP
+#define HASH_GROUP_HPP
+
+#include <vector>
+#include <limits>
+#include <stdexcept>
+
+#include "../../common/functional.hpp"
+#include "../core/radix_sort.hpp"
+#include "../core/hashtable.hpp"
+
+#if defined(_SX) || defined(__ve__)
+#define HASH_GROUP_VLEN 256
+#else
+#define HASH_GROUP_VLEN 1
+#endif
+#define HASH_GROUP_MAX_LOAD 0.5 // the table grows if it is exceeded
+#define HASH_GROUP_SAMPLE 2048 // number of keys to estimate the groups
+
+namespace vstl {
+namespace seq {
+
+template <class K, class H>
+inline size_t hash_group_slot(const H& hasher, const K& key) {
+  if(sizeof(K) == 4)
+    return hasher(reinterpret_cast<const uint32_t&>(key));
+  else
+    return hasher(reinterpret_cast<const uint64_t&>(key));
+}
+
+// Open addressing table with linear probing from the key to the group
+// id; the slots whose id is max() are empty.
+template <class K, class H>
+struct hash_group_table {
+  void init(size_t num_groups) {
+    table_size = hasher.init(size_t(num_groups / HASH_GROUP_MAX_LOAD) + 1);
+    key.resize(table_size);
+    id.assign(table_size, std::numeric_limits<size_t>::max());
+#if defined(_SX) || defined(__ve__)
+    owner.assign(table_size, std::numeric_limits<size_t>::max());
+#endif
+    max_groups = table_size * HASH_GROUP_MAX_LOAD;
+  }
+  void grow(const std::vector<K>& group_key);
+  H hasher;
+  size_t table_size;
+  size_t max_groups;
+  std::vector<K> key;
+  std::vector<size_t> id;
+#if defined(_SX) || defined(__ve__)
+  std::vector<size_t> owner; // row that claims the empty slot
+#endif
+};
+
+// 4 times larger table, to which the groups are inserted again
+template <class K, class H>
+void hash_group_table<K,H>::grow(const std::vector<K>& group_key) {
+  size_t num_groups = group_key.size();
+  init(num_groups * 4);
+  const size_t EMPTY = std::numeric_limits<size_t>::max();
+  const K* group_keyp = group_key.data();
+  K* keyp = key.data();
+  size_t* idp = id.data();
+  auto hashf = hasher;
+#if defined(_SX) || defined(__ve__)
+  // keys are unique, so only the slots are conflicted
+  size_t* ownerp = owner.data();
+  std::vector<size_t> pend(num_groups), pend_slot(num_groups);
+  std::vector<size_t> next(num_groups), next_slot(num_groups);
+  size_t* pendp = pend.data();
+  size_t* pend_slotp = pend_slot.data();
+  size_t* nextp = next.data();
+  size_t* next_slotp = next_slot.data();
+  for(size_t i = 0; i < num_groups; i++) {
+    pendp[i] = i;
+    pend_slotp[i] = hash_group_slot(hashf, group_keyp[i]);
+  }
+  size_t pend_size = num_groups;
+  size_t ts = table_size;
+  while(pend_size > 0) {
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t j = 0; j < pend_size; j++) {
+      auto s = pend_slotp[j];
+      if(idp[s] == EMPTY) ownerp[s] = pendp[j];
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t j = 0; j < pend_size; j++) {
+      auto s = pend_slotp[j];
+      if(idp[s] == EMPTY && ownerp[s] == pendp[j]) {
+        keyp[s] = group_keyp[pendp[j]];
+        idp[s] = pendp[j];
+      }
+    }
+    size_t next_size = 0;
+    for(size_t j = 0; j < pend_size; j++) {
+      auto s = pend_slotp[j];
+      if(idp[s] != pendp[j]) {
+        nextp[next_size] = pendp[j];
+        next_slotp[next_size++] = s + 1 == ts ? 0 : s + 1;
+      }
+    }
+    std::swap(pendp, nextp);
+    std::swap(pend_slotp, next_slotp);
+    pend_size = next_size;
+  }
+#else
+  for(size_t i = 0; i < num_groups; i++) {
+    size_t s = hash_group_slot(hashf, group_keyp[i]);
+    while(idp[s] != EMPTY) if(++s == table_size) s = 0;
+    keyp[s] = group_keyp[i];
+    idp[s] = i;
+  }
+#endif
+}
+
+template <bool STORE_ID, class K, class H>
+void hash_group_id_helper(const K* keyp, size_t size, size_t* group_idp,
+                          std::vector<K>& group_key,
+                          std::vector<size_t>& group_row,
+                          hash_group_table<K,H>& table) {
+  const size_t EMPTY = std::numeric_limits<size_t>::max();
+#if defined(_SX) || defined(__ve__)
+  // rows claim the empty slots; the winner of each slot creates the
+  // group, and the other rows are resolved if they have the same key,
+  // or move to the next slot
+  std::vector<size_t> pend(size), pend_slot(size);
+  std::vector<size_t> next(size), next_slot(size), win(size);
+  size_t* pendp = pend.data();
+  size_t* pend_slotp = pend_slot.data();
+  size_t* nextp = next.data();
+  size_t* next_slotp = next_slot.data();
+  size_t* winp = win.data();
+  auto hashf = table.hasher;
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 0; i < size; i++) {
+    pendp[i] = i;
+    pend_slotp[i] = hash_group_slot(hashf, keyp[i]);
+  }
+  size_t pend_size = size;
+  while(pend_size > 0) {
+    K* table_keyp = table.key.data();
+    size_t* table_idp = table.id.data();
+    size_t* ownerp = table.owner.data();
+    size_t ts = table.table_size;
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t j = 0; j < pend_size; j++) {
+      auto s = pend_slotp[j];
+      if(table_idp[s] == EMPTY) ownerp[s] = pendp[j];
+    }
+    size_t win_size = 0;
+    for(size_t j = 0; j < pend_size; j++) {
+      auto s = pend_slotp[j];
+      if(table_idp[s] == EMPTY && ownerp[s] == pendp[j]) winp[win_size++] = j;
+    }
+    size_t num_groups = group_key.size();
+    group_key.resize(num_groups + win_size);
+    group_row.resize(num_groups + win_size);
+    K* group_keyp = group_key.data();
+    size_t* group_rowp = group_row.data();
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t j = 0; j < win_size; j++) {
+      auto row = pendp[winp[j]];
+      auto s = pend_slotp[winp[j]];
+      table_keyp[s] = keyp[row];
+      table_idp[s] = num_groups + j;
+      group_keyp[num_groups + j] = keyp[row];
+      group_rowp[num_groups + j] = row;
+    }
+    // winners are checked by owner, since NaN is not equal to itself
+    size_t next_size = 0;
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t j = 0; j < pend_size; j++) {
+      auto row = pendp[j];
+      auto s = pend_slotp[j];
+      if(ownerp[s] == row || table_keyp[s] == keyp[row]) {
+        if(STORE_ID) group_idp[row] = table_idp[s];
+      } else {
+        nextp[next_size] = row;
+        next_slotp[next_size++] = s + 1 == ts ? 0 : s + 1;
+      }
+    }
+    std::swap(pendp, nextp);
+    std::swap(pend_slotp, next_slotp);
+    pend_size = next_size;
+    if(group_key.size() > table.max_groups) {
+      table.grow(group_key);
+      hashf = table.hasher;
+#pragma cdir nodep
+#pragma _NEC ivdep
+      for(size_t j = 0; j < pend_size; j++) {
+        pend_slotp[j] = hash_group_slot(hashf, keyp[pendp[j]]);
+      }
+    }
+  }
+#else
+  K* table_keyp = table.key.data();
+  size_t* table_idp = table.id.data();
+  size_t ts = table.table_size;
+  for(size_t i = 0; i < size; i++) {
+    K k = keyp[i];
+    size_t s = hash_group_slot(table.hasher, k);
+    while(true) {
+      size_t id = table_idp[s];
+      if(id == EMPTY) {
+        id = group_key.size();
+        table_keyp[s] = k;
+        table_idp[s] = id;
+        group_key.push_back(k);
+        group_row.push_back(i);
+        if(id + 1 > table.max_groups) {
+          table.grow(group_key);
+          table_keyp = table.key.data();
+          table_idp = table.id.data();
+          ts = table.table_size;
+        }
+        if(STORE_ID) group_idp[i] = id;
+        break;
+      } else if(table_keyp[s] == k) {
+        if(STORE_ID) group_idp[i] = id;
+        break;
+      }
+      if(++s == ts) s = 0;
+    }
+  }
+#endif
+}
+
+// The table is sized by the groups of a sample of the keys, and grows
+// if needed. group_idp is not used if STORE_ID is false.
+template <bool STORE_ID, class K, class H>
+void hash_group_impl(const K* keyp, size_t size, size_t* group_idp,
+                     std::vector<K>& group_key,
+                     std::vector<size_t>& group_row) {
+  if(sizeof(K) != 4 && sizeof(K) != 8)
+    throw std::runtime_error("hash_group: size of the key should be 4 or 8");
+  group_key.clear();
+  group_row.clear();
+  if(size == 0) return;
+  hash_group_table<K,H> table;
+  if(size <= HASH_GROUP_SAMPLE) {
+    table.init(size);
+    hash_group_id_helper<STORE_ID>(keyp, size, group_idp, group_key,
+                                   group_row, table);
+    return;
+  }
+  size_t sample_size = HASH_GROUP_SAMPLE;
+  table.init(sample_size);
+  std::vector<K> sample(sample_size);
+  K* samplep = sample.data();
+  size_t stride = size / sample_size;
+  for(size_t i = 0; i < sample_size; i++) samplep[i] = keyp[i * stride];
+  hash_group_id_helper<false>(samplep, sample_size, group_idp,
+                              group_key, group_row, table);
+  // if the sample is mostly unique, the groups increase with the keys
+  size_t sample_groups = group_key.size();
+  size_t estimate = sample_groups < sample_size / 2 ? sample_groups * 2 :
+    size_t(double(sample_groups) * size / sample_size);
+  group_key.clear();
+  group_row.clear();
+  table.init(std::max(estimate, size_t(16)));
+  hash_group_id_helper<STORE_ID>(keyp, size, group_idp, group_key,
+                                 group_row, table);
+}
+
+// Group id of each key of unsorted input. The ids are 0, 1, ...;
+// group_key is the key of each group, and group_row is the row that
+// created the group (the first occurrence on x86).
+template <class K, class H = modulo_hash>
+std::vector<size_t> hash_group_id(const std::vector<K>& key,
+                                  std::vector<K>& group_key,
+                                  std::vector<size_t>& group_row) {
+  std::vector<size_t> group_id(key.size());
+  hash_group_impl<true,K,H>(key.data(), key.size(), group_id.data(),
+                            group_key, group_row);
+  return group_id;
+}
+
+// Reduces the values of each group by func into outp[group id].
+// Each of HASH_GROUP_VLEN lanes has its own accumulators, which are
+// merged at the end. If the groups are too many for that, groups of a
+// vector are updated by rounds: the rows that write their index to the
+// group and read it back update the group at the same time.
+template <class V, class F>
+void hash_group_reduce(const size_t* group_idp, const V* valp, size_t size,
+                       size_t num_groups, V* outp, F func) {
+  if(num_groups == 0) return;
+#if defined(_SX) || defined(__ve__)
+  if(num_groups * HASH_GROUP_VLEN > size) {
+    std::vector<V> acc(num_groups);
+    std::vector<int> has(num_groups);
+    std::vector<size_t> owner(num_groups);
+    V* accp = acc.data();
+    int* hasp = has.data();
+    size_t* ownerp = owner.data();
+    size_t pend[HASH_GROUP_VLEN], next[HASH_GROUP_VLEN], win[HASH_GROUP_VLEN];
+    for(size_t start = 0; start < size; start += HASH_GROUP_VLEN) {
+      size_t len = std::min(size - start, size_t(HASH_GROUP_VLEN));
+      for(size_t j = 0; j < len; j++) pend[j] = start + j;
+      size_t pend_size = len;
+      while(pend_size > 0) {
+#pragma cdir nodep
+#pragma _NEC ivdep
+        for(size_t j = 0; j < pend_size; j++) {
+          ownerp[group_idp[pend[j]]] = pend[j];
+        }
+        size_t win_size = 0, next_size = 0;
+        for(size_t j = 0; j < pend_size; j++) {
+          if(ownerp[group_idp[pend[j]]] == pend[j]) win[win_size++] = pend[j];
+          else next[next_size++] = pend[j];
+        }
+#pragma cdir nodep
+#pragma _NEC ivdep
+        for(size_t j = 0; j < win_size; j++) {
+          auto g = group_idp[win[j]];
+          accp[g] = hasp[g] ? func(accp[g], valp[win[j]]) : valp[win[j]];
+          hasp[g] = 1;
+        }
+        for(size_t j = 0; j < next_size; j++) pend[j] = next[j];
+        pend_size = next_size;
+      }
+    }
+    for(size_t g = 0; g < num_groups; g++) outp[g] = accp[g];
+    return;
+  }
+#endif
+  std::vector<V> acc(HASH_GROUP_VLEN * num_groups);
+  std::vector<int> has(HASH_GROUP_VLEN * num_groups);
+  V* accp = acc.data();
+  int* hasp = has.data();
+  size_t each = size / HASH_GROUP_VLEN;
+  for(size_t r = 0; r < each; r++) {
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t j = 0; j < HASH_GROUP_VLEN; j++) {
+      size_t i = each * j + r;
+      size_t p = num_groups * j + group_idp[i];
+      accp[p] = hasp[p] ? func(accp[p], valp[i]) : valp[i];
+      hasp[p] = 1;
+    }
+  }
+  for(size_t i = each * HASH_GROUP_VLEN; i < size; i++) {
+    size_t p = group_idp[i];
+    accp[p] = hasp[p] ? func(accp[p], valp[i]) : valp[i];
+    hasp[p] = 1;
+  }
+  std::vector<int> out_has(num_groups);
+  int* out_hasp = out_has.data();
+  for(size_t j = 0; j < HASH_GROUP_VLEN; j++) {
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t g = 0; g < num_groups; g++) {
+      size_t p = num_groups * j + g;
+      if(hasp[p]) {
+        outp[g] = out_hasp[g] ? func(outp[g], accp[p]) : accp[p];
+        out_hasp[g] = 1;
+      }
+    }
+  }
+}
+
+// reduce_by_key for unsorted keys; the order of outkey is the order
+// the groups are found, unless sorted_output is true
+template <class K, class V, class H = modulo_hash, class F>
+void hash_reduce_by_key(const std::vector<K>& key, const std::vector<V>& val,
+                        std::vector<K>& outkey, std::vector<V>& outval,
+                        F func, bool sorted_output = false) {
+  size_t size = key.size();
+  if(val.size() != size)
+    throw std::runtime_error("sizes of key and value are different");
+  std::vector<size_t> group_row;
+  auto group_id = hash_group_id<K,H>(key, outkey, group_row);
+  size_t num_groups = outkey.size();
+  outval.resize(num_groups);
+  hash_group_reduce(group_id.data(), val.data(), size, num_groups,
+                    outval.data(), func);
+  if(sorted_output) radix_sort(outkey, outval);
+}
+
+template <class K, class V, class H = modulo_hash>
+void hash_reduce_by_key(const std::vector<K>& key, const std::vector<V>& val,
+                        std::vector<K>& outkey, std::vector<V>& outval) {
+  hash_reduce_by_key<K,V,H>(key, val, outkey, outval, vstl::plus<V>());
+}
+
+// distinct keys of unsorted input, in the order they are found unless
+// sorted_output is true
+template <class K, class H = modulo_hash>
+std::vector<K> hash_unique(const std::vector<K>& key,
+                           bool sorted_output = false) {
+  std::vector<K> group_key;
+  std::vector<size_t> group_row;
+  hash_group_impl<false,K,H>(key.data(), key.size(), 0,
+                             group_key, group_row);
+  if(sorted_output) radix_sort(group_key);
+  return group_key;
+}
+
+// position of the first occurrence of each distinct key, in ascending order
+template <class K, class H = modulo_hash>
+std::vector<size_t> hash_unique_index(const std::vector<K>& key) {
+  std::vector<K> group_key;
+  std::vector<size_t> group_row;
+#if defined(_SX) || defined(__ve__)
+  // the row that created the group is not always the first one
+  size_t size = key.size();
+  auto group_id = hash_group_id<K,H>(key, group_key, group_row);
+  std::vector<size_t> row(size);
+  size_t* rowp = row.data();
+  for(size_t i = 0; i < size; i++) rowp[i] = i;
+  hash_group_reduce(group_id.data(), rowp, size, group_row.size(),
+                    group_row.data(), vstl::min<size_t>());
+  radix_sort(group_row);
+#else
+  hash_group_impl<false,K,H>(key.data(), key.size(), 0,
+                             group_key, group_row);
+#endif
+  return group_row;
+}
+
+}
+}
+#endif
@@ -4,18 +4,24 @@
 #include <vector>
 #include <utility>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 
 #include "../core/set_operations.hpp"
 #include "../core/radix_sort.hpp"
+#include "../core/batched_search.hpp"
 
 #if defined(_SX) || defined(__ve__) // might be used in x86
 #define UNIQUE_HASH_VLEN 256
-#define VECTOR_BINARY_SEARCH_VLEN 2048
 #else
 #define UNIQUE_HASH_VLEN 1
-#define VECTOR_BINARY_SEARCH_VLEN 1
 #endif
-#define HASH_TABLE_SIZE_MULT 5
+#define HASH_TABLE_SIZE_MULT 5 // default table size / number of keys
+// number of slots probed before the conflict area; 1 disables probing,
+// which is usually faster on x86 since the conflict area is small
+#ifndef UNIQUE_HASH_PROBE
+#define UNIQUE_HASH_PROBE 1
+#endif
 
 namespace vstl {
 namespace seq {
@@ -34,58 +40,8 @@ std::vector<size_t> vector_binary_search(std::vector<T>& sorted,
     throw std::runtime_error("zero sized vector is not supported");
 
   std::vector<size_t> ret(num_values);
-  //range identifier for each value
-  size_t leftp[VECTOR_BINARY_SEARCH_VLEN];
-//#pragma _NEC vreg(leftp)
-  size_t rightp[VECTOR_BINARY_SEARCH_VLEN];
-//#pragma _NEC vreg(rightp)
-  int is_finishedp[VECTOR_BINARY_SEARCH_VLEN];
-//#pragma _NEC vreg(is_finishedp)
-  auto* sortedp = &sorted[0];
-
-  size_t block_size = num_values / VECTOR_BINARY_SEARCH_VLEN;
-  size_t remain = num_values % VECTOR_BINARY_SEARCH_VLEN;
-
-  for(size_t i = 0; i < block_size + 1; i++) {
-    size_t offset = i * VECTOR_BINARY_SEARCH_VLEN;
-    auto* retp = &ret[0] + offset;
-    size_t len = i < block_size ? VECTOR_BINARY_SEARCH_VLEN : remain;
-    auto* valuesp_tmp = &values[0] + offset;
-    T valuesp[VECTOR_BINARY_SEARCH_VLEN];
-//#pragma _NEC vreg(valuesp)
-    for(size_t j = 0; j < len; j++) {
-      leftp[j] = 0;
-      rightp[j] = num_elem - 1;
-      is_finishedp[j] = 0;
-      valuesp[j] = valuesp_tmp[j]; 
-    }
-    bool is_finished_all = 0;
-    while(is_finished_all == 0){
-      for(size_t j = 0; j < len; j++){
-        if(is_finishedp[j] == 0 && leftp[j] != rightp[j]) {
-          size_t mid = (leftp[j] + rightp[j])/2;
-          if(valuesp[j] < sortedp[mid]) {
-            rightp[j] = mid;
-          } else if(valuesp[j] > sortedp[mid]) {
-            leftp[j] = mid + 1;
-          } else { // equal
-            retp[j] = mid;
-            is_finishedp[j] = 1;
-          }
-        } else if(is_finishedp[j] == 0 && leftp[j] == rightp[j]) {
-          retp[j] = leftp[j];
-          is_finishedp[j] = 1;
-        }          
-      }
-      is_finished_all = 1;
-      for(size_t k = 0; k < len; k++){
-        if(is_finishedp[k] == 0) {
-          is_finished_all = 0;
-          break;
-        }
-      }
-    }
-  }
+  batched_search_exact(sorted.data(), num_elem, values.data(), num_values,
+                       ret.data());
   return ret;
 }
 
@@ -117,20 +73,165 @@ size_t myhash(const float& key, size_t size) {
   return ukey % size;
 }
 
+// Linear probing from the home slot on x86, in the same pass as the
+// home slot whose cache line is loaded. It stops at the key, at an empty
+// slot, or at the end of the probing window.
+template <class K>
+inline size_t probe_slot(const K* table_keyp, K empty,
+                         size_t slot, const K& key) {
+  size_t end = slot + UNIQUE_HASH_PROBE - 1;
+  while(slot < end && table_keyp[slot] != empty && table_keyp[slot] != key)
+    slot++;
+  return slot;
+}
+
+// Two values that are not in the keys, which mark the empty and the
+// erased slots of unique_hashtable instead of an occupancy array.
+// Usually max() and lowest() are not used; otherwise values in gaps
+// of the sorted keys are taken.
+template <class K>
+void find_unused_keys(const K* keyp, size_t size, K& empty, K& deleted) {
+  K cand[] = {std::numeric_limits<K>::max(),
+              std::numeric_limits<K>::lowest(), K()};
+  int used0 = false, used1 = false, used2 = false;
+  for(size_t i = 0; i < size; i++) {
+    used0 |= (keyp[i] == cand[0]);
+    used1 |= (keyp[i] == cand[1]);
+    used2 |= (keyp[i] == cand[2]);
+  }
+  int used[] = {used0, used1, used2};
+  std::vector<K> unused;
+  for(size_t c = 0; c < 3; c++) { // lowest() and K() are same if unsigned
+    if(!used[c] && (unused.size() == 0 || unused[0] != cand[c]))
+      unused.push_back(cand[c]);
+  }
+  if(unused.size() < 2) {
+    std::vector<K> sorted(keyp, keyp + size);
+    radix_sort(sorted);
+    auto sortedp = sorted.data();
+    for(size_t i = 0; i < size && unused.size() < 2; i++) {
+      K next = i + 1 < size ? sortedp[i + 1] : std::numeric_limits<K>::max();
+      if(!(sortedp[i] < next)) continue;
+      K c = std::numeric_limits<K>::is_integer ? K(sortedp[i] + 1) :
+        K(sortedp[i] / 2 + next / 2);
+      if(sortedp[i] < c && c < next &&
+         (unused.size() == 0 || unused[0] != c)) unused.push_back(c);
+    }
+  }
+  if(unused.size() < 2)
+    throw std::runtime_error("unique_hashtable: no value is left for empty slots");
+  empty = unused[0];
+  deleted = unused[1];
+}
+
+// Hashing policies of unique_hashtable: init(target) decides the table
+// size that is not less than target and returns it; operator() maps
+// the key (as unsigned integer) into [0, table size).
+
+// prime table size and key % size
+struct modulo_hash {
+  modulo_hash() : size(0) {}
+  size_t init(size_t target) {
+    // http://d.hatena.ne.jp/zariganitosh/20090716/1247709137
+    // http://tools.m-bsys.com/calculators/prime_number_generator.php
+    long long primes[] = { // should be 64bit
+      8 + 3,
+      16 + 3,
+      32 + 5,
+      64 + 3,
+      128 + 3,
+      256 + 27,
+      512 + 9,
+      1024 + 9,
+      2048 + 5,
+      4096 + 3,
+      8192 + 27,
+      16384 + 43,
+      32768 + 3,
+      65536 + 45,
+      131072 + 29,
+      262144 + 3,
+      524288 + 21,
+      1048576 + 7,
+      2097152 + 17,
+      4194304 + 15,
+      8388608 + 9,
+      16777216 + 43,
+      33554432 + 35,
+      67108864 + 15,
+      134217728 + 29,
+      268435456 + 3,
+      536870912 + 11,
+      1073741824 + 85,
+      2147483648 + 11,
+      4294967296 + 15,
+      8589934592 + 17,
+      17179869184 + 25,
+      34359738368 + 53, // 32GB, primes + 32
+    };
+    auto* size_candp =
+      std::lower_bound(primes, primes + 33, (long long)target);
+    if(size_candp == primes + 33)
+      throw std::runtime_error("unique_hash_table: requested size too large");
+    size = *size_candp;
+    return size;
+  }
+  size_t operator()(uint64_t ukey) const {return ukey % size;}
+  size_t size;
+};
+
+// power of two table size and Fibonacci hashing, which takes the upper
+// bits of key * (2^64 / golden ratio); no division is needed
+struct multiply_hash {
+  multiply_hash() : shift(63) {}
+  size_t init(size_t target) {
+    if(target > (size_t(1) << 36))
+      throw std::runtime_error("unique_hash_table: requested size too large");
+    size_t size = 16;
+    shift = 60;
+    while(size < target) {size <<= 1; shift--;}
+    return size;
+  }
+  size_t operator()(uint64_t ukey) const {
+    return (ukey * 11400714819323198485ULL) >> shift;
+  }
+  int shift;
+};
+
 // TODO: create non SX version? (used directly in dfcolumn.hpp)
-template <class K, class V>
+// H is the hashing policy; modulo_hash or multiply_hash
+template <class K, class V, class H = modulo_hash>
 class unique_hashtable {
 public:
-  unique_hashtable(){} // required to return from map
-  unique_hashtable(const std::vector<K>& k, const std::vector<V>& v);
+  unique_hashtable() : empty_key(), deleted_key(), num_keys(0),
+                       num_deleted(0),
+                       max_load(1.0 / HASH_TABLE_SIZE_MULT) {}
+  // required to return from map
+  // load_factor: number of keys / table size, in (0, 1]
+  unique_hashtable(const std::vector<K>& k, const std::vector<V>& v,
+                   double load_factor = 1.0 / HASH_TABLE_SIZE_MULT);
   // for creating set (used hash join), accept duplicated keys
-  unique_hashtable(const std::vector<K>& k); 
+  unique_hashtable(const std::vector<K>& k,
+                   double load_factor = 1.0 / HASH_TABLE_SIZE_MULT);
   unique_hashtable(const std::vector<K>& k, const std::vector<V>& v,
-                   int& is_unique_ok); // check uniqueness
+                   int& is_unique_ok, // check uniqueness
+                   double load_factor = 1.0 / HASH_TABLE_SIZE_MULT);
   std::vector<K> all_keys(); // used for hash_join
   std::vector<V> lookup(const std::vector<K>& k);
   std::vector<V> lookup(const std::vector<K>& k, std::vector<size_t>& miss);
   std::vector<int> check_existence(const std::vector<K>& k);
+  // batched update; the keys in a batch should be unique. insert does
+  // not change the value of existing keys, while upsert overwrites it.
+  // The table grows if the load factor becomes larger than that of
+  // the constructor. They are not for the set (no values).
+  void insert(const std::vector<K>& k, const std::vector<V>& v);
+  void upsert(const std::vector<K>& k, const std::vector<V>& v);
+  void erase(const std::vector<K>& k); // absent keys are ignored
+  size_t size() const {return num_keys;}
+  size_t memory_usage() const { // bytes of the arrays
+    return (key.capacity() + conflict_key.capacity()) * sizeof(K) +
+      (val.capacity() + conflict_val.capacity()) * sizeof(V);
+  }
   void debug_print() {
     std::cout << "key: ";
     for(size_t i = 0; i < key.size(); i++) {
@@ -142,11 +243,8 @@ public:
       std::cout << val[i] << " ";
     }
     std::cout << std::endl;
-    std::cout << "is_filled: ";
-    for(size_t i = 0; i < is_filled.size(); i++) {
-      std::cout << is_filled[i] << " ";
-    }
-    std::cout << std::endl;
+    std::cout << "empty_key: " << empty_key << ", deleted_key: "
+              << deleted_key << std::endl;
     std::cout << "conflict_key: ";
     for(size_t i = 0; i < conflict_key.size(); i++) {
       std::cout << conflict_key[i] << " ";
@@ -161,79 +259,186 @@ public:
   void clear() { // to save memory
     std::vector<K> key_tmp; key_tmp.swap(key);
     std::vector<V> val_tmp; val_tmp.swap(val);
-    std::vector<int> is_filled_tmp; is_filled_tmp.swap(is_filled);
     std::vector<K> conflict_key_tmp; conflict_key_tmp.swap(conflict_key);
     std::vector<V> conflict_val_tmp; conflict_val_tmp.swap(conflict_val);
+    num_keys = 0;
+    num_deleted = 0;
   }
 private:
+  size_t init_table(const K* keyp, size_t size, double load_factor);
+  void calc_hash(const K* keyp, size_t size, size_t* hashp);
+  void locate(const K* keyp, size_t size, size_t* posp);
+  void insert_absent(const K* keyp, const V* valp, size_t size);
+  void rebuild(const K* keyp, const V* valp, size_t size);
+  template <bool UPDATE>
+  void insert_impl(const std::vector<K>& k, const std::vector<V>& v);
+  template <bool STORE_VAL, bool CHECK_UNIQUE>
+  void probe_insert(const K* keyp, const V* valp,
+                    size_t* missedp, size_t* missed_hashp, size_t& missed_idx,
+                    size_t* unique_checkerp, int& is_unique_ok);
+  void probe_lookup(const K* keyp,
+                    size_t* missedp, size_t* missed_hashp, size_t& missed_idx,
+                    size_t* foundp, size_t* found_slotp, size_t& found_idx,
+                    size_t* absentp, size_t& absent_idx);
+  H hasher;
   std::vector<K> key;
   std::vector<V> val;
-  std::vector<int> is_filled;
+  K empty_key; // key of the empty slots
+  K deleted_key; // key of the erased slots, which are still filled
+  size_t num_keys;
+  size_t num_deleted;
+  double max_load; // load factor of the constructor
   std::vector<K> conflict_key; // sorted
   std::vector<V> conflict_val;
 };
 
-template <class K, class V>
-unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
-                                        const std::vector<V>& v) {
+// Chooses the empty and deleted keys and allocates the key array of the table
+template <class K, class V, class H>
+size_t unique_hashtable<K,V,H>::init_table(const K* keyp, size_t size,
+                                           double load_factor) {
+  if(!(load_factor > 0 && load_factor <= 1))
+    throw std::runtime_error("unique_hashtable: load_factor should be in (0, 1]");
+  find_unused_keys(keyp, size, empty_key, deleted_key);
+  num_keys = size;
+  num_deleted = 0;
+  max_load = load_factor;
+  // the slots after the last one are for probing without wrap around
+  size_t table_size = hasher.init(size_t(size / load_factor)) +
+    UNIQUE_HASH_PROBE - 1;
+  key.assign(table_size, empty_key);
+  return table_size;
+}
+
+// Bounded linear probing: the keys that missed their home slot try
+// the next slot at each round, up to UNIQUE_HASH_PROBE slots; the keys
+// that are still missed are left in missedp for the conflict area.
+// Since a slot is filled at the round when it is tried, all the slots
+// from the home slot to the stored one are filled.
+template <class K, class V, class H>
+template <bool STORE_VAL, bool CHECK_UNIQUE>
+void unique_hashtable<K,V,H>::probe_insert(const K* keyp, const V* valp,
+                                           size_t* missedp,
+                                           size_t* missed_hashp,
+                                           size_t& missed_idx,
+                                           size_t* unique_checkerp,
+                                           int& is_unique_ok) {
+  K* table_keyp = key.data();
+  V* table_valp = val.data();
+  K empty = empty_key;
+  size_t idx[UNIQUE_HASH_VLEN];
+#pragma _NEC vreg(idx)
+  size_t slot[UNIQUE_HASH_VLEN];
+#pragma _NEC vreg(slot)
+  for(size_t p = 1; p < UNIQUE_HASH_PROBE && missed_idx > 0; p++) {
+    size_t size = missed_idx;
+    missed_idx = 0; // missedp is overwritten from the head
+    for(size_t start = 0; start < size; start += UNIQUE_HASH_VLEN) {
+      size_t len = std::min(size - start, size_t(UNIQUE_HASH_VLEN));
+      for(size_t i = 0; i < len; i++) {
+        idx[i] = missedp[start + i];
+        slot[i] = missed_hashp[start + i] + 1;
+      }
+#pragma cdir nodep
+#pragma _NEC ivdep
+      for(size_t i = 0; i < len; i++) {
+        if(table_keyp[slot[i]] == empty) {
+          table_keyp[slot[i]] = keyp[idx[i]];
+          if(CHECK_UNIQUE) unique_checkerp[slot[i]] = idx[i];
+        }
+      }
+#pragma cdir nodep
+#pragma _NEC ivdep
+      for(size_t i = 0; i < len; i++) {
+        if(CHECK_UNIQUE) {
+          if(unique_checkerp[slot[i]] == idx[i]) {
+            table_valp[slot[i]] = valp[idx[i]];
+          } else if(table_keyp[slot[i]] != keyp[idx[i]]) {
+            missed_hashp[missed_idx] = slot[i];
+            missedp[missed_idx++] = idx[i];
+          } else {
+            is_unique_ok = false;
+          }
+        } else {
+          if(table_keyp[slot[i]] == keyp[idx[i]]) {
+            if(STORE_VAL) table_valp[slot[i]] = valp[idx[i]];
+          } else {
+            missed_hashp[missed_idx] = slot[i];
+            missedp[missed_idx++] = idx[i];
+          }
+        }
+      }
+    }
+    if(CHECK_UNIQUE && is_unique_ok == false) return;
+  }
+}
+
+// The keys keyp[missedp[i]] that did not match at their filled home
+// slot missed_hashp[i] are compared with the following slots of the
+// probing window at once. If the key is not found and an empty slot
+// is in the window, the key does not exist; otherwise it is left in
+// missedp for the conflict area. All the outputs keep the order.
+template <class K, class V, class H>
+void unique_hashtable<K,V,H>::probe_lookup(const K* keyp,
+                                           size_t* missedp,
+                                           size_t* missed_hashp,
+                                           size_t& missed_idx,
+                                           size_t* foundp,
+                                           size_t* found_slotp,
+                                           size_t& found_idx,
+                                           size_t* absentp,
+                                           size_t& absent_idx) {
+  K* table_keyp = key.data();
+  K empty = empty_key;
+  K deleted = deleted_key;
+  size_t size = missed_idx;
+  missed_idx = 0;
+  found_idx = 0;
+  absent_idx = 0;
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 0; i < size; i++) {
+    auto k = keyp[missedp[i]];
+    auto windowk = table_keyp + missed_hashp[i];
+    int can_match = k != empty && k != deleted;
+    int found = 0; // keys are unique, so at most one slot matches
+    int is_empty = 0;
+    for(size_t p = 1; p < UNIQUE_HASH_PROBE; p++) {
+      found += (can_match && windowk[p] == k) * p;
+      is_empty |= windowk[p] == empty;
+    }
+    if(found) {
+      found_slotp[found_idx] = missed_hashp[i] + found;
+      foundp[found_idx++] = missedp[i];
+    } else if(is_empty) {
+      absentp[absent_idx++] = missedp[i];
+    } else {
+      missed_hashp[missed_idx] = missed_hashp[i];
+      missedp[missed_idx++] = missedp[i];
+    }
+  }
+}
+
+template <class K, class V, class H>
+unique_hashtable<K,V,H>::unique_hashtable(const std::vector<K>& k,
+                                          const std::vector<V>& v,
+                                          double load_factor) {
   size_t size = k.size();
   if(v.size() != size)
     throw std::runtime_error("sizes of key and value are different");
-  // http://d.hatena.ne.jp/zariganitosh/20090716/1247709137
-  // http://tools.m-bsys.com/calculators/prime_number_generator.php
-  long long primes[] = { // should be 64bit
-    8 + 3,
-    16 + 3,
-    32 + 5,
-    64 + 3,
-    128 + 3,
-    256 + 27,
-    512 + 9,
-    1024 + 9,
-    2048 + 5,
-    4096 + 3,
-    8192 + 27,
-    16384 + 43,
-    32768 + 3,
-    65536 + 45,
-    131072 + 29,
-    262144 + 3,
-    524288 + 21,
-    1048576 + 7,
-    2097152 + 17,
-    4194304 + 15,
-    8388608 + 9,
-    16777216 + 43,
-    33554432 + 35,
-    67108864 + 15,
-    134217728 + 29,
-    268435456 + 3,
-    536870912 + 11,
-    1073741824 + 85,
-    2147483648 + 11,
-    4294967296 + 15,
-    8589934592 + 17,
-    17179869184 + 25,
-    34359738368 + 53, // 32GB, primes + 32
-  };
-  size_t target_table_size = size * HASH_TABLE_SIZE_MULT;
-  auto* table_size_candp =
-    std::lower_bound(primes, primes + 33, target_table_size);
-  if(table_size_candp == primes + 33)
-    throw std::runtime_error("unique_hash_table: requested size too large");
-  size_t table_size = *table_size_candp;
-  key.resize(table_size);
-  val.resize(table_size);
-  is_filled.resize(table_size);
   const K* keyp = &k[0];
+  size_t table_size = init_table(keyp, size, load_factor);
+  auto hashf = hasher;
+  K empty = empty_key;
+  val.resize(table_size);
   const V* valp = &v[0];
   K* table_keyp = &key[0];
   V* table_valp = &val[0];
   std::vector<size_t> missed(size);
   size_t* missedp = &missed[0];
+  // home slot of missed; only used for probing
+  std::vector<size_t> missed_hash(UNIQUE_HASH_PROBE > 1 ? size : 0);
+  size_t* missed_hashp = missed_hash.data();
   size_t missed_idx = 0;
-  for(size_t i = 0; i < table_size; i++) is_filled[i] = false;
-  int* is_filledp = &is_filled[0];
   size_t hash[UNIQUE_HASH_VLEN];
 #pragma _NEC vreg(hash)
   size_t hash_remain[UNIQUE_HASH_VLEN];
@@ -255,14 +460,14 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
 #pragma cdir nodep
 #pragma _NEC ivdep
       for(size_t i = 0; i < UNIQUE_HASH_VLEN; i++) {
-        hash[i] = keyoff_hash[i] % table_size; 
+        hash[i] = hashf(keyoff_hash[i]); 
       } 
     } else if(sizeof(K) == 8) {
       const uint64_t* keyoff_hash = reinterpret_cast<const uint64_t*>(keyoff);
 #pragma cdir nodep
 #pragma _NEC ivdep
       for(size_t i = 0; i < UNIQUE_HASH_VLEN; i++) {
-        hash[i] = keyoff_hash[i] % table_size; 
+        hash[i] = hashf(keyoff_hash[i]); 
       } 
     } else {
       throw std::runtime_error("unique_hashtable only supports key whose size is 4 or 8");
@@ -270,9 +475,8 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < UNIQUE_HASH_VLEN; i++) {
-      if(is_filledp[hash[i]] == false) {
+      if(table_keyp[hash[i]] == empty) {
         table_keyp[hash[i]] = keyoff[i];
-        is_filledp[hash[i]] = true;
       }
     }
 #pragma cdir nodep
@@ -281,6 +485,7 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
       if(table_keyp[hash[i]] == keyoff[i]) {
         table_valp[hash[i]] = valoff[i];
       } else {
+        if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash[i];
         missedp[missed_idx++] = i + offset;
       }
     }
@@ -300,23 +505,22 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < remain_size; i++) {
-      hash_remain[i] = keyoff_hash[i] % table_size; 
+      hash_remain[i] = hashf(keyoff_hash[i]); 
     } 
   } else if(sizeof(K) == 8) {
     const uint64_t* keyoff_hash = reinterpret_cast<const uint64_t*>(keyoff);
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < remain_size; i++) {
-      hash_remain[i] = keyoff_hash[i] % table_size; 
+      hash_remain[i] = hashf(keyoff_hash[i]); 
     } 
   } else {
     throw std::runtime_error("unique_hashtable only supports key whose size is 4 or 8");
   }
 
   for(size_t i = 0; i < remain_size; i++) {
-    if(is_filledp[hash_remain[i]] == false) {
+    if(table_keyp[hash_remain[i]] == empty) {
       table_keyp[hash_remain[i]] = keyoff[i];
-      is_filledp[hash_remain[i]] = true;
     }
   }
 #pragma cdir nodep
@@ -325,9 +529,13 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
     if(table_keyp[hash_remain[i]] == keyoff[i]) {
       table_valp[hash_remain[i]] = valoff[i];
     } else {
-      missedp[missed_idx++] = i + offset;      
+      if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash_remain[i];
+      missedp[missed_idx++] = i + offset;
     }
   }
+  int is_unique_ok = true; // not checked
+  probe_insert<true, false>(keyp, valp, missedp, missed_hashp, missed_idx,
+                            0, is_unique_ok);
   if(missed_idx > 0) {
 /*    RLOG(DEBUG) << "missed = " << missed_idx << "/" << size
       << ", table_size = " << table_size << std::endl; */
@@ -345,68 +553,28 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
 
 // If duplicated keys are passed, is_uniqe_ok is set to false
 // and the result is incorrect
-template <class K, class V>
-unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
-                                        const std::vector<V>& v,
-                                        int& is_unique_ok) {
+template <class K, class V, class H>
+unique_hashtable<K,V,H>::unique_hashtable(const std::vector<K>& k,
+                                          const std::vector<V>& v,
+                                          int& is_unique_ok,
+                                          double load_factor) {
   size_t size = k.size();
   if(v.size() != size)
     throw std::runtime_error("sizes of key and value are different");
-  // http://d.hatena.ne.jp/zariganitosh/20090716/1247709137
-  // http://tools.m-bsys.com/calculators/prime_number_generator.php
-  long long primes[] = { // should be 64bit
-    8 + 3,
-    16 + 3,
-    32 + 5,
-    64 + 3,
-    128 + 3,
-    256 + 27,
-    512 + 9,
-    1024 + 9,
-    2048 + 5,
-    4096 + 3,
-    8192 + 27,
-    16384 + 43,
-    32768 + 3,
-    65536 + 45,
-    131072 + 29,
-    262144 + 3,
-    524288 + 21,
-    1048576 + 7,
-    2097152 + 17,
-    4194304 + 15,
-    8388608 + 9,
-    16777216 + 43,
-    33554432 + 35,
-    67108864 + 15,
-    134217728 + 29,
-    268435456 + 3,
-    536870912 + 11,
-    1073741824 + 85,
-    2147483648 + 11,
-    4294967296 + 15,
-    8589934592 + 17,
-    17179869184 + 25,
-    34359738368 + 53, // 32GB, primes + 32
-  };
-  size_t target_table_size = size * HASH_TABLE_SIZE_MULT;
-  auto* table_size_candp =
-    std::lower_bound(primes, primes + 33, target_table_size);
-  if(table_size_candp == primes + 33)
-    throw std::runtime_error("unique_hash_table: requested size too large");
-  size_t table_size = *table_size_candp;
-  key.resize(table_size);
-  val.resize(table_size);
-  is_filled.resize(table_size);
   const K* keyp = &k[0];
+  size_t table_size = init_table(keyp, size, load_factor);
+  auto hashf = hasher;
+  K empty = empty_key;
+  val.resize(table_size);
   const V* valp = &v[0];
   K* table_keyp = &key[0];
   V* table_valp = &val[0];
   std::vector<size_t> missed(size);
   size_t* missedp = &missed[0];
+  // home slot of missed; only used for probing
+  std::vector<size_t> missed_hash(UNIQUE_HASH_PROBE > 1 ? size : 0);
+  size_t* missed_hashp = missed_hash.data();
   size_t missed_idx = 0;
-  for(size_t i = 0; i < table_size; i++) is_filled[i] = false;
-  int* is_filledp = &is_filled[0];
   size_t hash[UNIQUE_HASH_VLEN];
 #pragma _NEC vreg(hash)
   size_t hash_remain[UNIQUE_HASH_VLEN];
@@ -432,14 +600,14 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
 #pragma cdir nodep
 #pragma _NEC ivdep
       for(size_t i = 0; i < UNIQUE_HASH_VLEN; i++) {
-        hash[i] = keyoff_hash[i] % table_size; 
+        hash[i] = hashf(keyoff_hash[i]); 
       } 
     } else if(sizeof(K) == 8) {
       const uint64_t* keyoff_hash = reinterpret_cast<const uint64_t*>(keyoff);
 #pragma cdir nodep
 #pragma _NEC ivdep
       for(size_t i = 0; i < UNIQUE_HASH_VLEN; i++) {
-        hash[i] = keyoff_hash[i] % table_size; 
+        hash[i] = hashf(keyoff_hash[i]); 
       } 
     } else {
       throw std::runtime_error("unique_hashtable only supports key whose size is 4 or 8");
@@ -447,9 +615,8 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < UNIQUE_HASH_VLEN; i++) {
-      if(is_filledp[hash[i]] == false) {
+      if(table_keyp[hash[i]] == empty) {
         table_keyp[hash[i]] = keyoff[i];
-        is_filledp[hash[i]] = true;
         unique_checkerp[hash[i]] = i + offset;
       } else if(table_keyp[hash[i]] == keyoff[i]) {
         is_unique_ok = false;
@@ -461,6 +628,7 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
       if(unique_checkerp[hash[i]] == i + offset) {
         table_valp[hash[i]] = valoff[i];
       } else if(table_keyp[hash[i]] != keyoff[i]) {
+        if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash[i];
         missedp[missed_idx++] = i + offset;
       } else {
         is_unique_ok = false;
@@ -481,14 +649,14 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < remain_size; i++) {
-      hash_remain[i] = keyoff_hash[i] % table_size; 
+      hash_remain[i] = hashf(keyoff_hash[i]); 
     } 
   } else if(sizeof(K) == 8) {
     const uint64_t* keyoff_hash = reinterpret_cast<const uint64_t*>(keyoff);
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < remain_size; i++) {
-      hash_remain[i] = keyoff_hash[i] % table_size; 
+      hash_remain[i] = hashf(keyoff_hash[i]); 
     } 
   } else {
     throw std::runtime_error("unique_hashtable only supports key whose size is 4 or 8");
@@ -496,9 +664,8 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
 #pragma cdir nodep
 #pragma _NEC ivdep
   for(size_t i = 0; i < remain_size; i++) {
-    if(is_filledp[hash_remain[i]] == false) {
+    if(table_keyp[hash_remain[i]] == empty) {
       table_keyp[hash_remain[i]] = keyoff[i];
-      is_filledp[hash_remain[i]] = true;
       unique_checkerp[hash_remain[i]] = i + offset;
     } else if(table_keyp[hash_remain[i]] == keyoff[i]) {
       is_unique_ok = false;
@@ -510,12 +677,16 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
     if(unique_checkerp[hash_remain[i]] == i + offset) {
       table_valp[hash_remain[i]] = valoff[i];
     } else if(table_keyp[hash_remain[i]] != keyoff[i]) {
+      if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash_remain[i];
       missedp[missed_idx++] = i + offset;
     } else {
       is_unique_ok = false;
     }
   }
   if(is_unique_ok == false) return;
+  probe_insert<true, true>(keyp, valp, missedp, missed_hashp, missed_idx,
+                           unique_checkerp, is_unique_ok);
+  if(is_unique_ok == false) return;
   if(missed_idx > 0) {
 /*    RLOG(DEBUG) << "missed = " << missed_idx << "/" << size
       << ", table_size = " << table_size << std::endl; */
@@ -528,63 +699,30 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k,
       conflict_valp[i] = valp[missedp[i]];
     }
     radix_sort(conflict_key, conflict_val);
+    // duplicated keys that are both in the conflict area are adjacent
+    auto sorted_keyp = conflict_key.data();
+    for(size_t i = 1; i < missed_idx; i++) {
+      if(sorted_keyp[i - 1] == sorted_keyp[i]) is_unique_ok = false;
+    }
   }
 }
 
 // for set, accept duplicated keys
-template <class K, class V>
-unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k) {
+template <class K, class V, class H>
+unique_hashtable<K,V,H>::unique_hashtable(const std::vector<K>& k,
+                                          double load_factor) {
   size_t size = k.size();
-  long long primes[] = { // should be 64bit
-    8 + 3,
-    16 + 3,
-    32 + 5,
-    64 + 3,
-    128 + 3,
-    256 + 27,
-    512 + 9,
-    1024 + 9,
-    2048 + 5,
-    4096 + 3,
-    8192 + 27,
-    16384 + 43,
-    32768 + 3,
-    65536 + 45,
-    131072 + 29,
-    262144 + 3,
-    524288 + 21,
-    1048576 + 7,
-    2097152 + 17,
-    4194304 + 15,
-    8388608 + 9,
-    16777216 + 43,
-    33554432 + 35,
-    67108864 + 15,
-    134217728 + 29,
-    268435456 + 3,
-    536870912 + 11,
-    1073741824 + 85,
-    2147483648 + 11,
-    4294967296 + 15,
-    8589934592 + 17,
-    17179869184 + 25,
-    34359738368 + 53, // 32GB, primes + 32
-  };
-  size_t target_table_size = size * HASH_TABLE_SIZE_MULT;
-  auto* table_size_candp =
-    std::lower_bound(primes, primes + 33, target_table_size);
-  if(table_size_candp == primes + 33)
-    throw std::runtime_error("unique_hash_table: requested size too large");
-  size_t table_size = *table_size_candp;
-  key.resize(table_size);
-  is_filled.resize(table_size);
   const K* keyp = &k[0];
+  size_t table_size = init_table(keyp, size, load_factor);
+  auto hashf = hasher;
+  K empty = empty_key;
   K* table_keyp = &key[0];
   std::vector<size_t> missed(size);
   size_t* missedp = &missed[0];
+  // home slot of missed; only used for probing
+  std::vector<size_t> missed_hash(UNIQUE_HASH_PROBE > 1 ? size : 0);
+  size_t* missed_hashp = missed_hash.data();
   size_t missed_idx = 0;
-  for(size_t i = 0; i < table_size; i++) is_filled[i] = false;
-  int* is_filledp = &is_filled[0];
   size_t hash[UNIQUE_HASH_VLEN];
 #pragma _NEC vreg(hash)
   size_t hash_remain[UNIQUE_HASH_VLEN];
@@ -605,14 +743,14 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k) {
 #pragma cdir nodep
 #pragma _NEC ivdep
       for(size_t i = 0; i < UNIQUE_HASH_VLEN; i++) {
-        hash[i] = keyoff_hash[i] % table_size; 
+        hash[i] = hashf(keyoff_hash[i]); 
       } 
     } else if(sizeof(K) == 8) {
       const uint64_t* keyoff_hash = reinterpret_cast<const uint64_t*>(keyoff);
 #pragma cdir nodep
 #pragma _NEC ivdep
       for(size_t i = 0; i < UNIQUE_HASH_VLEN; i++) {
-        hash[i] = keyoff_hash[i] % table_size; 
+        hash[i] = hashf(keyoff_hash[i]); 
       } 
     } else {
       throw std::runtime_error("unique_hashtable only supports key whose size is 4 or 8");
@@ -620,9 +758,8 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k) {
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < UNIQUE_HASH_VLEN; i++) {
-      if(is_filledp[hash[i]] == false) {
+      if(table_keyp[hash[i]] == empty) {
         table_keyp[hash[i]] = keyoff[i];
-        is_filledp[hash[i]] = true;
       }
     }
 #pragma cdir nodep
@@ -631,6 +768,7 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k) {
       if(table_keyp[hash[i]] == keyoff[i]) {
         ;
       } else {
+        if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash[i];
         missedp[missed_idx++] = i + offset;
       }
     }
@@ -649,59 +787,70 @@ unique_hashtable<K,V>::unique_hashtable(const std::vector<K>& k) {
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < remain_size; i++) {
-      hash_remain[i] = keyoff_hash[i] % table_size; 
+      hash_remain[i] = hashf(keyoff_hash[i]); 
     } 
   } else if(sizeof(K) == 8) {
     const uint64_t* keyoff_hash = reinterpret_cast<const uint64_t*>(keyoff);
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < remain_size; i++) {
-      hash_remain[i] = keyoff_hash[i] % table_size; 
+      hash_remain[i] = hashf(keyoff_hash[i]); 
     } 
   } else {
     throw std::runtime_error("unique_hashtable only supports key whose size is 4 or 8");
   }
   for(size_t i = 0; i < remain_size; i++) {
-    if(is_filledp[hash_remain[i]] == false) {
+    if(table_keyp[hash_remain[i]] == empty) {
       table_keyp[hash_remain[i]] = keyoff[i];
-      is_filledp[hash_remain[i]] = true;
     }
   }
 #pragma cdir nodep
 #pragma _NEC ivdep
   for(size_t i = 0; i < remain_size; i++) {
     if(table_keyp[hash_remain[i]] != keyoff[i]) {
-      missedp[missed_idx++] = i + offset;      
+      if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash_remain[i];
+      missedp[missed_idx++] = i + offset;
     }
   }
+  int is_unique_ok = true; // not checked
+  probe_insert<false, false>(keyp, 0, missedp, missed_hashp, missed_idx,
+                             0, is_unique_ok);
   if(missed_idx > 0) {
 /*    RLOG(DEBUG) << "(set) missed = " << missed_idx << "/" << size
       << ", table_size = " << table_size << std::endl; */
     conflict_key.resize(missed_idx);
-    conflict_val.resize(missed_idx); // dummy
     K* conflict_keyp = &conflict_key[0];
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < missed_idx; i++) {
       conflict_keyp[i] = keyp[missedp[i]];
     }
-    radix_sort(conflict_key, conflict_val);
+    radix_sort(conflict_key); // no conflict_val for set
     auto tmp = set_unique(conflict_key);
     tmp.swap(conflict_key);
   }
+  // the keys might be duplicated
+  size_t filled = 0;
+  for(size_t i = 0; i < table_size; i++) filled += table_keyp[i] != empty;
+  num_keys = filled + conflict_key.size();
 }
 
-template <class K, class V> 
-std::vector<V> unique_hashtable<K,V>::lookup(const std::vector<K>& k) {
+template <class K, class V, class H>
+std::vector<V> unique_hashtable<K,V,H>::lookup(const std::vector<K>& k) {
   size_t size = k.size();
-  size_t table_size = key.size();
+  auto hashf = hasher;
   std::vector<V> v(size);
+  if(key.size() == 0) return v; // not created yet
   const K* keyp = &k[0];
   V* valp = &v[0];
   K* table_keyp = &key[0];
   V* table_valp = &val[0];
+  K empty = empty_key;
   std::vector<size_t> missed(size);
   size_t* missedp = &missed[0];
+  // home slot of missed; only used for probing
+  std::vector<size_t> missed_hash(UNIQUE_HASH_PROBE > 1 ? size : 0);
+  size_t* missed_hashp = missed_hash.data();
   size_t missed_idx = 0;
 /*
 #pragma cdir nodep
@@ -720,11 +869,15 @@ std::vector<V> unique_hashtable<K,V>::lookup(const std::vector<K>& k) {
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < size; i++) {
-      size_t hash = keyp_hash[i] % table_size;
+      size_t hash = hashf(keyp_hash[i]);
+#if !defined(_SX) && !defined(__ve__)
+      hash = probe_slot(table_keyp, empty, hash, keyp[i]);
+#endif
       if(table_keyp[hash] == keyp[i]) {
         valp[i] = table_valp[hash];
       } else {
-        missedp[missed_idx++] = i;      
+        if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash;
+        missedp[missed_idx++] = i;
       }
     }
   } else if(sizeof(K) == 8) {
@@ -732,17 +885,39 @@ std::vector<V> unique_hashtable<K,V>::lookup(const std::vector<K>& k) {
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < size; i++) {
-      size_t hash = keyp_hash[i] % table_size;
+      size_t hash = hashf(keyp_hash[i]);
+#if !defined(_SX) && !defined(__ve__)
+      hash = probe_slot(table_keyp, empty, hash, keyp[i]);
+#endif
       if(table_keyp[hash] == keyp[i]) {
         valp[i] = table_valp[hash];
       } else {
-        missedp[missed_idx++] = i;      
+        if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash;
+        missedp[missed_idx++] = i;
       }
     }
   } else {
     throw std::runtime_error("unique_hashtable only supports key whose size is 4 or 8");
   }
-  if(missed_idx > 0) {
+#if defined(_SX) || defined(__ve__)
+  // on x86, the window is already probed in the loop above
+  if(UNIQUE_HASH_PROBE > 1) {
+    std::vector<size_t> found(missed_idx), found_slot(missed_idx);
+    std::vector<size_t> absent(missed_idx);
+    size_t* foundp = found.data();
+    size_t* found_slotp = found_slot.data();
+    size_t found_idx = 0;
+    size_t absent_idx = 0;
+    probe_lookup(keyp, missedp, missed_hashp, missed_idx,
+                 foundp, found_slotp, found_idx, absent.data(), absent_idx);
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < found_idx; i++) {
+      valp[foundp[i]] = table_valp[found_slotp[i]];
+    }
+  }
+#endif
+  if(missed_idx > 0 && conflict_key.size() > 0) {
     std::vector<K> missed_key(missed_idx);
     K* missed_keyp = &missed_key[0];
 #pragma cdir nodep
@@ -762,20 +937,29 @@ std::vector<V> unique_hashtable<K,V>::lookup(const std::vector<K>& k) {
   return v;
 }
 
-template <class K, class V> 
-std::vector<V> unique_hashtable<K,V>::lookup(const std::vector<K>& k,
-                                             std::vector<size_t>& retmiss) {
+template <class K, class V, class H>
+std::vector<V> unique_hashtable<K,V,H>::lookup(const std::vector<K>& k,
+                                               std::vector<size_t>& retmiss) {
   size_t size = k.size();
-  size_t table_size = key.size();
+  auto hashf = hasher;
   std::vector<V> v(size);
+  if(key.size() == 0) { // not created yet
+    retmiss.resize(size);
+    for(size_t i = 0; i < size; i++) retmiss[i] = i;
+    return v;
+  }
   const K* keyp = &k[0];
   V* valp = &v[0];
   K* table_keyp = &key[0];
   V* table_valp = &val[0];
   std::vector<size_t> missed(size);
   size_t* missedp = &missed[0];
+  // home slot of missed; only used for probing
+  std::vector<size_t> missed_hash(UNIQUE_HASH_PROBE > 1 ? size : 0);
+  size_t* missed_hashp = missed_hash.data();
   size_t missed_idx = 0;
-  int* is_filledp = &is_filled[0];
+  K empty = empty_key;
+  K deleted = deleted_key;
   std::vector<size_t> misstmp0(size);
   size_t* misstmp0p = &misstmp0[0];
   size_t misstmp0_idx = 0;
@@ -787,8 +971,8 @@ std::vector<V> unique_hashtable<K,V>::lookup(const std::vector<K>& k,
 #pragma _NEC ivdep
   for(size_t i = 0; i < size; i++) {
     size_t hash = myhash(keyp[i], table_size);
-    if(is_filledp[hash]) {
-      if(table_keyp[hash] == keyp[i]) {
+    if(table_keyp[hash] != empty) {
+      if(table_keyp[hash] == keyp[i] && keyp[i] != deleted) {
         valp[i] = table_valp[hash];
       } else missedp[missed_idx++] = i; // check conflict
       // need to use different array for vectorization
@@ -800,11 +984,17 @@ std::vector<V> unique_hashtable<K,V>::lookup(const std::vector<K>& k,
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < size; i++) {
-      size_t hash = keyp_hash[i] % table_size;
-      if(is_filledp[hash]) {
-        if(table_keyp[hash] == keyp[i]) {
+      size_t hash = hashf(keyp_hash[i]);
+#if !defined(_SX) && !defined(__ve__)
+      hash = probe_slot(table_keyp, empty, hash, keyp[i]);
+#endif
+      if(table_keyp[hash] != empty) {
+        if(table_keyp[hash] == keyp[i] && keyp[i] != deleted) {
           valp[i] = table_valp[hash];
-        } else missedp[missed_idx++] = i; // check conflict
+        } else { // check conflict
+          if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash;
+          missedp[missed_idx++] = i;
+        }
         // need to use different array for vectorization
       } else misstmp0p[misstmp0_idx++] = i; // clearly miss
     }
@@ -813,17 +1003,48 @@ std::vector<V> unique_hashtable<K,V>::lookup(const std::vector<K>& k,
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < size; i++) {
-      size_t hash = keyp_hash[i] % table_size;
-      if(is_filledp[hash]) {
-        if(table_keyp[hash] == keyp[i]) {
+      size_t hash = hashf(keyp_hash[i]);
+#if !defined(_SX) && !defined(__ve__)
+      hash = probe_slot(table_keyp, empty, hash, keyp[i]);
+#endif
+      if(table_keyp[hash] != empty) {
+        if(table_keyp[hash] == keyp[i] && keyp[i] != deleted) {
           valp[i] = table_valp[hash];
-        } else missedp[missed_idx++] = i; // check conflict
+        } else { // check conflict
+          if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash;
+          missedp[missed_idx++] = i;
+        }
         // need to use different array for vectorization
       } else misstmp0p[misstmp0_idx++] = i; // clearly miss
     }
   } else {
     throw std::runtime_error("unique_hashtable only supports key whose size is 4 or 8");
   }
+#if defined(_SX) || defined(__ve__)
+  // on x86, the window is already probed in the loop above
+  if(UNIQUE_HASH_PROBE > 1) {
+    std::vector<size_t> found(missed_idx), found_slot(missed_idx);
+    std::vector<size_t> absent(missed_idx);
+    size_t* foundp = found.data();
+    size_t* found_slotp = found_slot.data();
+    size_t found_idx = 0;
+    size_t absent_idx = 0;
+    probe_lookup(keyp, missedp, missed_hashp, missed_idx,
+                 foundp, found_slotp, found_idx, absent.data(), absent_idx);
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < found_idx; i++) {
+      valp[foundp[i]] = table_valp[found_slotp[i]];
+    }
+    if(absent_idx > 0) {
+      absent.resize(absent_idx);
+      misstmp0.resize(misstmp0_idx);
+      auto tmp = set_union(misstmp0, absent);
+      misstmp0.swap(tmp);
+      misstmp0_idx = misstmp0.size();
+    }
+  }
+#endif
   if(missed_idx > 0) {
     if(conflict_key.size() > 0) {
       std::vector<K> missed_key(missed_idx);
@@ -860,26 +1081,31 @@ std::vector<V> unique_hashtable<K,V>::lookup(const std::vector<K>& k,
   return v;
 }
 
-template <class K, class V> 
+template <class K, class V, class H>
 std::vector<int>
-unique_hashtable<K,V>::check_existence(const std::vector<K>& k) {
+unique_hashtable<K,V,H>::check_existence(const std::vector<K>& k) {
   size_t size = k.size();
-  size_t table_size = key.size();
+  auto hashf = hasher;
   std::vector<int> ret(size);
+  if(key.size() == 0) return ret; // not created yet
   const K* keyp = &k[0];
-  V* retp = &ret[0];
+  int* retp = &ret[0];
   K* table_keyp = &key[0];
   std::vector<size_t> missed(size);
   size_t* missedp = &missed[0];
+  // home slot of missed; only used for probing
+  std::vector<size_t> missed_hash(UNIQUE_HASH_PROBE > 1 ? size : 0);
+  size_t* missed_hashp = missed_hash.data();
   size_t missed_idx = 0;
-  int* is_filledp = &is_filled[0];
+  K empty = empty_key;
+  K deleted = deleted_key;
 /*
 #pragma cdir nodep
 #pragma _NEC ivdep
   for(size_t i = 0; i < size; i++) {
     size_t hash = myhash(keyp[i], table_size);
-    if(is_filledp[hash]) {
-      if(table_keyp[hash] == keyp[i]) {
+    if(table_keyp[hash] != empty) {
+      if(table_keyp[hash] == keyp[i] && keyp[i] != deleted) {
         retp[i] = 1;
       } else {
         missedp[missed_idx++] = i;      
@@ -892,12 +1118,16 @@ unique_hashtable<K,V>::check_existence(const std::vector<K>& k) {
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < size; i++) {
-      size_t hash = keyp_hash[i] % table_size;
-      if(is_filledp[hash]) {
-        if(table_keyp[hash] == keyp[i]) {
+      size_t hash = hashf(keyp_hash[i]);
+#if !defined(_SX) && !defined(__ve__)
+      hash = probe_slot(table_keyp, empty, hash, keyp[i]);
+#endif
+      if(table_keyp[hash] != empty) {
+        if(table_keyp[hash] == keyp[i] && keyp[i] != deleted) {
           retp[i] = 1;
         } else {
-          missedp[missed_idx++] = i;      
+          if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash;
+          missedp[missed_idx++] = i;
         }
       }
     }
@@ -906,12 +1136,16 @@ unique_hashtable<K,V>::check_existence(const std::vector<K>& k) {
 #pragma cdir nodep
 #pragma _NEC ivdep
     for(size_t i = 0; i < size; i++) {
-      size_t hash = keyp_hash[i] % table_size;
-      if(is_filledp[hash]) {
-        if(table_keyp[hash] == keyp[i]) {
+      size_t hash = hashf(keyp_hash[i]);
+#if !defined(_SX) && !defined(__ve__)
+      hash = probe_slot(table_keyp, empty, hash, keyp[i]);
+#endif
+      if(table_keyp[hash] != empty) {
+        if(table_keyp[hash] == keyp[i] && keyp[i] != deleted) {
           retp[i] = 1;
         } else {
-          missedp[missed_idx++] = i;      
+          if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hash;
+          missedp[missed_idx++] = i;
         }
       }
     }
@@ -919,6 +1153,24 @@ unique_hashtable<K,V>::check_existence(const std::vector<K>& k) {
     throw std::runtime_error("unique_hashtable only supports key whose size is 4 or 8");
   }
 
+#if defined(_SX) || defined(__ve__)
+  // on x86, the window is already probed in the loop above
+  if(UNIQUE_HASH_PROBE > 1) {
+    std::vector<size_t> found(missed_idx), found_slot(missed_idx);
+    std::vector<size_t> absent(missed_idx);
+    size_t* foundp = found.data();
+    size_t* found_slotp = found_slot.data();
+    size_t found_idx = 0;
+    size_t absent_idx = 0;
+    probe_lookup(keyp, missedp, missed_hashp, missed_idx,
+                 foundp, found_slotp, found_idx, absent.data(), absent_idx);
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < found_idx; i++) {
+      retp[foundp[i]] = 1;
+    }
+  }
+#endif
   if(missed_idx > 0) {
     if(conflict_key.size() > 0) {
       std::vector<K> missed_key(missed_idx);
@@ -942,10 +1194,11 @@ unique_hashtable<K,V>::check_existence(const std::vector<K>& k) {
   return ret;
 }
 
-template <class K, class V> 
+template <class K, class V, class H>
 std::vector<K>
-unique_hashtable<K,V>::all_keys() {
-  int* is_filledp = is_filled.data();
+unique_hashtable<K,V,H>::all_keys() {
+  K empty = empty_key;
+  K deleted = deleted_key;
   size_t size = key.size();
   if(size == 0) {
     return std::vector<K>();
@@ -967,7 +1220,7 @@ unique_hashtable<K,V>::all_keys() {
   if(each == 0) {
     size_t current = 0;
     for(size_t i = 0; i < size; i++) {
-      if(is_filledp[i]) {
+      if(keyp[i] != empty && keyp[i] != deleted) {
         keytmpp[current] = keyp[i];
         current++;
       }
@@ -990,7 +1243,8 @@ unique_hashtable<K,V>::all_keys() {
 #pragma _NEC ivdep
 #pragma _NEC vovertake
       for(size_t i = 0; i < UNIQUE_HASH_VLEN; i++) {
-        auto loaded_is_filled = is_filledp[j + each * i];
+        auto loaded_is_filled =
+          keyp[j + each * i] != empty && keyp[j + each * i] != deleted;
         if(loaded_is_filled) {
           keytmpp[out_ridx[i]] = keyp[j + each * i];
           out_ridx[i]++;
@@ -1001,7 +1255,8 @@ unique_hashtable<K,V>::all_keys() {
     size_t rest_idx = rest_idx_start;
     if(rest != 0) {
       for(size_t j = 0; j < rest; j++) {
-        auto loaded_is_filled = is_filledp[j + rest_idx_start]; 
+        auto loaded_is_filled = keyp[j + rest_idx_start] != empty &&
+          keyp[j + rest_idx_start] != deleted;
         if(loaded_is_filled != 0) {
           keytmpp[rest_idx] = keyp[j + rest_idx_start];
           rest_idx++;
@@ -1043,6 +1298,343 @@ unique_hashtable<K,V>::all_keys() {
   }
 }
 
+template <class K, class V, class H>
+void unique_hashtable<K,V,H>::calc_hash(const K* keyp, size_t size,
+                                        size_t* hashp) {
+  auto hashf = hasher;
+  if(sizeof(K) == 4) {
+    const uint32_t* keyp_hash = reinterpret_cast<const uint32_t*>(keyp);
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < size; i++) {
+      hashp[i] = hashf(keyp_hash[i]);
+    }
+  } else if(sizeof(K) == 8) {
+    const uint64_t* keyp_hash = reinterpret_cast<const uint64_t*>(keyp);
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < size; i++) {
+      hashp[i] = hashf(keyp_hash[i]);
+    }
+  } else {
+    throw std::runtime_error("unique_hashtable only supports key whose size is 4 or 8");
+  }
+}
+
+// Position of the keys: the slot of the table, key.size() + the index
+// of the conflict area, or max() if the key does not exist
+template <class K, class V, class H>
+void unique_hashtable<K,V,H>::locate(const K* keyp, size_t size,
+                                     size_t* posp) {
+  size_t not_found = std::numeric_limits<size_t>::max();
+  size_t table_size = key.size();
+  K* table_keyp = key.data();
+  K empty = empty_key;
+  K deleted = deleted_key;
+  std::vector<size_t> hash(size);
+  size_t* hashp = hash.data();
+  calc_hash(keyp, size, hashp);
+  std::vector<size_t> missed(size);
+  size_t* missedp = missed.data();
+  // home slot of missed; only used for probing
+  std::vector<size_t> missed_hash(UNIQUE_HASH_PROBE > 1 ? size : 0);
+  size_t* missed_hashp = missed_hash.data();
+  size_t missed_idx = 0;
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 0; i < size; i++) {
+    size_t h = hashp[i];
+#if !defined(_SX) && !defined(__ve__)
+    h = probe_slot(table_keyp, empty, h, keyp[i]);
+#endif
+    posp[i] = not_found;
+    if(table_keyp[h] == keyp[i] && keyp[i] != empty && keyp[i] != deleted) {
+      posp[i] = h;
+    } else if(table_keyp[h] != empty) {
+      if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = h;
+      missedp[missed_idx++] = i;
+    }
+  }
+#if defined(_SX) || defined(__ve__)
+  // on x86, the window is already probed in the loop above
+  if(UNIQUE_HASH_PROBE > 1) {
+    std::vector<size_t> found(missed_idx), found_slot(missed_idx);
+    std::vector<size_t> absent(missed_idx);
+    size_t* foundp = found.data();
+    size_t* found_slotp = found_slot.data();
+    size_t found_idx = 0;
+    size_t absent_idx = 0;
+    probe_lookup(keyp, missedp, missed_hashp, missed_idx,
+                 foundp, found_slotp, found_idx, absent.data(), absent_idx);
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < found_idx; i++) {
+      posp[foundp[i]] = found_slotp[i];
+    }
+  }
+#endif
+  if(missed_idx > 0 && conflict_key.size() > 0) {
+    std::vector<K> missed_key(missed_idx);
+    K* missed_keyp = missed_key.data();
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < missed_idx; i++) {
+      missed_keyp[i] = keyp[missedp[i]];
+    }
+    auto missed_val_idx = vector_binary_search(conflict_key, missed_key);
+    size_t* missed_val_idxp = missed_val_idx.data();
+    K* conflict_keyp = conflict_key.data();
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < missed_idx; i++) {
+      if(conflict_keyp[missed_val_idxp[i]] == missed_keyp[i])
+        posp[missedp[i]] = table_size + missed_val_idxp[i];
+    }
+  }
+}
+
+// Inserts the keys that are not in the table, like the constructor;
+// erased slots are reused, and the keys that are missed are merged
+// into the conflict area
+template <class K, class V, class H>
+void unique_hashtable<K,V,H>::insert_absent(const K* keyp, const V* valp,
+                                            size_t size) {
+  K* table_keyp = key.data();
+  V* table_valp = val.data();
+  K empty = empty_key;
+  K deleted = deleted_key;
+  std::vector<size_t> hash(size);
+  size_t* hashp = hash.data();
+  calc_hash(keyp, size, hashp);
+  std::vector<size_t> missed(size);
+  size_t* missedp = missed.data();
+  // home slot of missed; only used for probing
+  std::vector<size_t> missed_hash(UNIQUE_HASH_PROBE > 1 ? size : 0);
+  size_t* missed_hashp = missed_hash.data();
+  size_t missed_idx = 0;
+  std::vector<int> was_deleted(size);
+  int* was_deletedp = was_deleted.data();
+  size_t reused = 0;
+  for(size_t start = 0; start < size; start += UNIQUE_HASH_VLEN) {
+    size_t len = std::min(size - start, size_t(UNIQUE_HASH_VLEN));
+    auto keyoff = keyp + start;
+    auto hashoff = hashp + start;
+    auto was_deletedoff = was_deletedp + start;
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < len; i++) {
+      int d = table_keyp[hashoff[i]] == deleted;
+      if(table_keyp[hashoff[i]] == empty || d) {
+        table_keyp[hashoff[i]] = keyoff[i];
+        was_deletedoff[i] = d;
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < len; i++) {
+      if(table_keyp[hashoff[i]] == keyoff[i]) {
+        table_valp[hashoff[i]] = valp[start + i];
+        reused += was_deletedoff[i];
+      } else {
+        if(UNIQUE_HASH_PROBE > 1) missed_hashp[missed_idx] = hashoff[i];
+        missedp[missed_idx++] = start + i;
+      }
+    }
+  }
+  int is_unique_ok = true; // not checked
+  probe_insert<true, false>(keyp, valp, missedp, missed_hashp, missed_idx,
+                            0, is_unique_ok);
+  if(missed_idx > 0) {
+    std::vector<K> new_key(missed_idx);
+    std::vector<V> new_val(missed_idx);
+    K* new_keyp = new_key.data();
+    V* new_valp = new_val.data();
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < missed_idx; i++) {
+      new_keyp[i] = keyp[missedp[i]];
+      new_valp[i] = valp[missedp[i]];
+    }
+    radix_sort(new_key, new_val);
+    std::vector<K> merged_key;
+    std::vector<V> merged_val;
+    set_merge_pair(conflict_key, conflict_val, new_key, new_val,
+                   merged_key, merged_val);
+    conflict_key.swap(merged_key);
+    conflict_val.swap(merged_val);
+  }
+  num_keys += size;
+  num_deleted -= reused;
+}
+
+// Creates the table again from the current entries and the new ones,
+// with the twice of the size for the current load factor
+template <class K, class V, class H>
+void unique_hashtable<K,V,H>::rebuild(const K* keyp, const V* valp,
+                                      size_t size) {
+  size_t table_size = key.size();
+  size_t conflict_size = conflict_key.size();
+  K* table_keyp = key.data();
+  V* table_valp = val.data();
+  K empty = empty_key;
+  K deleted = deleted_key;
+  std::vector<K> all_key(table_size + conflict_size + size);
+  std::vector<V> all_val(table_size + conflict_size + size);
+  K* all_keyp = all_key.data();
+  V* all_valp = all_val.data();
+  size_t all_idx = 0;
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 0; i < table_size; i++) {
+    if(table_keyp[i] != empty && table_keyp[i] != deleted) {
+      all_keyp[all_idx] = table_keyp[i];
+      all_valp[all_idx++] = table_valp[i];
+    }
+  }
+  K* conflict_keyp = conflict_key.data();
+  V* conflict_valp = conflict_val.data();
+  for(size_t i = 0; i < conflict_size; i++) {
+    all_keyp[all_idx + i] = conflict_keyp[i];
+    all_valp[all_idx + i] = conflict_valp[i];
+  }
+  all_idx += conflict_size;
+  for(size_t i = 0; i < size; i++) {
+    all_keyp[all_idx + i] = keyp[i];
+    all_valp[all_idx + i] = valp[i];
+  }
+  all_key.resize(all_idx + size);
+  all_val.resize(all_idx + size);
+  unique_hashtable<K,V,H> grown(all_key, all_val, max_load / 2);
+  grown.max_load = max_load;
+  *this = std::move(grown);
+}
+
+template <class K, class V, class H>
+template <bool UPDATE>
+void unique_hashtable<K,V,H>::insert_impl(const std::vector<K>& k,
+                                          const std::vector<V>& v) {
+  size_t size = k.size();
+  if(v.size() != size)
+    throw std::runtime_error("sizes of key and value are different");
+  if(size == 0) return;
+  if(key.size() == 0) { // not created yet
+    *this = unique_hashtable<K,V,H>(k, v, max_load);
+    return;
+  }
+  if(val.size() != key.size())
+    throw std::runtime_error("unique_hashtable: the table has no values");
+  const K* keyp = k.data();
+  const V* valp = v.data();
+  std::vector<size_t> pos(size);
+  size_t* posp = pos.data();
+  locate(keyp, size, posp);
+  size_t table_size = key.size();
+  size_t not_found = std::numeric_limits<size_t>::max();
+  if(UPDATE) {
+    V* table_valp = val.data();
+    V* conflict_valp = conflict_val.data();
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < size; i++) {
+      if(posp[i] < table_size) table_valp[posp[i]] = valp[i];
+      else if(posp[i] != not_found)
+        conflict_valp[posp[i] - table_size] = valp[i];
+    }
+  }
+  std::vector<K> new_key(size);
+  std::vector<V> new_val(size);
+  K* new_keyp = new_key.data();
+  V* new_valp = new_val.data();
+  size_t new_idx = 0;
+  K empty = empty_key;
+  K deleted = deleted_key;
+  int is_sentinel = false;
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 0; i < size; i++) {
+    if(posp[i] == not_found) {
+      new_keyp[new_idx] = keyp[i];
+      new_valp[new_idx++] = valp[i];
+      is_sentinel |= (keyp[i] == empty || keyp[i] == deleted);
+    }
+  }
+  if(new_idx == 0) return;
+  // the slots for probing are not counted
+  size_t home_size = table_size - UNIQUE_HASH_PROBE + 1;
+  if(is_sentinel ||
+     num_keys + num_deleted + new_idx > max_load * home_size) {
+    rebuild(new_keyp, new_valp, new_idx);
+  } else {
+    insert_absent(new_keyp, new_valp, new_idx);
+  }
+}
+
+template <class K, class V, class H>
+void unique_hashtable<K,V,H>::insert(const std::vector<K>& k,
+                                     const std::vector<V>& v) {
+  insert_impl<false>(k, v);
+}
+
+template <class K, class V, class H>
+void unique_hashtable<K,V,H>::upsert(const std::vector<K>& k,
+                                     const std::vector<V>& v) {
+  insert_impl<true>(k, v);
+}
+
+// The slots of the erased keys are marked by deleted_key, because the
+// keys in the conflict area or in the probing window might have the
+// slot as the home slot. They are reused by insert, and removed when
+// the table is created again.
+template <class K, class V, class H>
+void unique_hashtable<K,V,H>::erase(const std::vector<K>& k) {
+  size_t size = k.size();
+  if(size == 0 || key.size() == 0) return;
+  const K* keyp = k.data();
+  std::vector<size_t> pos(size);
+  size_t* posp = pos.data();
+  locate(keyp, size, posp);
+  size_t table_size = key.size();
+  size_t conflict_size = conflict_key.size();
+  size_t not_found = std::numeric_limits<size_t>::max();
+  K* table_keyp = key.data();
+  K deleted = deleted_key;
+  std::vector<int> conflict_erased(conflict_size);
+  int* conflict_erasedp = conflict_erased.data();
+  size_t erased = 0;
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 0; i < size; i++) {
+    if(posp[i] < table_size) {
+      table_keyp[posp[i]] = deleted;
+      erased++;
+    } else if(posp[i] != not_found) {
+      conflict_erasedp[posp[i] - table_size] = true;
+    }
+  }
+  num_keys -= erased;
+  num_deleted += erased;
+  size_t conflict_erased_size = 0;
+  for(size_t i = 0; i < conflict_size; i++) {
+    conflict_erased_size += conflict_erasedp[i];
+  }
+  if(conflict_erased_size > 0) {
+    bool has_val = val.size() > 0; // no conflict_val for set
+    K* conflict_keyp = conflict_key.data();
+    V* conflict_valp = conflict_val.data();
+    size_t out_idx = 0;
+    for(size_t i = 0; i < conflict_size; i++) {
+      if(!conflict_erasedp[i]) {
+        conflict_keyp[out_idx] = conflict_keyp[i];
+        if(has_val) conflict_valp[out_idx] = conflict_valp[i];
+        out_idx++;
+      }
+    }
+    conflict_key.resize(out_idx);
+    if(has_val) conflict_val.resize(out_idx);
+    num_keys -= conflict_erased_size;
+  }
+}
+
 }
 }
 #endif
@@ -2,12 +2,15 @@
 #define JOIN_HPP
 
 #include <vector>
+#include <cstddef>
+#include <stdexcept>
 #if !(defined(_SX) || defined(__ve__))
 #include <unordered_map>
 #else
 #include "../core/radix_sort.hpp"
 #include "../core/set_operations.hpp"
 #include "hashtable.hpp"
+#include "multi_hashtable.hpp"
 #include <limits>
 #endif
 
@@ -210,13 +213,11 @@ void multi_equi_join(std::vector<size_t>& sep,
   if(each % 2 == 0) each++;
 
   size_t sep_size = sep.size();
-  std::vector<size_t> sepdiff(sep_size - 1);
-  for(size_t i = 0; i < sep_size - 1; i++) {
-    sepdiff[i] = sep[i+1] - sep[i];
-  }
+  // longest run of the same key in right
   size_t max = 0;
   for(size_t i = 0; i < sep_size - 1; i++) {
-    if(max < sepdiff[i]) max = sepdiff[i];
+    auto run_size = sep[i+1] - sep[i];
+    if(max < run_size) max = run_size;
   }
   size_t left_idx[JOIN_VLEN];
   size_t right_idx[JOIN_VLEN];
@@ -298,6 +299,19 @@ void multi_equi_join(std::vector<size_t>& sep,
   }
 }
 
+inline std::vector<size_t> gather_idx(const std::vector<size_t>& idx,
+                                      const std::vector<size_t>& pos) {
+  size_t size = pos.size();
+  std::vector<size_t> ret(size);
+  size_t* retp = ret.data();
+  const size_t* idxp = idx.data();
+  const size_t* posp = pos.data();
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 0; i < size; i++) retp[i] = idxp[posp[i]];
+  return ret;
+}
+
 template <class T>
 void equi_join(std::vector<T>& left,
                std::vector<size_t>& left_idx,
@@ -314,11 +328,10 @@ void equi_join(std::vector<T>& left,
     right_idx_out = shrink_missed(looked_up, missed);
   } else {
     ht.clear();
-    radix_sort(right, right_idx);
-    auto sep = set_separate(right);
-    radix_sort(left, left_idx);
-    multi_equi_join(sep, left, left_idx, right, right_idx,
-                    left_idx_out, right_idx_out);
+    multi_hashtable<T, size_t> mht(right, right_idx);
+    std::vector<size_t> pos;
+    mht.lookup(left, pos, right_idx_out);
+    left_idx_out = gather_idx(left_idx, pos);
   }
 }
 
@@ -348,31 +361,12 @@ std::vector<size_t> outer_equi_join(std::vector<T>& left,
     }
     return ret;
   } else {
-    radix_sort(right, right_idx);
-    auto sep = set_separate(right);
-    radix_sort(left, left_idx);
-    multi_equi_join(sep, left, left_idx, right, right_idx,
-                    left_idx_out, right_idx_out);
-    size_t left_idx_out_size = left_idx_out.size();
-    size_t left_idx_size = left_idx.size();
-    std::vector<int> dummy(left_idx_out_size);
-    auto idxhash = unique_hashtable<size_t, int>(left_idx_out, dummy);
-    auto idx_exist = idxhash.check_existence(left_idx);
-
-    std::vector<size_t> onlylefttmp(left_idx_size);
-    size_t* onlylefttmpp = onlylefttmp.data();
-    int* idx_existp = idx_exist.data();
-    size_t* left_idxp = left_idx.data();
-    size_t current = 0;
-    for(size_t i = 0; i < left_idx_size; i++) {
-      if(idx_existp[i] == 0) {
-        onlylefttmpp[current++] = left_idxp[i];
-      }
-    }
-    std::vector<size_t> onlyleft(current);
-    size_t* onlyleftp = onlyleft.data();
-    for(size_t i = 0; i < current; i++) onlyleftp[i] = onlylefttmpp[i];
-    return onlyleft;
+    ht.clear();
+    multi_hashtable<T, size_t> mht(right, right_idx);
+    std::vector<size_t> pos, missed;
+    mht.lookup(left, pos, right_idx_out, missed);
+    left_idx_out = gather_idx(left_idx, pos);
+    return gather_idx(left_idx, missed);
   }
 }
 
@@ -0,0 +1,220 @@
+#ifndef LEARNED_INDEX_HPP
+#define LEARNED_INDEX_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include "../core/lower_bound.hpp"
+
+#if defined(_SX) || defined(__ve__)
+#define LEARNED_INDEX_VLEN 256
+#else
+#define LEARNED_INDEX_VLEN 16 // queries searched at the same time
+#endif
+#define LEARNED_INDEX_MAX_ERROR 32
+
+namespace vstl {
+namespace seq {
+
+// Index that predicts the position of a value in sorted data by
+// piecewise linear segments. The segments are fitted in one pass so
+// that the position of the first of each distinct value is predicted
+// within max_error ("shrinking cone"). lower_bound searches the window
+// around the prediction; if the result is at the edge of the window
+// and is not correct (e.g. many duplicates, or large integers that lose
+// precision in double), it falls back to lower_bound of the whole data.
+// Only the segments are stored; the sorted data should be kept
+// while the index is used.
+template <class T>
+class learned_index {
+public:
+  learned_index() : sortedp(0), num_values(0), max_error(0) {}
+  learned_index(const std::vector<T>& sorted,
+                size_t max_error = LEARNED_INDEX_MAX_ERROR);
+  learned_index(const T* sortedp, size_t size,
+                size_t max_error = LEARNED_INDEX_MAX_ERROR);
+  void lower_bound(const T* to_find, size_t to_find_size,
+                   size_t* ret) const;
+  std::vector<size_t> lower_bound(const std::vector<T>& to_find) const;
+  size_t size() const {return num_values;}
+  size_t num_segments() const {return seg_key.size();}
+private:
+  void build();
+  const T* sortedp;
+  size_t num_values;
+  size_t max_error;
+  // segment i predicts seg_pos[i] + seg_slope[i] * (value - seg_key[i])
+  std::vector<T> seg_key;
+  std::vector<size_t> seg_pos;
+  std::vector<double> seg_slope;
+};
+
+template <class T>
+learned_index<T>::learned_index(const std::vector<T>& sorted,
+                                size_t max_error) :
+  sortedp(sorted.data()), num_values(sorted.size()), max_error(max_error) {
+  build();
+}
+
+template <class T>
+learned_index<T>::learned_index(const T* sortedp, size_t size,
+                                size_t max_error) :
+  sortedp(sortedp), num_values(size), max_error(max_error) {
+  build();
+}
+
+// The slope of a segment is kept in [slope_low, slope_high], where
+// all the points so far are within max_error; if it becomes empty,
+// a new segment starts from the point.
+template <class T>
+void learned_index<T>::build() {
+  if(num_values == 0) return;
+  double err = max_error;
+  double origin_key = sortedp[0];
+  double origin_pos = 0;
+  double slope_low = 0;
+  double slope_high = 1e300;
+  seg_key.push_back(sortedp[0]);
+  seg_pos.push_back(0);
+  for(size_t i = 1; i < num_values; i++) {
+    if(!(sortedp[i-1] < sortedp[i])) continue; // not the first of the value
+    double dx = static_cast<double>(sortedp[i]) - origin_key;
+    double y = static_cast<double>(i) - origin_pos;
+    double low = dx > 0 ? (y - err) / dx : 0;
+    double high = dx > 0 ? (y + err) / dx : 1e300;
+    if(dx > 0 && low <= slope_high && high >= slope_low) {
+      slope_low = std::max(slope_low, low);
+      slope_high = std::min(slope_high, high);
+    } else {
+      seg_slope.push_back(slope_high == 1e300 ? 0 :
+                          (slope_low + slope_high) / 2);
+      origin_key = sortedp[i];
+      origin_pos = i;
+      slope_low = 0;
+      slope_high = 1e300;
+      seg_key.push_back(sortedp[i]);
+      seg_pos.push_back(i);
+    }
+  }
+  seg_slope.push_back(slope_high == 1e300 ? 0 :
+                      (slope_low + slope_high) / 2);
+}
+
+template <class T>
+void learned_index<T>::lower_bound(const T* to_find, size_t to_find_size,
+                                   size_t* ret) const {
+  if(to_find_size == 0) return;
+  size_t n = num_values;
+  if(n == 0) {
+    for(size_t i = 0; i < to_find_size; i++) ret[i] = 0;
+    return;
+  }
+  size_t num_seg = seg_key.size();
+  auto seg_keyp = seg_key.data();
+  auto seg_posp = seg_pos.data();
+  auto seg_slopep = seg_slope.data();
+  std::vector<size_t> fallback;
+  size_t window = 2 * max_error + 3;
+  size_t max_iter = 0;
+  auto tmp = window;
+  while(tmp >>= 1) ++max_iter;
+  max_iter++;
+
+  size_t seg[LEARNED_INDEX_VLEN];
+#pragma _NEC vreg(seg)
+  size_t base[LEARNED_INDEX_VLEN];
+#pragma _NEC vreg(base)
+  size_t len[LEARNED_INDEX_VLEN];
+#pragma _NEC vreg(len)
+  T values[LEARNED_INDEX_VLEN];
+#pragma _NEC vreg(values)
+  int ng[LEARNED_INDEX_VLEN];
+  for(size_t start = 0; start < to_find_size; start += LEARNED_INDEX_VLEN) {
+    size_t crnt_size = std::min(to_find_size - start,
+                                size_t(LEARNED_INDEX_VLEN));
+    auto crnt_to_find = to_find + start;
+    auto crnt_ret = ret + start;
+    // the last segment whose key is not greater than the value (or 0);
+    // the length is halved without branch like the window below
+    for(size_t j = 0; j < crnt_size; j++) {
+      seg[j] = 0;
+      values[j] = crnt_to_find[j];
+    }
+    size_t seg_len = num_seg;
+    while(seg_len > 1) {
+      size_t half = seg_len / 2;
+#pragma _NEC ivdep
+      for(size_t j = 0; j < crnt_size; j++) {
+        auto mid = seg[j] + half;
+        seg[j] = !(values[j] < seg_keyp[mid]) ? mid : seg[j];
+      }
+      seg_len -= half;
+    }
+    // the prediction is clamped to the positions of the segment
+#pragma _NEC ivdep
+    for(size_t j = 0; j < crnt_size; j++) {
+      auto value = values[j];
+      size_t s = seg[j];
+      double first = seg_posp[s];
+      double last = s + 1 < num_seg ? seg_posp[s + 1] : n;
+      double pred = first + seg_slopep[s] *
+        (static_cast<double>(value) - static_cast<double>(seg_keyp[s]));
+      pred = std::max(first, std::min(last, pred));
+      size_t p = static_cast<size_t>(pred);
+      size_t low = p > max_error + 1 ? p - max_error - 1 : 0;
+      size_t high = std::min(p + max_error + 2, n);
+      base[j] = low;
+      len[j] = high - low;
+    }
+    for(size_t i = 0; i < max_iter; i++) {
+#pragma _NEC ivdep
+      for(size_t j = 0; j < crnt_size; j++) {
+        size_t half = len[j] / 2;
+        auto mid = base[j] + half;
+        base[j] = sortedp[mid] < values[j] ? mid : base[j];
+        len[j] -= half;
+      }
+    }
+    // the result is correct unless it is at the edge of the window
+    // and the window is wrong; it is checked by the neighbors
+    for(size_t j = 0; j < crnt_size; j++) {
+      size_t r = base[j] + (sortedp[base[j]] < values[j]);
+      crnt_ret[j] = r;
+      ng[j] = !((r == 0 || sortedp[r - 1] < values[j]) &&
+                (r == n || !(sortedp[r] < values[j])));
+    }
+    for(size_t j = 0; j < crnt_size; j++) {
+      if(ng[j]) fallback.push_back(start + j);
+    }
+  }
+  size_t num_fallback = fallback.size();
+  if(num_fallback > 0) {
+    auto fallbackp = fallback.data();
+    std::vector<T> fallback_value(num_fallback);
+    std::vector<size_t> fallback_ret(num_fallback);
+    auto fallback_valuep = fallback_value.data();
+    auto fallback_retp = fallback_ret.data();
+    for(size_t i = 0; i < num_fallback; i++) {
+      fallback_valuep[i] = to_find[fallbackp[i]];
+    }
+    vstl::seq::lower_bound(sortedp, n, fallback_valuep, num_fallback,
+                           fallback_retp);
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < num_fallback; i++) {
+      ret[fallbackp[i]] = fallback_retp[i];
+    }
+  }
+}
+
+template <class T>
+std::vector<size_t>
+learned_index<T>::lower_bound(const std::vector<T>& to_find) const {
+  std::vector<size_t> ret(to_find.size());
+  lower_bound(to_find.data(), to_find.size(), ret.data());
+  return ret;
+}
+
+}
+}
+#endif
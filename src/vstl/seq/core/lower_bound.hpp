@@ -2,96 +2,23 @@
 #define LOWER_BOUND_HPP
 
 #include <vector>
+#include <algorithm>
 #include <cstddef>
+#include "../core/batched_search.hpp"
 
 #if defined(_SX) || defined(__ve__)
-#define LOWER_BOUND_VLEN 2048 // not vlen, but better than 256
-#else
-#define LOWER_BOUND_VLEN 4
+#define LOWER_BOUND_SORTED_VLEN 256 // lanes of the merge walk
 #endif
 
 namespace vstl {
 namespace seq {
 
-// https://stackoverflow.com/questions/6443569/implementation-of-c-lower-bound
 template <class T>
 void lower_bound(const T* sorted, size_t sorted_size,
                  const T* to_find, size_t to_find_size,
                  size_t* ret) {
-  size_t low[LOWER_BOUND_VLEN];
-//#pragma _NEC vreg(low)
-  size_t high[LOWER_BOUND_VLEN];
-//#pragma _NEC vreg(high)
-  T values[LOWER_BOUND_VLEN];
-//#pragma _NEC vreg(values)
-
-  size_t block_size = to_find_size / LOWER_BOUND_VLEN;
-  size_t rest = to_find_size % LOWER_BOUND_VLEN;
-
-  size_t max_iter = 0;
-  auto tmp = sorted_size;
-  while(tmp >>= 1) ++max_iter; // log2(sorted_size); to avoid fp error
-  max_iter++;
-
-  for(size_t i = 0; i < block_size; i++) {
-    size_t offset = i * LOWER_BOUND_VLEN;
-    auto crnt_to_find = to_find + offset;
-    auto crnt_ret = ret + offset;
-    for(size_t j = 0; j < LOWER_BOUND_VLEN; j++) {
-      low[j] = 0;
-      high[j] = sorted_size;
-      values[j] = crnt_to_find[j];
-    }
-    for(size_t j = 0; j < max_iter; j++) {
-#pragma _NEC ivdep
-      for(size_t k = 0; k < LOWER_BOUND_VLEN; k++) {
-        if(low[k] < high[k]) {
-          auto mid = (low[k] + high[k]) / 2;
-          if(values[k] <= sorted[mid]) {
-            high[k] = mid;
-          } else {
-            low[k] = mid + 1;
-          }
-        }
-      }
-    }
-    for(size_t k = 0; k < LOWER_BOUND_VLEN; k++) {
-      crnt_ret[k] = low[k];
-    }
-  }
-
-  // vreg of different length loop is not supported? (2.4.1)
-  size_t low2[LOWER_BOUND_VLEN]; 
-//#pragma _NEC vreg(low2)
-  size_t high2[LOWER_BOUND_VLEN];
-//#pragma _NEC vreg(high2)
-  T values2[LOWER_BOUND_VLEN];
-//#pragma _NEC vreg(values2)
-
-  size_t offset = block_size * LOWER_BOUND_VLEN;
-  auto crnt_to_find = to_find + offset;
-  auto crnt_ret = ret + offset;
-  for(size_t j = 0; j < rest; j++) {
-    low2[j] = 0;
-    high2[j] = sorted_size;
-    values2[j] = crnt_to_find[j];
-  }
-  for(size_t j = 0; j < max_iter; j++) {
-#pragma _NEC ivdep
-    for(size_t k = 0; k < rest; k++) {
-      if(low2[k] < high2[k]) {
-        auto mid = (low2[k] + high2[k]) / 2;
-        if(values2[k] <= sorted[mid]) {
-          high2[k] = mid;
-        } else {
-          low2[k] = mid + 1;
-        }
-      }
-    }
-  }
-  for(size_t k = 0; k < rest; k++) {
-    crnt_ret[k] = low2[k];
-  }
+  batched_search(sorted, sorted_size, to_find, to_find_size, ret,
+                 std::less<T>());
 }
 
 template <class T>
@@ -108,89 +35,113 @@ template <class T>
 void lower_bound_desc(const T* sorted, size_t sorted_size,
                       const T* to_find, size_t to_find_size,
                       size_t* ret) {
-  size_t low[LOWER_BOUND_VLEN];
-//#pragma _NEC vreg(low)
-  size_t high[LOWER_BOUND_VLEN];
-//#pragma _NEC vreg(high)
-  T values[LOWER_BOUND_VLEN];
-//#pragma _NEC vreg(values)
+  batched_search(sorted, sorted_size, to_find, to_find_size, ret,
+                 std::greater<T>());
+}
 
-  size_t block_size = to_find_size / LOWER_BOUND_VLEN;
-  size_t rest = to_find_size % LOWER_BOUND_VLEN;
+template <class T>
+std::vector<size_t> lower_bound_desc(const std::vector<T>& sorted,
+                                     const std::vector<T>& to_find) {
+  std::vector<size_t> ret(to_find.size());
+  if(to_find.size() == 0 || sorted.size() == 0) return ret;
+  lower_bound_desc(sorted.data(), sorted.size(), to_find.data(), to_find.size(),
+                   ret.data());
+  return ret;
+}
 
+// lower_bound when to_find is also sorted. If sorted_size + to_find_size
+// is less than to_find_size * log2(sorted_size), a merge walk of O(n+m)
+// is used; otherwise lower_bound, which is O(m log n).
+#if defined(_SX) || defined(__ve__)
+// to_find is split into lanes, whose start in sorted is given by
+// lower_bound; each lane walks its part in parallel.
+template <class T>
+void lower_bound_sorted(const T* sorted, size_t sorted_size,
+                        const T* to_find, size_t to_find_size,
+                        size_t* ret) {
+  if(to_find_size == 0) return;
   size_t max_iter = 0;
   auto tmp = sorted_size;
-  while(tmp >>= 1) ++max_iter; // log2(sorted_size); to avoid fp error
+  while(tmp >>= 1) ++max_iter;
   max_iter++;
-
-  for(size_t i = 0; i < block_size; i++) {
-    size_t offset = i * LOWER_BOUND_VLEN;
-    auto crnt_to_find = to_find + offset;
-    auto crnt_ret = ret + offset;
-    for(size_t j = 0; j < LOWER_BOUND_VLEN; j++) {
-      low[j] = 0;
-      high[j] = sorted_size;
-      values[j] = crnt_to_find[j];
-    }
-    for(size_t j = 0; j < max_iter; j++) {
-#pragma _NEC ivdep
-      for(size_t k = 0; k < LOWER_BOUND_VLEN; k++) {
-        if(low[k] < high[k]) {
-          auto mid = (low[k] + high[k]) / 2;
-          if(values[k] >= sorted[mid]) {
-            high[k] = mid;
-          } else {
-            low[k] = mid + 1;
-          }
-        }
-      }
-    }
-    for(size_t k = 0; k < LOWER_BOUND_VLEN; k++) {
-      crnt_ret[k] = low[k];
-    }
+  if(sorted_size + to_find_size >= to_find_size * max_iter) {
+    lower_bound(sorted, sorted_size, to_find, to_find_size, ret);
+    return;
   }
-
-  // vreg of different length loop is not supported? (2.4.1)
-  size_t low2[LOWER_BOUND_VLEN]; 
-//#pragma _NEC vreg(low2)
-  size_t high2[LOWER_BOUND_VLEN];
-//#pragma _NEC vreg(high2)
-  T values2[LOWER_BOUND_VLEN];
-//#pragma _NEC vreg(values2)
-
-  size_t offset = block_size * LOWER_BOUND_VLEN;
-  auto crnt_to_find = to_find + offset;
-  auto crnt_ret = ret + offset;
-  for(size_t j = 0; j < rest; j++) {
-    low2[j] = 0;
-    high2[j] = sorted_size;
-    values2[j] = crnt_to_find[j];
+  size_t each = (to_find_size + LOWER_BOUND_SORTED_VLEN - 1) /
+    LOWER_BOUND_SORTED_VLEN;
+  T first[LOWER_BOUND_SORTED_VLEN];
+  size_t start[LOWER_BOUND_SORTED_VLEN];
+  for(size_t i = 0; i < LOWER_BOUND_SORTED_VLEN; i++) {
+    first[i] = to_find[std::min(each * i, to_find_size - 1)];
+  }
+  lower_bound(sorted, sorted_size, first, LOWER_BOUND_SORTED_VLEN, start);
+
+  size_t sorted_idx[LOWER_BOUND_SORTED_VLEN];
+#pragma _NEC vreg(sorted_idx)
+  size_t sorted_stop[LOWER_BOUND_SORTED_VLEN];
+#pragma _NEC vreg(sorted_stop)
+  size_t find_idx[LOWER_BOUND_SORTED_VLEN];
+#pragma _NEC vreg(find_idx)
+  size_t find_stop[LOWER_BOUND_SORTED_VLEN];
+#pragma _NEC vreg(find_stop)
+  size_t max_size = 0;
+  for(size_t i = 0; i < LOWER_BOUND_SORTED_VLEN; i++) {
+    sorted_idx[i] = start[i];
+    sorted_stop[i] = i + 1 < LOWER_BOUND_SORTED_VLEN ? start[i + 1] :
+      sorted_size;
+    find_idx[i] = std::min(each * i, to_find_size);
+    find_stop[i] = std::min(each * (i + 1), to_find_size);
+    size_t size = (sorted_stop[i] - sorted_idx[i]) +
+      (find_stop[i] - find_idx[i]);
+    if(size > max_size) max_size = size;
   }
-  for(size_t j = 0; j < max_iter; j++) {
+  for(size_t j = 0; j < max_size; j++) {
+#pragma cdir nodep
 #pragma _NEC ivdep
-    for(size_t k = 0; k < rest; k++) {
-      if(low2[k] < high2[k]) {
-        auto mid = (low2[k] + high2[k]) / 2;
-        if(values2[k] >= sorted[mid]) {
-          high2[k] = mid;
+    for(size_t i = 0; i < LOWER_BOUND_SORTED_VLEN; i++) {
+      if(find_idx[i] < find_stop[i]) {
+        if(sorted_idx[i] < sorted_stop[i] &&
+           sorted[sorted_idx[i]] < to_find[find_idx[i]]) {
+          sorted_idx[i]++;
         } else {
-          low2[k] = mid + 1;
+          ret[find_idx[i]] = sorted_idx[i];
+          find_idx[i]++;
         }
       }
     }
   }
-  for(size_t k = 0; k < rest; k++) {
-    crnt_ret[k] = low2[k];
+}
+#else
+template <class T>
+void lower_bound_sorted(const T* sorted, size_t sorted_size,
+                        const T* to_find, size_t to_find_size,
+                        size_t* ret) {
+  if(to_find_size == 0) return;
+  size_t max_iter = 0;
+  auto tmp = sorted_size;
+  while(tmp >>= 1) ++max_iter;
+  max_iter++;
+  if(sorted_size + to_find_size >= to_find_size * max_iter) {
+    lower_bound(sorted, sorted_size, to_find, to_find_size, ret);
+    return;
+  }
+  size_t pos = 0;
+  for(size_t i = 0; i < to_find_size; i++) {
+    auto value = to_find[i];
+    while(pos < sorted_size && sorted[pos] < value) pos++;
+    ret[i] = pos;
   }
 }
+#endif
 
 template <class T>
-std::vector<size_t> lower_bound_desc(const std::vector<T>& sorted,
-                                     const std::vector<T>& to_find) {
+std::vector<size_t> lower_bound_sorted(const std::vector<T>& sorted,
+                                       const std::vector<T>& to_find) {
   std::vector<size_t> ret(to_find.size());
   if(to_find.size() == 0 || sorted.size() == 0) return ret;
-  lower_bound_desc(sorted.data(), sorted.size(), to_find.data(), to_find.size(),
-                   ret.data());
+  lower_bound_sorted(sorted.data(), sorted.size(), to_find.data(),
+                     to_find.size(), ret.data());
   return ret;
 }
 
@@ -0,0 +1,166 @@
+#ifndef MERGE_CURSOR_HPP
+#define MERGE_CURSOR_HPP
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include "../core/set_operations.hpp"
+
+namespace vstl {
+namespace seq {
+
+// Merges sorted data that come from N sources chunk by chunk.
+// A source is called to get the next chunk, and returns false if there
+// are no more chunks. next() returns batch_size merged data (fewer only
+// at the end) and false if all the data are returned.
+// Each source buffers at least batch_size data before a batch is made,
+// so that the smallest batch_size buffered data are the smallest of all
+// remaining data; memory is bounded by (batch_size + chunk size) * N.
+template <class T, class K = int, class C = std::less<T>>
+class merge_cursor {
+public:
+  typedef std::function<bool(std::vector<T>&)> source_type;
+  typedef std::function<bool(std::vector<T>&, std::vector<K>&)>
+    pair_source_type;
+  merge_cursor(const std::vector<source_type>& sources,
+               size_t batch_size, C comp = C());
+  merge_cursor(const std::vector<pair_source_type>& sources,
+               size_t batch_size, C comp = C());
+  bool next(std::vector<T>& out);
+  bool next(std::vector<T>& out, std::vector<K>& out_val);
+private:
+  void fill(size_t i);
+  size_t merge(T* op, K* ovp);
+  std::vector<source_type> key_sources;
+  std::vector<pair_source_type> pair_sources;
+  size_t batch_size;
+  C comp;
+  std::vector<std::vector<T>> buf;
+  std::vector<std::vector<K>> val_buf;
+  std::vector<size_t> pos;
+  std::vector<int> exhausted;
+  std::vector<T> chunk;
+  std::vector<K> val_chunk;
+};
+
+template <class T, class K, class C>
+merge_cursor<T,K,C>::merge_cursor(const std::vector<source_type>& sources,
+                                  size_t batch_size, C comp) :
+  key_sources(sources), batch_size(batch_size), comp(comp),
+  buf(sources.size()), val_buf(sources.size()), pos(sources.size()),
+  exhausted(sources.size()) {
+  if(batch_size == 0)
+    throw std::runtime_error("merge_cursor: batch_size should be > 0");
+}
+
+template <class T, class K, class C>
+merge_cursor<T,K,C>::merge_cursor(const std::vector<pair_source_type>&
+                                  sources,
+                                  size_t batch_size, C comp) :
+  pair_sources(sources), batch_size(batch_size), comp(comp),
+  buf(sources.size()), val_buf(sources.size()), pos(sources.size()),
+  exhausted(sources.size()) {
+  if(batch_size == 0)
+    throw std::runtime_error("merge_cursor: batch_size should be > 0");
+}
+
+// consumed data are removed before new chunks are appended
+template <class T, class K, class C>
+void merge_cursor<T,K,C>::fill(size_t i) {
+  bool has_val = pair_sources.size() > 0;
+  auto& b = buf[i];
+  auto& vb = val_buf[i];
+  size_t remain = b.size() - pos[i];
+  if(exhausted[i] || remain >= batch_size) return;
+  if(pos[i] > 0) {
+    auto bp = b.data();
+    auto vbp = vb.data();
+    auto p = pos[i];
+    for(size_t j = 0; j < remain; j++) bp[j] = bp[p + j];
+    if(has_val) {
+      for(size_t j = 0; j < remain; j++) vbp[j] = vbp[p + j];
+    }
+    b.resize(remain);
+    if(has_val) vb.resize(remain);
+    pos[i] = 0;
+  }
+  while(b.size() < batch_size) {
+    bool ok = has_val ? pair_sources[i](chunk, val_chunk) :
+      key_sources[i](chunk);
+    if(!ok) {
+      exhausted[i] = true;
+      break;
+    }
+    if(has_val && chunk.size() != val_chunk.size())
+      throw std::runtime_error("merge_cursor: size mismatch");
+    b.insert(b.end(), chunk.begin(), chunk.end());
+    if(has_val) vb.insert(vb.end(), val_chunk.begin(), val_chunk.end());
+  }
+}
+
+// the batch is split from the buffers by set_multimerge_split
+// and merged by set_multimerge_impl
+template <class T, class K, class C>
+size_t merge_cursor<T,K,C>::merge(T* op, K* ovp) {
+  size_t num_sources = buf.size();
+  std::vector<const T*> keyp;
+  std::vector<const K*> valp;
+  std::vector<size_t> sizes;
+  std::vector<size_t> src;
+  size_t total = 0;
+  for(size_t i = 0; i < num_sources; i++) {
+    size_t remain = buf[i].size() - pos[i];
+    if(remain == 0) continue;
+    keyp.push_back(buf[i].data() + pos[i]);
+    if(ovp) valp.push_back(val_buf[i].data() + pos[i]);
+    sizes.push_back(remain);
+    src.push_back(i);
+    total += remain;
+  }
+  size_t way = src.size();
+  size_t rank = std::min(batch_size, total);
+  std::vector<size_t> split(sizes);
+  if(rank < total)
+    set_multimerge_split(keyp.data(), sizes.data(), way, rank,
+                         split.data(), comp);
+  if(way == 1) {
+    for(size_t j = 0; j < rank; j++) op[j] = keyp[0][j];
+    if(ovp) {
+      for(size_t j = 0; j < rank; j++) ovp[j] = valp[0][j];
+    }
+  } else if(way > 1) {
+    set_multimerge_impl(keyp.data(), ovp ? valp.data() : 0,
+                        split.data(), way, op, ovp, comp);
+  }
+  for(size_t i = 0; i < way; i++) pos[src[i]] += split[i];
+  return rank;
+}
+
+template <class T, class K, class C>
+bool merge_cursor<T,K,C>::next(std::vector<T>& out) {
+  if(pair_sources.size() > 0)
+    throw std::runtime_error("merge_cursor: sources have values");
+  for(size_t i = 0; i < buf.size(); i++) fill(i);
+  out.resize(batch_size);
+  out.resize(merge(out.data(), static_cast<K*>(0)));
+  return out.size() > 0;
+}
+
+template <class T, class K, class C>
+bool merge_cursor<T,K,C>::next(std::vector<T>& out,
+                               std::vector<K>& out_val) {
+  if(key_sources.size() > 0)
+    throw std::runtime_error("merge_cursor: sources have no values");
+  for(size_t i = 0; i < buf.size(); i++) fill(i);
+  out.resize(batch_size);
+  out_val.resize(batch_size);
+  auto size = merge(out.data(), out_val.data());
+  out.resize(size);
+  out_val.resize(size);
+  return size > 0;
+}
+
+}
+}
+#endif
@@ -0,0 +1,173 @@
+#ifndef MULTI_HASHTABLE_HPP
+#define MULTI_HASHTABLE_HPP
+
+#include <vector>
+#include <stdexcept>
+
+#include "../core/radix_sort.hpp"
+#include "../core/set_operations.hpp"
+#include "../core/prefix_sum.hpp"
+#include "../core/hashtable.hpp"
+
+namespace vstl {
+namespace seq {
+
+// Hash table that allows duplicated keys. The values are sorted by key
+// and stored in one array; the values of a key are
+// val[offset[g], offset[g+1]), where g is the group of the key
+// that is looked up by unique_hashtable.
+template <class K, class V, class H = modulo_hash>
+class multi_hashtable {
+public:
+  multi_hashtable() {}
+  multi_hashtable(const std::vector<K>& k, const std::vector<V>& v,
+                  double load_factor = 1.0 / HASH_TABLE_SIZE_MULT);
+  // all the matches as pairs of (position in k, value); the positions
+  // are in ascending order. miss is the positions that do not match.
+  void lookup(const std::vector<K>& k, std::vector<size_t>& idx_out,
+              std::vector<V>& val_out, std::vector<size_t>& miss);
+  void lookup(const std::vector<K>& k, std::vector<size_t>& idx_out,
+              std::vector<V>& val_out) {
+    std::vector<size_t> miss;
+    lookup(k, idx_out, val_out, miss);
+  }
+  std::vector<size_t> count(const std::vector<K>& k); // number of values
+  size_t num_keys() const {return offset.size() > 0 ? offset.size() - 1 : 0;}
+  size_t size() const {return val.size();}
+  size_t memory_usage() const {
+    return group.memory_usage() + offset.capacity() * sizeof(size_t) +
+      val.capacity() * sizeof(V);
+  }
+  void clear() {
+    group.clear();
+    std::vector<size_t> offset_tmp; offset_tmp.swap(offset);
+    std::vector<V> val_tmp; val_tmp.swap(val);
+  }
+private:
+  std::vector<size_t> lookup_count(const std::vector<K>& k,
+                                   std::vector<size_t>& g,
+                                   std::vector<size_t>& miss);
+  unique_hashtable<K,size_t,H> group;
+  std::vector<size_t> offset;
+  std::vector<V> val;
+};
+
+template <class K, class V, class H>
+multi_hashtable<K,V,H>::multi_hashtable(const std::vector<K>& k,
+                                        const std::vector<V>& v,
+                                        double load_factor) {
+  size_t size = k.size();
+  if(v.size() != size)
+    throw std::runtime_error("sizes of key and value are different");
+  std::vector<K> sorted_key(k);
+  val = v;
+  radix_sort(sorted_key, val);
+  offset = set_separate(sorted_key);
+  size_t num_groups = offset.size() - 1;
+  std::vector<K> group_key(num_groups);
+  std::vector<size_t> group_id(num_groups);
+  K* group_keyp = group_key.data();
+  size_t* group_idp = group_id.data();
+  K* sorted_keyp = sorted_key.data();
+  size_t* offsetp = offset.data();
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 0; i < num_groups; i++) {
+    group_keyp[i] = sorted_keyp[offsetp[i]];
+    group_idp[i] = i;
+  }
+  group = unique_hashtable<K,size_t,H>(group_key, group_id, load_factor);
+}
+
+// group and number of values of each key; 0 if missed
+template <class K, class V, class H>
+std::vector<size_t>
+multi_hashtable<K,V,H>::lookup_count(const std::vector<K>& k,
+                                     std::vector<size_t>& g,
+                                     std::vector<size_t>& miss) {
+  size_t size = k.size();
+  g = group.lookup(k, miss);
+  std::vector<size_t> cnt(size);
+  size_t* cntp = cnt.data();
+  size_t* gp = g.data();
+  size_t* offsetp = offset.data();
+  size_t* missp = miss.data();
+  size_t miss_size = miss.size();
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 0; i < miss_size; i++) gp[missp[i]] = 0;
+  if(offset.size() > 1) {
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < size; i++) {
+      cntp[i] = offsetp[gp[i] + 1] - offsetp[gp[i]];
+    }
+  }
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 0; i < miss_size; i++) cntp[missp[i]] = 0;
+  return cnt;
+}
+
+template <class K, class V, class H>
+std::vector<size_t>
+multi_hashtable<K,V,H>::count(const std::vector<K>& k) {
+  std::vector<size_t> g, miss;
+  return lookup_count(k, g, miss);
+}
+
+// The matches are expanded without a loop over the values of each
+// key: the start of each matched key is marked, and the prefix sum of
+// the marks gives the key of each output position.
+template <class K, class V, class H>
+void multi_hashtable<K,V,H>::lookup(const std::vector<K>& k,
+                                    std::vector<size_t>& idx_out,
+                                    std::vector<V>& val_out,
+                                    std::vector<size_t>& miss) {
+  size_t size = k.size();
+  std::vector<size_t> g;
+  auto cnt = lookup_count(k, g, miss);
+  size_t found_size = size - miss.size();
+  std::vector<size_t> found(found_size), found_cnt(found_size);
+  size_t* foundp = found.data();
+  size_t* found_cntp = found_cnt.data();
+  size_t* cntp = cnt.data();
+  size_t found_idx = 0;
+  for(size_t i = 0; i < size; i++) {
+    if(cntp[i] > 0) {
+      foundp[found_idx] = i;
+      found_cntp[found_idx++] = cntp[i];
+    }
+  }
+  auto end = prefix_sum(found_cnt);
+  size_t total = found_size > 0 ? end[found_size - 1] : 0;
+  idx_out.resize(total);
+  val_out.resize(total);
+  if(total == 0) return;
+  std::vector<size_t> mark(total);
+  size_t* markp = mark.data();
+  size_t* endp = end.data();
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t i = 1; i < found_size; i++) markp[endp[i - 1]] = 1;
+  auto rank = prefix_sum(mark);
+  size_t* rankp = rank.data();
+  size_t* gp = g.data();
+  size_t* offsetp = offset.data();
+  V* valp = val.data();
+  size_t* idx_outp = idx_out.data();
+  V* val_outp = val_out.data();
+#pragma cdir nodep
+#pragma _NEC ivdep
+  for(size_t pos = 0; pos < total; pos++) {
+    size_t r = rankp[pos];
+    size_t start = endp[r] - found_cntp[r];
+    size_t q = foundp[r];
+    idx_outp[pos] = q;
+    val_outp[pos] = valp[offsetp[gp[q]] + pos - start];
+  }
+}
+
+}
+}
+#endif
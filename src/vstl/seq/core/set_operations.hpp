@@ -3,11 +3,17 @@
 
 #include <vector>
 #include <algorithm>
+#include <functional>
 #include <utility>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include "../../common/utility.hpp"
 #include "../core/radix_sort.hpp" // for reverse
 #include "../core/lower_bound.hpp"
 #include "../core/upper_bound.hpp"
+#include "../core/prefix_sum.hpp"
+#include "../core/dense_bitset.hpp"
 
 #define SET_VLEN 768
 #define SET_VLEN_EACH 256
@@ -16,63 +22,352 @@ namespace vstl {
 namespace seq {
 
 #if !(defined(_SX) || defined(__ve__))
+
+// Branchless merge kernels: the comparison result is used as an
+// increment instead of a branch, which avoids misprediction on random data.
+// Output buffer should be large enough; returns the number of written data.
+template <class T, class C>
+size_t set_intersection_branchless(const T* lp, size_t left_size,
+                                   const T* rp, size_t right_size,
+                                   T* op, C comp) {
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    int left_lt = comp(leftelm, rightelm);
+    int right_lt = comp(rightelm, leftelm);
+    op[out_idx] = leftelm;
+    out_idx += !(left_lt | right_lt);
+    left_idx += !right_lt;
+    right_idx += !left_lt;
+  }
+  return out_idx;
+}
+
+template <class T, class C>
+size_t set_union_branchless(const T* lp, size_t left_size,
+                            const T* rp, size_t right_size,
+                            T* op, C comp) {
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    int left_lt = comp(leftelm, rightelm);
+    int right_lt = comp(rightelm, leftelm);
+    op[out_idx++] = right_lt ? rightelm : leftelm;
+    left_idx += !right_lt;
+    right_idx += !left_lt;
+  }
+  for(; left_idx < left_size; left_idx++) op[out_idx++] = lp[left_idx];
+  for(; right_idx < right_size; right_idx++) op[out_idx++] = rp[right_idx];
+  return out_idx;
+}
+
+template <class T, class C>
+size_t set_difference_branchless(const T* lp, size_t left_size,
+                                 const T* rp, size_t right_size,
+                                 T* op, C comp) {
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    int left_lt = comp(leftelm, rightelm);
+    int right_lt = comp(rightelm, leftelm);
+    op[out_idx] = leftelm;
+    out_idx += left_lt;
+    left_idx += !right_lt;
+    right_idx += !left_lt;
+  }
+  for(; left_idx < left_size; left_idx++) op[out_idx++] = lp[left_idx];
+  return out_idx;
+}
+
+template <class T, class C>
+size_t set_merge_branchless(const T* lp, size_t left_size,
+                            const T* rp, size_t right_size,
+                            T* op, C comp) {
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    int right_lt = comp(rightelm, leftelm);
+    op[out_idx++] = right_lt ? rightelm : leftelm;
+    left_idx += !right_lt;
+    right_idx += right_lt;
+  }
+  for(; left_idx < left_size; left_idx++) op[out_idx++] = lp[left_idx];
+  for(; right_idx < right_size; right_idx++) op[out_idx++] = rp[right_idx];
+  return out_idx;
+}
+
+template <class T, class K, class C>
+size_t set_merge_pair_branchless(const T* lp, const K* lvp, size_t left_size,
+                                 const T* rp, const K* rvp, size_t right_size,
+                                 T* op, K* ovp, C comp) {
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    auto leftval = lvp[left_idx];
+    auto rightval = rvp[right_idx];
+    int right_lt = comp(rightelm, leftelm);
+    op[out_idx] = right_lt ? rightelm : leftelm;
+    ovp[out_idx] = right_lt ? rightval : leftval;
+    out_idx++;
+    left_idx += !right_lt;
+    right_idx += right_lt;
+  }
+  for(; left_idx < left_size; left_idx++) {
+    op[out_idx] = lp[left_idx];
+    ovp[out_idx++] = lvp[left_idx];
+  }
+  for(; right_idx < right_size; right_idx++) {
+    op[out_idx] = rp[right_idx];
+    ovp[out_idx++] = rvp[right_idx];
+  }
+  return out_idx;
+}
+
+template <class T, class K, class C>
+size_t set_intersection_pair_branchless(const T* lp, const K* lvp,
+                                        size_t left_size,
+                                        const T* rp, size_t right_size,
+                                        T* op, K* ovp, C comp) {
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    int left_lt = comp(leftelm, rightelm);
+    int right_lt = comp(rightelm, leftelm);
+    op[out_idx] = leftelm;
+    ovp[out_idx] = lvp[left_idx];
+    out_idx += !(left_lt | right_lt);
+    left_idx += !right_lt;
+    right_idx += !left_lt;
+  }
+  return out_idx;
+}
+
+template <class T, class C>
+size_t set_intersection_index_branchless(const T* lp, size_t left_size,
+                                         const T* rp, size_t right_size,
+                                         size_t* olp, size_t* orp, C comp) {
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    int left_lt = comp(leftelm, rightelm);
+    int right_lt = comp(rightelm, leftelm);
+    olp[out_idx] = left_idx;
+    orp[out_idx] = right_idx;
+    out_idx += !(left_lt | right_lt);
+    left_idx += !right_lt;
+    right_idx += !left_lt;
+  }
+  return out_idx;
+}
+
+template <class T, class K, class C>
+size_t set_union_pair_branchless(const T* lp, const K* lvp, size_t left_size,
+                                 const T* rp, const K* rvp, size_t right_size,
+                                 T* op, K* ovp, C comp) {
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    auto leftval = lvp[left_idx];
+    auto rightval = rvp[right_idx];
+    int left_lt = comp(leftelm, rightelm);
+    int right_lt = comp(rightelm, leftelm);
+    op[out_idx] = right_lt ? rightelm : leftelm;
+    ovp[out_idx] = right_lt ? rightval : leftval;
+    out_idx++;
+    left_idx += !right_lt;
+    right_idx += !left_lt;
+  }
+  for(; left_idx < left_size; left_idx++) {
+    op[out_idx] = lp[left_idx];
+    ovp[out_idx++] = lvp[left_idx];
+  }
+  for(; right_idx < right_size; right_idx++) {
+    op[out_idx] = rp[right_idx];
+    ovp[out_idx++] = rvp[right_idx];
+  }
+  return out_idx;
+}
+
+template <class T, class K, class C>
+size_t set_difference_pair_branchless(const T* lp, const K* lvp,
+                                      size_t left_size,
+                                      const T* rp, size_t right_size,
+                                      T* op, K* ovp, C comp) {
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    int left_lt = comp(leftelm, rightelm);
+    int right_lt = comp(rightelm, leftelm);
+    op[out_idx] = leftelm;
+    ovp[out_idx] = lvp[left_idx];
+    out_idx += left_lt;
+    left_idx += !right_lt;
+    right_idx += !left_lt;
+  }
+  for(; left_idx < left_size; left_idx++) {
+    op[out_idx] = lp[left_idx];
+    ovp[out_idx++] = lvp[left_idx];
+  }
+  return out_idx;
+}
+
+template <class T, class C>
+size_t set_symmetric_difference_branchless(const T* lp, size_t left_size,
+                                           const T* rp, size_t right_size,
+                                           T* op, C comp) {
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    int left_lt = comp(leftelm, rightelm);
+    int right_lt = comp(rightelm, leftelm);
+    op[out_idx] = left_lt ? leftelm : rightelm;
+    out_idx += left_lt | right_lt;
+    left_idx += !right_lt;
+    right_idx += !left_lt;
+  }
+  for(; left_idx < left_size; left_idx++) op[out_idx++] = lp[left_idx];
+  for(; right_idx < right_size; right_idx++) op[out_idx++] = rp[right_idx];
+  return out_idx;
+}
+
+template <class T, class K, class C>
+size_t set_symmetric_difference_pair_branchless(const T* lp, const K* lvp,
+                                                size_t left_size,
+                                                const T* rp, const K* rvp,
+                                                size_t right_size,
+                                                T* op, K* ovp, C comp) {
+  size_t left_idx = 0, right_idx = 0, out_idx = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    auto leftval = lvp[left_idx];
+    auto rightval = rvp[right_idx];
+    int left_lt = comp(leftelm, rightelm);
+    int right_lt = comp(rightelm, leftelm);
+    op[out_idx] = left_lt ? leftelm : rightelm;
+    ovp[out_idx] = left_lt ? leftval : rightval;
+    out_idx += left_lt | right_lt;
+    left_idx += !right_lt;
+    right_idx += !left_lt;
+  }
+  for(; left_idx < left_size; left_idx++) {
+    op[out_idx] = lp[left_idx];
+    ovp[out_idx++] = lvp[left_idx];
+  }
+  for(; right_idx < right_size; right_idx++) {
+    op[out_idx] = rp[right_idx];
+    ovp[out_idx++] = rvp[right_idx];
+  }
+  return out_idx;
+}
+
+template <class T, class C>
+size_t set_count_intersection_branchless(const T* lp, size_t left_size,
+                                         const T* rp, size_t right_size,
+                                         C comp) {
+  size_t left_idx = 0, right_idx = 0, count = 0;
+  while(left_idx < left_size && right_idx < right_size) {
+    auto leftelm = lp[left_idx];
+    auto rightelm = rp[right_idx];
+    int left_lt = comp(leftelm, rightelm);
+    int right_lt = comp(rightelm, leftelm);
+    count += !(left_lt | right_lt);
+    left_idx += !right_lt;
+    right_idx += !left_lt;
+  }
+  return count;
+}
+
 template <class T>
-std::vector<T> set_intersection(const T* leftp, size_t left_size,
-                                const T* rightp, size_t right_size) {
-  std::vector<T> ret;
-  std::set_intersection(leftp, leftp + left_size,
-                        rightp, rightp + right_size,
-                        std::back_inserter(ret));
-  return ret;
+size_t set_intersection_impl(const T* leftp, size_t left_size,
+                             const T* rightp, size_t right_size,
+                             T* outp) {
+  return set_intersection_branchless(leftp, left_size, rightp, right_size,
+                                     outp, std::less<T>());
 }
 
 template <class T>
-std::vector<T> set_union(const T* leftp, size_t left_size,
-                         const T* rightp, size_t right_size) {
-  std::vector<T> ret;
-  std::set_union(leftp, leftp + left_size,
-                 rightp, rightp + right_size,
-                 std::back_inserter(ret));
-  return ret;
+size_t set_union_impl(const T* leftp, size_t left_size,
+                      const T* rightp, size_t right_size,
+                      T* outp) {
+  return set_union_branchless(leftp, left_size, rightp, right_size,
+                              outp, std::less<T>());
 }
 
 template <class T>
-std::vector<T> set_difference(const T* leftp, size_t left_size,
-                              const T* rightp, size_t right_size) {
-  std::vector<T> ret;
-  std::set_difference(leftp, leftp + left_size,
-                      rightp, rightp + right_size,
-                      std::back_inserter(ret));
-  return ret;
+size_t set_difference_impl(const T* leftp, size_t left_size,
+                           const T* rightp, size_t right_size,
+                           T* outp) {
+  return set_difference_branchless(leftp, left_size, rightp, right_size,
+                                   outp, std::less<T>());
 }
 
 template <class T>
-std::vector<T> set_merge(const T* leftp, size_t left_size,
-                         const T* rightp, size_t right_size) {
-  std::vector<T> ret;
-  std::merge(leftp, leftp + left_size,
-             rightp, rightp + right_size,
-             std::back_inserter(ret));
-  return ret;
+size_t set_merge_impl(const T* leftp, size_t left_size,
+                      const T* rightp, size_t right_size,
+                      T* outp) {
+  return set_merge_branchless(leftp, left_size, rightp, right_size,
+                              outp, std::less<T>());
 }
 
 template <class T>
-std::vector<T> set_merge_desc(const T* leftp, size_t left_size,
-                              const T* rightp, size_t right_size) {
-  std::vector<T> ret;
-  std::merge(leftp, leftp + left_size,
-             rightp, rightp + right_size,
-             std::back_inserter(ret), std::greater<T>());
-  return ret;
+size_t set_merge_desc_impl(const T* leftp, size_t left_size,
+                           const T* rightp, size_t right_size,
+                           T* outp) {
+  return set_merge_branchless(leftp, left_size, rightp, right_size,
+                              outp, std::greater<T>());
 }
 
-template <class K, class V>
-struct set_merge_pair_helper {
-  bool operator()(const std::pair<K,V>& left,
-                  const std::pair<K,V>& right) {
-    return left.first < right.first;
-  }
-};
+template <class T>
+size_t set_intersection_desc_impl(const T* leftp, size_t left_size,
+                                  const T* rightp, size_t right_size,
+                                  T* outp) {
+  return set_intersection_branchless(leftp, left_size, rightp, right_size,
+                                     outp, std::greater<T>());
+}
+
+template <class T>
+size_t set_union_desc_impl(const T* leftp, size_t left_size,
+                           const T* rightp, size_t right_size,
+                           T* outp) {
+  return set_union_branchless(leftp, left_size, rightp, right_size,
+                              outp, std::greater<T>());
+}
+
+template <class T>
+size_t set_difference_desc_impl(const T* leftp, size_t left_size,
+                                const T* rightp, size_t right_size,
+                                T* outp) {
+  return set_difference_branchless(leftp, left_size, rightp, right_size,
+                                   outp, std::greater<T>());
+}
+
+template <class T>
+size_t set_symmetric_difference_impl(const T* leftp, size_t left_size,
+                                     const T* rightp, size_t right_size,
+                                     T* outp) {
+  return set_symmetric_difference_branchless(leftp, left_size,
+                                             rightp, right_size,
+                                             outp, std::less<T>());
+}
+
+template <class T>
+size_t set_count_intersection(const T* leftp, size_t left_size,
+                              const T* rightp, size_t right_size) {
+  return set_count_intersection_branchless(leftp, left_size,
+                                           rightp, right_size,
+                                           std::less<T>());
+}
 
 template <class T, class K>
 void set_merge_pair(const T* leftp,
@@ -83,36 +378,13 @@ void set_merge_pair(const T* leftp,
                     size_t right_size,
                     std::vector<T>& out,
                     std::vector<K>& out_val) {
-  std::vector<std::pair<T,K>> left_pair(left_size);
-  std::vector<std::pair<T,K>> right_pair(right_size);
-  std::vector<std::pair<T,K>> out_pair;
-  for(size_t i = 0; i < left_size; i++) {
-    left_pair[i].first = leftp[i];
-    left_pair[i].second = left_valp[i];
-  }
-  for(size_t i = 0; i < right_size; i++) {
-    right_pair[i].first = rightp[i];
-    right_pair[i].second = right_valp[i];
-  }
-  std::merge(left_pair.begin(), left_pair.end(),
-             right_pair.begin(), right_pair.end(),
-             std::back_inserter(out_pair), set_merge_pair_helper<T,K>());
   out.resize(left_size + right_size);
   out_val.resize(left_size + right_size);
-  for(size_t i = 0; i < left_size + right_size; i++) {
-    out[i] = out_pair[i].first;
-    out_val[i] = out_pair[i].second;
-  }
+  set_merge_pair_branchless(leftp, left_valp, left_size,
+                            rightp, right_valp, right_size,
+                            out.data(), out_val.data(), std::less<T>());
 }
 
-template <class K, class V>
-struct set_merge_pair_desc_helper {
-  bool operator()(const std::pair<K,V>& left,
-                  const std::pair<K,V>& right) {
-    return left.first > right.first;
-  }
-};
-
 template <class T, class K>
 void set_merge_pair_desc(const T* leftp,
                          const K* left_valp,
@@ -122,64 +394,159 @@ void set_merge_pair_desc(const T* leftp,
                          size_t right_size,
                          std::vector<T>& out,
                          std::vector<K>& out_val) {
-  std::vector<std::pair<T,K>> left_pair(left_size);
-  std::vector<std::pair<T,K>> right_pair(right_size);
-  std::vector<std::pair<T,K>> out_pair;
-  for(size_t i = 0; i < left_size; i++) {
-    left_pair[i].first = leftp[i];
-    left_pair[i].second = left_valp[i];
-  }
-  for(size_t i = 0; i < right_size; i++) {
-    right_pair[i].first = rightp[i];
-    right_pair[i].second = right_valp[i];
-  }
-  std::merge(left_pair.begin(), left_pair.end(),
-             right_pair.begin(), right_pair.end(),
-             std::back_inserter(out_pair), set_merge_pair_desc_helper<T,K>());
   out.resize(left_size + right_size);
   out_val.resize(left_size + right_size);
-  for(size_t i = 0; i < left_size + right_size; i++) {
-    out[i] = out_pair[i].first;
-    out_val[i] = out_pair[i].second;
-  }
+  set_merge_pair_branchless(leftp, left_valp, left_size,
+                            rightp, right_valp, right_size,
+                            out.data(), out_val.data(), std::greater<T>());
+}
+
+template <class T, class K>
+void set_intersection_pair(const T* leftp,
+                           const K* left_valp,
+                           size_t left_size,
+                           const T* rightp,
+                           size_t right_size,
+                           std::vector<T>& out,
+                           std::vector<K>& out_val) {
+  auto max_size = std::min(left_size, right_size);
+  out.resize(max_size);
+  out_val.resize(max_size);
+  auto size = set_intersection_pair_branchless(leftp, left_valp, left_size,
+                                               rightp, right_size,
+                                               out.data(), out_val.data(),
+                                               std::less<T>());
+  out.resize(size);
+  out_val.resize(size);
+}
+
+template <class T>
+void set_intersection_index(const T* leftp, size_t left_size,
+                            const T* rightp, size_t right_size,
+                            std::vector<size_t>& left_pos,
+                            std::vector<size_t>& right_pos) {
+  auto max_size = std::min(left_size, right_size);
+  left_pos.resize(max_size);
+  right_pos.resize(max_size);
+  auto size = set_intersection_index_branchless(leftp, left_size,
+                                                rightp, right_size,
+                                                left_pos.data(),
+                                                right_pos.data(),
+                                                std::less<T>());
+  left_pos.resize(size);
+  right_pos.resize(size);
+}
+
+template <class T, class K>
+void set_union_pair(const T* leftp,
+                    const K* left_valp,
+                    size_t left_size,
+                    const T* rightp,
+                    const K* right_valp,
+                    size_t right_size,
+                    std::vector<T>& out,
+                    std::vector<K>& out_val) {
+  out.resize(left_size + right_size);
+  out_val.resize(left_size + right_size);
+  auto size = set_union_pair_branchless(leftp, left_valp, left_size,
+                                        rightp, right_valp, right_size,
+                                        out.data(), out_val.data(),
+                                        std::less<T>());
+  out.resize(size);
+  out_val.resize(size);
+}
+
+template <class T, class K>
+void set_difference_pair(const T* leftp,
+                         const K* left_valp,
+                         size_t left_size,
+                         const T* rightp,
+                         size_t right_size,
+                         std::vector<T>& out,
+                         std::vector<K>& out_val) {
+  out.resize(left_size);
+  out_val.resize(left_size);
+  auto size = set_difference_pair_branchless(leftp, left_valp, left_size,
+                                             rightp, right_size,
+                                             out.data(), out_val.data(),
+                                             std::less<T>());
+  out.resize(size);
+  out_val.resize(size);
+}
+
+template <class T, class K>
+void set_symmetric_difference_pair(const T* leftp,
+                                   const K* left_valp,
+                                   size_t left_size,
+                                   const T* rightp,
+                                   const K* right_valp,
+                                   size_t right_size,
+                                   std::vector<T>& out,
+                                   std::vector<K>& out_val) {
+  out.resize(left_size + right_size);
+  out_val.resize(left_size + right_size);
+  auto size =
+    set_symmetric_difference_pair_branchless(leftp, left_valp, left_size,
+                                             rightp, right_valp, right_size,
+                                             out.data(), out_val.data(),
+                                             std::less<T>());
+  out.resize(size);
+  out_val.resize(size);
 }
 
 template <class T>
 std::vector<size_t> set_separate(const T* keyp, size_t size) {
-  std::vector<size_t> ret;
-  if(size == 0) {
-    ret.push_back(0);
-    return ret;
-  } else {
-    T current = keyp[0];
-    ret.push_back(0);
-    for(size_t i = 1; i < size; i++) {
-      if(keyp[i] != current) {
-        current = keyp[i];
-        ret.push_back(i);
-      }
-    }
-    ret.push_back(size);
-    return ret;
+  if(size == 0) {return std::vector<size_t>(1);}
+  std::vector<size_t> ret(size + 1);
+  auto retp = ret.data();
+  retp[0] = 0;
+  size_t out_idx = 1;
+  for(size_t i = 1; i < size; i++) {
+    retp[out_idx] = i;
+    out_idx += (keyp[i] != keyp[i-1]);
   }
+  retp[out_idx++] = size;
+  ret.resize(out_idx);
+  return ret;
 }
 
 template <class T>
-std::vector<T> set_unique(const T* keyp, size_t size) {
-  std::vector<T> ret;
-  if(size == 0) {
-    return ret;
-  } else {
-    T current = keyp[0];
-    ret.push_back(current);
-    for(size_t i = 1; i < size; i++) {
-      if(keyp[i] != current) {
-        current = keyp[i];
-        ret.push_back(current);
-      }
-    }
-    return ret;
+size_t run_length_encode_impl(const T* keyp, size_t size,
+                              T* out_keyp, size_t* out_offsetp) {
+  if(size == 0) return 0;
+  out_keyp[0] = keyp[0];
+  out_offsetp[0] = 0;
+  size_t out_idx = 1;
+  for(size_t i = 1; i < size; i++) {
+    out_keyp[out_idx] = keyp[i];
+    out_offsetp[out_idx] = i;
+    out_idx += (keyp[i] != keyp[i-1]);
+  }
+  return out_idx;
+}
+
+template <class T>
+void run_length_decode_impl(const T* keyp, const size_t* countp,
+                            size_t num_runs, T* outp) {
+  size_t out_idx = 0;
+  for(size_t i = 0; i < num_runs; i++) {
+    auto key = keyp[i];
+    auto count = countp[i];
+    for(size_t j = 0; j < count; j++) outp[out_idx + j] = key;
+    out_idx += count;
+  }
+}
+
+template <class T>
+size_t set_unique_impl(const T* keyp, size_t size, T* outp) {
+  if(size == 0) return 0;
+  outp[0] = keyp[0];
+  size_t out_idx = 1;
+  for(size_t i = 1; i < size; i++) {
+    outp[out_idx] = keyp[i];
+    out_idx += (keyp[i] != keyp[i-1]);
   }
+  return out_idx;
 }
 
 template <class T>
@@ -248,13 +615,16 @@ void advance_to_split_vreg(size_t* left_idx, size_t left_size, const T* left) {
   while(anyvalid) {
     anyvalid = false;
     for(int i = 0; i < SET_VLEN_EACH; i++) {
-      if(!advance_done_0[i]) loaded_0[i] = left[left_idx_0[i]];
-      if(!advance_done_1[i]) loaded_1[i] = left[left_idx_1[i]];
-      if(!advance_done_2[i]) loaded_2[i] = left[left_idx_2[i]];
+      if(!advance_done_0[i] && left_idx_0[i] < left_size)
+        loaded_0[i] = left[left_idx_0[i]];
+      if(!advance_done_1[i] && left_idx_1[i] < left_size)
+        loaded_1[i] = left[left_idx_1[i]];
+      if(!advance_done_2[i] && left_idx_2[i] < left_size)
+        loaded_2[i] = left[left_idx_2[i]];
     }
     for(int i = 0; i < SET_VLEN_EACH; i++) {
       if(!advance_done_0[i]) {
-        if(loaded_0[i] == last_0[i] && left_idx_0[i] < left_size) {
+        if(left_idx_0[i] < left_size && loaded_0[i] == last_0[i]) {
           left_idx_0[i]++;
           anyvalid = true;
         } else {
@@ -262,7 +632,7 @@ void advance_to_split_vreg(size_t* left_idx, size_t left_size, const T* left) {
         }
       }
       if(!advance_done_1[i]) {
-        if(loaded_1[i] == last_1[i] && left_idx_1[i] < left_size) {
+        if(left_idx_1[i] < left_size && loaded_1[i] == last_1[i]) {
           left_idx_1[i]++;
           anyvalid = true;
         } else {
@@ -270,7 +640,7 @@ void advance_to_split_vreg(size_t* left_idx, size_t left_size, const T* left) {
         }
       }
       if(!advance_done_2[i]) {
-        if(loaded_2[i] == last_2[i] && left_idx_2[i] < left_size) {
+        if(left_idx_2[i] < left_size && loaded_2[i] == last_2[i]) {
           left_idx_2[i]++;
           anyvalid = true;
         } else {
@@ -286,11 +656,151 @@ void advance_to_split_vreg(size_t* left_idx, size_t left_size, const T* left) {
   }
 }
 
+// lower_bound and upper_bound in the order given by the comparator;
+// to_find should also be sorted
+template <class T>
+void set_split_lower_bound(const T* sorted, size_t sorted_size,
+                           const T* to_find, size_t to_find_size,
+                           size_t* ret, std::less<T>) {
+  lower_bound_sorted(sorted, sorted_size, to_find, to_find_size, ret);
+}
+
+template <class T>
+void set_split_lower_bound(const T* sorted, size_t sorted_size,
+                           const T* to_find, size_t to_find_size,
+                           size_t* ret, std::greater<T>) {
+  lower_bound_desc(sorted, sorted_size, to_find, to_find_size, ret);
+}
+
+template <class T>
+void set_split_upper_bound(const T* sorted, size_t sorted_size,
+                           const T* to_find, size_t to_find_size,
+                           size_t* ret, std::less<T>) {
+  upper_bound_sorted(sorted, sorted_size, to_find, to_find_size, ret);
+}
+
+template <class T>
+void set_split_upper_bound(const T* sorted, size_t sorted_size,
+                           const T* to_find, size_t to_find_size,
+                           size_t* ret, std::greater<T>) {
+  upper_bound_desc(sorted, sorted_size, to_find, to_find_size, ret);
+}
+
+// Split left into SET_VLEN parts without cutting a run of the same value,
+// and split right at the lower_bound of the first value of each part.
+// comp is std::less<T> or std::greater<T>.
+template <class T, class C>
+void set_operation_split(const T* leftp, size_t left_size,
+                         const T* rightp, size_t right_size,
+                         size_t* left_idx, size_t* right_idx,
+                         size_t* left_idx_stop, size_t* right_idx_stop,
+                         C comp) {
+  size_t each = ceil_div(left_size, size_t(SET_VLEN));
+  if(each % 2 == 0) each++;
+  for(int i = 0; i < SET_VLEN; i++) {
+    size_t pos = each * i;
+    if(pos < left_size) {
+      left_idx[i] = pos;
+    } else {
+      left_idx[i] = left_size;
+    }
+  }
+
+  advance_to_split_vreg(left_idx, left_size, leftp);
+
+  T left_start[SET_VLEN]; // the last value is used to keep it sorted
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    if(left_idx[i] < left_size) left_start[i] = leftp[left_idx[i]];
+    else left_start[i] = leftp[left_size-1];
+  }
+  set_split_lower_bound(rightp, right_size, left_start, SET_VLEN, right_idx,
+                        comp);
+  right_idx[0] = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    if(left_idx[i] == left_size) right_idx[i] = right_size; // left is not valid
+  }
+  for(int i = 0; i < SET_VLEN - 1; i++) {
+    left_idx_stop[i] = left_idx[i + 1];
+    right_idx_stop[i] = right_idx[i + 1];
+  }
+  left_idx_stop[SET_VLEN-1] = left_size;
+  right_idx_stop[SET_VLEN-1] = right_size;
+}
+
+template <class T>
+void set_operation_split(const T* leftp, size_t left_size,
+                         const T* rightp, size_t right_size,
+                         size_t* left_idx, size_t* right_idx,
+                         size_t* left_idx_stop, size_t* right_idx_stop) {
+  set_operation_split(leftp, left_size, rightp, right_size,
+                      left_idx, right_idx, left_idx_stop, right_idx_stop,
+                      std::less<T>());
+}
+
+// Same as set_operation_split, but each part of right ends at the
+// upper_bound of the last value of the part of left; the rest of right
+// cannot match anything, which is enough for intersection.
+template <class T, class C>
+void set_intersection_split(const T* leftp, size_t left_size,
+                            const T* rightp, size_t right_size,
+                            size_t* left_idx, size_t* right_idx,
+                            size_t* left_idx_stop, size_t* right_idx_stop,
+                            C comp) {
+  size_t each = ceil_div(left_size, size_t(SET_VLEN));
+  if(each % 2 == 0) each++;
+  for(int i = 0; i < SET_VLEN; i++) {
+    size_t pos = each * i;
+    if(pos < left_size) {
+      left_idx[i] = pos;
+    } else {
+      left_idx[i] = left_size;
+    }
+  }
+
+  advance_to_split_vreg(left_idx, left_size, leftp);
+
+  T left_start[SET_VLEN]; // the last value is used to keep it sorted
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    if(left_idx[i] < left_size) left_start[i] = leftp[left_idx[i]];
+    else left_start[i] = leftp[left_size-1];
+  }
+  set_split_lower_bound(rightp, right_size, left_start, SET_VLEN, right_idx,
+                        comp);
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    if(left_idx[i] == left_size) right_idx[i] = right_size; // left is not valid
+  }
+  for(size_t i = 0; i < SET_VLEN-1; i++) {
+    if(left_idx[i] < left_size) left_start[i] = leftp[left_idx[i+1]-1];
+    else left_start[i] = leftp[left_size-1];
+  }
+  left_start[SET_VLEN-1] = leftp[left_size-1];
+  set_split_upper_bound(rightp, right_size, left_start, SET_VLEN,
+                        right_idx_stop, comp);
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    if(left_idx[i] == left_size || right_idx[i] == right_size)
+      right_idx_stop[i] = right_size;
+  }
+  for(int i = 0; i < SET_VLEN - 1; i++) {
+    left_idx_stop[i] = left_idx[i + 1];
+  }
+  left_idx_stop[SET_VLEN-1] = left_size;
+}
+
 template <class T>
+void set_intersection_split(const T* leftp, size_t left_size,
+                            const T* rightp, size_t right_size,
+                            size_t* left_idx, size_t* right_idx,
+                            size_t* left_idx_stop, size_t* right_idx_stop) {
+  set_intersection_split(leftp, left_size, rightp, right_size,
+                         left_idx, right_idx, left_idx_stop, right_idx_stop,
+                         std::less<T>());
+}
+
+template <class T, class C>
 void set_intersection_vreg(const T* lp, const T* rp, T* op, 
                            size_t* left_idx, size_t* right_idx,
                            size_t* left_idx_stop, size_t* right_idx_stop,
-                           size_t* out_idx) {
+                           size_t* out_idx, C comp) {
 #include "set_operations.incl1" // decl/init vregs
   int anyvalid = true;
   while(anyvalid) {
@@ -302,10 +812,10 @@ void set_intersection_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_0[j] != left_idx_stop_0[j] &&
          right_idx_0[j] != right_idx_stop_0[j]) {
         anyvalid = true;
-        if(leftelm0[j] < rightelm0[j]) {
+        if(comp(leftelm0[j], rightelm0[j])) {
           left_idx_0[j]++;
         } else {
-          if(!(rightelm0[j] < leftelm0[j])) {
+          if(!comp(rightelm0[j], leftelm0[j])) {
             op[out_idx_0[j]++] = leftelm0[j];
             left_idx_0[j]++;
           }
@@ -319,10 +829,10 @@ void set_intersection_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_1[j] != left_idx_stop_1[j] &&
          right_idx_1[j] != right_idx_stop_1[j]) {
         anyvalid = true;
-        if(leftelm1[j] < rightelm1[j]) {
+        if(comp(leftelm1[j], rightelm1[j])) {
           left_idx_1[j]++;
         } else {
-          if(!(rightelm1[j] < leftelm1[j])) {
+          if(!comp(rightelm1[j], leftelm1[j])) {
             op[out_idx_1[j]++] = leftelm1[j];
             left_idx_1[j]++;
           }
@@ -336,10 +846,10 @@ void set_intersection_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_2[j] != left_idx_stop_2[j] &&
          right_idx_2[j] != right_idx_stop_2[j]) {
         anyvalid = true;
-        if(leftelm2[j] < rightelm2[j]) {
+        if(comp(leftelm2[j], rightelm2[j])) {
           left_idx_2[j]++;
         } else {
-          if(!(rightelm2[j] < leftelm2[j])) {
+          if(!comp(rightelm2[j], leftelm2[j])) {
             op[out_idx_2[j]++] = leftelm2[j];
             left_idx_2[j]++;
           }
@@ -355,89 +865,71 @@ void set_intersection_vreg(const T* lp, const T* rp, T* op,
   }
 }
 
-template <class T>
-std::vector<T> set_intersection(const T* leftp, size_t left_size,
-                                const T* rightp, size_t right_size) {
-  if(left_size == 0 || right_size == 0) return std::vector<T>();
+// outp should have left_size capacity; parts are written at their
+// position in left and compacted in place
+template <class T, class C>
+size_t set_intersection_impl(const T* leftp, size_t left_size,
+                             const T* rightp, size_t right_size,
+                             T* outp, C comp) {
+  if(left_size == 0 || right_size == 0) return 0;
 
-  size_t each = ceil_div(left_size, size_t(SET_VLEN));
-  if(each % 2 == 0) each++;
-  
   size_t left_idx[SET_VLEN];
   size_t right_idx[SET_VLEN];
   size_t left_idx_stop[SET_VLEN];
   size_t right_idx_stop[SET_VLEN];
   size_t out_idx[SET_VLEN];
   size_t out_idx_save[SET_VLEN];
-  std::vector<T> out(left_size);
-  auto outp = out.data();
 
+  set_intersection_split(leftp, left_size, rightp, right_size,
+                         left_idx, right_idx, left_idx_stop, right_idx_stop,
+                         comp);
+  // each part writes at most left_idx_stop - left_idx data
   for(int i = 0; i < SET_VLEN; i++) {
-    size_t pos = each * i;
-    if(pos < left_size) {
-      left_idx[i] = pos;
-      out_idx[i] = pos;
-      out_idx_save[i] = pos;
-    } else {
-      left_idx[i] = left_size;
-      out_idx[i] = left_size;
-      out_idx_save[i] = left_size;
-    }
+    out_idx[i] = left_idx[i];
+    out_idx_save[i] = left_idx[i];
   }
+  
+  set_intersection_vreg(leftp, rightp, outp, left_idx, right_idx,
+                        left_idx_stop, right_idx_stop,
+                        out_idx, comp);
 
-  advance_to_split_vreg(left_idx, left_size, leftp);
-
-  T left_start[SET_VLEN];
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    if(left_idx[i] < left_size) left_start[i] = leftp[left_idx[i]];
-    else left_start[i] = 0;
-  }
-  lower_bound(rightp, right_size, left_start, SET_VLEN, right_idx);
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    if(left_idx[i] == left_size) right_idx[i] = right_size; // left is not valid
-  }
-  for(size_t i = 0; i < SET_VLEN-1; i++) {
-    if(left_idx[i] < left_size) left_start[i] = leftp[left_idx[i+1]-1];
-    else left_start[i] = 0;
-  }
-  left_start[SET_VLEN-1] = leftp[left_size-1];
-  upper_bound(rightp, right_size, left_start, SET_VLEN, right_idx_stop);
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    if(left_idx[i] == left_size || right_idx[i] == right_size)
-      right_idx_stop[i] = right_size;
-  }
-  for(int i = 0; i < SET_VLEN - 1; i++) {
-    left_idx_stop[i] = left_idx[i + 1];
-  }
-  left_idx_stop[SET_VLEN-1] = left_size;
-  
-  set_intersection_vreg(leftp, rightp, outp, left_idx, right_idx,
-                        left_idx_stop, right_idx_stop,
-                        out_idx);
-
-  size_t total = 0;
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    total += out_idx[i] - out_idx_save[i];
-  }
-  std::vector<T> ret(total);
-  T* retp = &ret[0];
-  size_t current = 0;
+  // moving forward is safe since current <= out_idx_save[i]
+  size_t current = 0;
   for(size_t i = 0; i < SET_VLEN; i++) {
+    auto crnt_size = out_idx[i] - out_idx_save[i];
+    if(current != out_idx_save[i]) {
 #pragma cdir nodep
 #pragma _NEC ivdep
-    for(size_t j = 0; j < out_idx[i] - out_idx_save[i]; j++) {
-      retp[current + j] = outp[out_idx_save[i] + j];
+      for(size_t j = 0; j < crnt_size; j++) {
+        outp[current + j] = outp[out_idx_save[i] + j];
+      }
     }
-    current += out_idx[i] - out_idx_save[i];
+    current += crnt_size;
   }
-  return ret;
+  return current;
+}
+
+template <class T>
+size_t set_intersection_impl(const T* leftp, size_t left_size,
+                             const T* rightp, size_t right_size,
+                             T* outp) {
+  return set_intersection_impl(leftp, left_size, rightp, right_size, outp,
+                               std::less<T>());
 }
 
 template <class T>
+size_t set_intersection_desc_impl(const T* leftp, size_t left_size,
+                                  const T* rightp, size_t right_size,
+                                  T* outp) {
+  return set_intersection_impl(leftp, left_size, rightp, right_size, outp,
+                               std::greater<T>());
+}
+
+template <class T, class C>
 void set_union_vreg(const T* lp, const T* rp, T* op,
                     size_t* left_idx, size_t* right_idx,
                     size_t* left_idx_stop, size_t* right_idx_stop,
-                    size_t* out_idx) {
+                    size_t* out_idx, C comp) {
 #include "set_operations.incl1"
   int anyvalid = true;
   while(anyvalid) {
@@ -449,12 +941,12 @@ void set_union_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_0[j] != left_idx_stop_0[j] &&
          right_idx_0[j] != right_idx_stop_0[j]) {
         anyvalid = true;
-        if(rightelm0[j] < leftelm0[j]) {
+        if(comp(rightelm0[j], leftelm0[j])) {
           op[out_idx_0[j]] = rightelm0[j];
           right_idx_0[j]++;
         } else {
           op[out_idx_0[j]] = leftelm0[j];
-          if(!(leftelm0[j] < rightelm0[j])) {
+          if(!comp(leftelm0[j], rightelm0[j])) {
             right_idx_0[j]++;
           }
           left_idx_0[j]++;
@@ -468,12 +960,12 @@ void set_union_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_1[j] != left_idx_stop_1[j] &&
          right_idx_1[j] != right_idx_stop_1[j]) {
         anyvalid = true;
-        if(rightelm1[j] < leftelm1[j]) {
+        if(comp(rightelm1[j], leftelm1[j])) {
           op[out_idx_1[j]] = rightelm1[j];
           right_idx_1[j]++;
         } else {
           op[out_idx_1[j]] = leftelm1[j];
-          if(!(leftelm1[j] < rightelm1[j])) {
+          if(!comp(leftelm1[j], rightelm1[j])) {
             right_idx_1[j]++;
           }
           left_idx_1[j]++;
@@ -487,12 +979,12 @@ void set_union_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_2[j] != left_idx_stop_2[j] &&
          right_idx_2[j] != right_idx_stop_2[j]) {
         anyvalid = true;
-        if(rightelm2[j] < leftelm2[j]) {
+        if(comp(rightelm2[j], leftelm2[j])) {
           op[out_idx_2[j]] = rightelm2[j];
           right_idx_2[j]++;
         } else {
           op[out_idx_2[j]] = leftelm2[j];
-          if(!(leftelm2[j] < rightelm2[j])) {
+          if(!comp(leftelm2[j], rightelm2[j])) {
             right_idx_2[j]++;
           }
           left_idx_2[j]++;
@@ -514,54 +1006,30 @@ void set_union_vreg(const T* lp, const T* rp, T* op,
   }
 }
 
-template <class T>
-std::vector<T> set_union(const T* leftp, size_t left_size,
-                         const T* rightp, size_t right_size) {
+// outp should have left_size + right_size capacity
+template <class T, class C>
+size_t set_union_impl(const T* leftp, size_t left_size,
+                      const T* rightp, size_t right_size,
+                      T* outp, C comp) {
   if(left_size == 0) {
-    std::vector<T> ret(right_size);
-    auto retp = ret.data();
-    for(size_t i = 0; i < right_size; i++) retp[i] = rightp[i];
-    return ret;
+    for(size_t i = 0; i < right_size; i++) outp[i] = rightp[i];
+    return right_size;
   }
   if(right_size == 0) {
-    std::vector<T> ret(left_size);
-    auto retp = ret.data();
-    for(size_t i = 0; i < left_size; i++) retp[i] = leftp[i];
-    return ret;
+    for(size_t i = 0; i < left_size; i++) outp[i] = leftp[i];
+    return left_size;
   }
 
-  size_t each = ceil_div(left_size, size_t(SET_VLEN));
-  if(each % 2 == 0) each++;
-  
   size_t left_idx[SET_VLEN];
   size_t right_idx[SET_VLEN];
   size_t left_idx_stop[SET_VLEN];
   size_t right_idx_stop[SET_VLEN];
   size_t out_idx[SET_VLEN];
   size_t out_idx_save[SET_VLEN];
-  std::vector<T> out(left_size + right_size);
-  auto outp = out.data();
-  for(int i = 0; i < SET_VLEN; i++) {
-    size_t pos = each * i;
-    if(pos < left_size) {
-      left_idx[i] = pos;
-    } else {
-      left_idx[i] = left_size;
-    }
-  }
-
-  advance_to_split_vreg(left_idx, left_size, leftp);
 
-  T left_start[SET_VLEN];
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    if(left_idx[i] < left_size) left_start[i] = leftp[left_idx[i]];
-    else left_start[i] = 0;
-  }
-  lower_bound(rightp, right_size, left_start, SET_VLEN, right_idx);
-  right_idx[0] = 0;
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    if(left_idx[i] == left_size) right_idx[i] = right_size; // left is not valid
-  }
+  set_operation_split(leftp, left_size, rightp, right_size,
+                      left_idx, right_idx, left_idx_stop, right_idx_stop,
+                      comp);
   out_idx[0] = 0;
   out_idx_save[0] = 0;
   for(int i = 1; i < SET_VLEN; i++) {
@@ -570,48 +1038,57 @@ std::vector<T> set_union(const T* leftp, size_t left_size,
       + out_idx[i-1];
     out_idx_save[i] = out_idx[i];
   }
-  for(int i = 0; i < SET_VLEN - 1; i++) {
-    left_idx_stop[i] = left_idx[i + 1];
-    right_idx_stop[i] = right_idx[i + 1];
-  }
-  left_idx_stop[SET_VLEN-1] = left_size;
-  right_idx_stop[SET_VLEN-1] = right_size;
   set_union_vreg(leftp, rightp, outp, 
                  left_idx, right_idx,
                  left_idx_stop, right_idx_stop,
-                 out_idx);
+                 out_idx, comp);
 
-  size_t total = 0;
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    total += (out_idx[i] - out_idx_save[i]) +
-      (left_idx_stop[i] - left_idx[i]) +
-      (right_idx_stop[i] - right_idx[i]);
-  }
-  std::vector<T> ret(total);
-  T* retp = &ret[0];
+  // each part ends before the start of the next part,
+  // so it can be compacted in place
   size_t current = 0;
   for(size_t i = 0; i < SET_VLEN; i++) {
-    for(size_t j = 0; j < out_idx[i] - out_idx_save[i]; j++) {
-      retp[current + j] = outp[out_idx_save[i] + j];
+    auto crnt_size = out_idx[i] - out_idx_save[i];
+    if(current != out_idx_save[i]) {
+#pragma cdir nodep
+#pragma _NEC ivdep
+      for(size_t j = 0; j < crnt_size; j++) {
+        outp[current + j] = outp[out_idx_save[i] + j];
+      }
     }
-    current += out_idx[i] - out_idx_save[i];
+    current += crnt_size;
     for(size_t j = 0; j < left_idx_stop[i] - left_idx[i]; j++) {
-      retp[current + j] = leftp[left_idx[i] + j];
+      outp[current + j] = leftp[left_idx[i] + j];
     }
     current += left_idx_stop[i] - left_idx[i];
     for(size_t j = 0; j < right_idx_stop[i] - right_idx[i]; j++) {
-      retp[current + j] = rightp[right_idx[i] + j];
+      outp[current + j] = rightp[right_idx[i] + j];
     }
     current += right_idx_stop[i] - right_idx[i];
   }
-  return ret;
+  return current;
+}
+
+template <class T>
+size_t set_union_impl(const T* leftp, size_t left_size,
+                      const T* rightp, size_t right_size,
+                      T* outp) {
+  return set_union_impl(leftp, left_size, rightp, right_size, outp,
+                        std::less<T>());
 }
 
 template <class T>
+size_t set_union_desc_impl(const T* leftp, size_t left_size,
+                           const T* rightp, size_t right_size,
+                           T* outp) {
+  return set_union_impl(leftp, left_size, rightp, right_size, outp,
+                        std::greater<T>());
+}
+
+template <class T, class C>
 void set_difference_vreg(const T* lp, const T* rp, T* op,
                          size_t* left_idx, size_t* right_idx,
                          size_t* left_idx_stop, size_t* right_idx_stop,
-                         size_t* out_idx) {
+                         size_t* out_idx, C comp) {
 #include "set_operations.incl1"
   int anyvalid = true;
   while(anyvalid) {
@@ -623,11 +1100,11 @@ void set_difference_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_0[j] != left_idx_stop_0[j] &&
          right_idx_0[j] != right_idx_stop_0[j]) {
         anyvalid = true;
-        if(leftelm0[j] < rightelm0[j]) {
+        if(comp(leftelm0[j], rightelm0[j])) {
           op[out_idx_0[j]++] = leftelm0[j];
           left_idx_0[j]++;
         } else {
-          if(!(rightelm0[j] < leftelm0[j])) {
+          if(!comp(rightelm0[j], leftelm0[j])) {
             left_idx_0[j]++;
           }
           right_idx_0[j]++;
@@ -640,11 +1117,11 @@ void set_difference_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_1[j] != left_idx_stop_1[j] &&
          right_idx_1[j] != right_idx_stop_1[j]) {
         anyvalid = true;
-        if(leftelm1[j] < rightelm1[j]) {
+        if(comp(leftelm1[j], rightelm1[j])) {
           op[out_idx_1[j]++] = leftelm1[j];
           left_idx_1[j]++;
         } else {
-          if(!(rightelm1[j] < leftelm1[j])) {
+          if(!comp(rightelm1[j], leftelm1[j])) {
             left_idx_1[j]++;
           }
           right_idx_1[j]++;
@@ -657,11 +1134,11 @@ void set_difference_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_2[j] != left_idx_stop_2[j] &&
          right_idx_2[j] != right_idx_stop_2[j]) {
         anyvalid = true;
-        if(leftelm2[j] < rightelm2[j]) {
+        if(comp(leftelm2[j], rightelm2[j])) {
           op[out_idx_2[j]++] = leftelm2[j];
           left_idx_2[j]++;
         } else {
-          if(!(rightelm2[j] < leftelm2[j])) {
+          if(!comp(rightelm2[j], leftelm2[j])) {
             left_idx_2[j]++;
           }
           right_idx_2[j]++;
@@ -679,89 +1156,78 @@ void set_difference_vreg(const T* lp, const T* rp, T* op,
   }
 }
 
-template <class T>
-std::vector<T> set_difference(const T* leftp, size_t left_size,
-                              const T* rightp, size_t right_size) {
-  if(left_size == 0) return std::vector<T>();
+// outp should have left_size capacity
+template <class T, class C>
+size_t set_difference_impl(const T* leftp, size_t left_size,
+                           const T* rightp, size_t right_size,
+                           T* outp, C comp) {
+  if(left_size == 0) return 0;
   if(right_size == 0) {
-    std::vector<T> ret(left_size);
-    auto retp = ret.data();
-    for(size_t i = 0; i < left_size; i++) retp[i] = leftp[i];
-    return ret;
+    for(size_t i = 0; i < left_size; i++) outp[i] = leftp[i];
+    return left_size;
   }
 
-  size_t each = ceil_div(left_size, size_t(SET_VLEN));
-  if(each % 2 == 0) each++;
-  
   size_t left_idx[SET_VLEN];
   size_t right_idx[SET_VLEN];
   size_t left_idx_stop[SET_VLEN];
   size_t right_idx_stop[SET_VLEN];
   size_t out_idx[SET_VLEN];
   size_t out_idx_save[SET_VLEN];
-  std::vector<T> out(left_size);
-  auto outp = out.data();
-  for(int i = 0; i < SET_VLEN; i++) {
-    size_t pos = each * i;
-    if(pos < left_size) {
-      left_idx[i] = pos;
-    } else {
-      left_idx[i] = left_size;
-    }
-  }
-
-  advance_to_split_vreg(left_idx, left_size, leftp);
 
+  set_operation_split(leftp, left_size, rightp, right_size,
+                      left_idx, right_idx, left_idx_stop, right_idx_stop,
+                      comp);
   for(int i = 0; i < SET_VLEN; i++) {
     out_idx[i] = left_idx[i];
     out_idx_save[i] = left_idx[i];
   }
-  T left_start[SET_VLEN];
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    if(left_idx[i] < left_size) left_start[i] = leftp[left_idx[i]];
-    else left_start[i] = 0;
-  }
-  lower_bound(rightp, right_size, left_start, SET_VLEN, right_idx);
-  right_idx[0] = 0;
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    if(left_idx[i] == left_size) right_idx[i] = right_size; // left is not valid
-  }
-  for(int i = 0; i < SET_VLEN - 1; i++) {
-    left_idx_stop[i] = left_idx[i + 1];
-    right_idx_stop[i] = right_idx[i + 1];
-  }
-  left_idx_stop[SET_VLEN-1] = left_size;
-  right_idx_stop[SET_VLEN-1] = right_size;
   set_difference_vreg(leftp, rightp, outp,
                       left_idx, right_idx,
                       left_idx_stop, right_idx_stop,
-                      out_idx);
-  size_t total = 0;
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    total += (out_idx[i] - out_idx_save[i]) +
-      (left_idx_stop[i] - left_idx[i]);
-  }
-  std::vector<T> ret(total);
-  T* retp = &ret[0];
+                      out_idx, comp);
+  // each part ends before the start of the next part,
+  // so it can be compacted in place
   size_t current = 0;
   for(size_t i = 0; i < SET_VLEN; i++) {
-    for(size_t j = 0; j < out_idx[i] - out_idx_save[i]; j++) {
-      retp[current + j] = outp[out_idx_save[i] + j];
+    auto crnt_size = out_idx[i] - out_idx_save[i];
+    if(current != out_idx_save[i]) {
+#pragma cdir nodep
+#pragma _NEC ivdep
+      for(size_t j = 0; j < crnt_size; j++) {
+        outp[current + j] = outp[out_idx_save[i] + j];
+      }
     }
-    current += out_idx[i] - out_idx_save[i];
+    current += crnt_size;
     for(size_t j = 0; j < left_idx_stop[i] - left_idx[i]; j++) {
-      retp[current + j] = leftp[left_idx[i] + j];
+      outp[current + j] = leftp[left_idx[i] + j];
     }
     current += left_idx_stop[i] - left_idx[i];
   }
-  return ret;
+  return current;
 }
 
 template <class T>
-void set_merge_vreg(const T* lp, const T* rp, T* op, 
-                    size_t* left_idx, size_t* right_idx,
-                    size_t* left_idx_stop, size_t* right_idx_stop,
-                    size_t* out_idx) {
+size_t set_difference_impl(const T* leftp, size_t left_size,
+                           const T* rightp, size_t right_size,
+                           T* outp) {
+  return set_difference_impl(leftp, left_size, rightp, right_size, outp,
+                             std::less<T>());
+}
+
+template <class T>
+size_t set_difference_desc_impl(const T* leftp, size_t left_size,
+                                const T* rightp, size_t right_size,
+                                T* outp) {
+  return set_difference_impl(leftp, left_size, rightp, right_size, outp,
+                             std::greater<T>());
+}
+
+template <class T>
+void set_symmetric_difference_vreg(const T* lp, const T* rp, T* op,
+                                   size_t* left_idx, size_t* right_idx,
+                                   size_t* left_idx_stop,
+                                   size_t* right_idx_stop,
+                                   size_t* out_idx) {
 #include "set_operations.incl1"
   int anyvalid = true;
   while(anyvalid) {
@@ -773,14 +1239,16 @@ void set_merge_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_0[j] != left_idx_stop_0[j] &&
          right_idx_0[j] != right_idx_stop_0[j]) {
         anyvalid = true;
-        if(rightelm0[j] < leftelm0[j]) {
-          op[out_idx_0[j]] = rightelm0[j];
+        if(leftelm0[j] < rightelm0[j]) {
+          op[out_idx_0[j]++] = leftelm0[j];
+          left_idx_0[j]++;
+        } else if(rightelm0[j] < leftelm0[j]) {
+          op[out_idx_0[j]++] = rightelm0[j];
           right_idx_0[j]++;
         } else {
-          op[out_idx_0[j]] = leftelm0[j];
           left_idx_0[j]++;
+          right_idx_0[j]++;
         }
-        out_idx_0[j]++;
       }
     }
 #pragma cdir nodep
@@ -789,14 +1257,16 @@ void set_merge_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_1[j] != left_idx_stop_1[j] &&
          right_idx_1[j] != right_idx_stop_1[j]) {
         anyvalid = true;
-        if(rightelm1[j] < leftelm1[j]) {
-          op[out_idx_1[j]] = rightelm1[j];
+        if(leftelm1[j] < rightelm1[j]) {
+          op[out_idx_1[j]++] = leftelm1[j];
+          left_idx_1[j]++;
+        } else if(rightelm1[j] < leftelm1[j]) {
+          op[out_idx_1[j]++] = rightelm1[j];
           right_idx_1[j]++;
         } else {
-          op[out_idx_1[j]] = leftelm1[j];
           left_idx_1[j]++;
+          right_idx_1[j]++;
         }
-        out_idx_1[j]++;
       }
     }
 #pragma cdir nodep
@@ -805,14 +1275,16 @@ void set_merge_vreg(const T* lp, const T* rp, T* op,
       if(left_idx_2[j] != left_idx_stop_2[j] &&
          right_idx_2[j] != right_idx_stop_2[j]) {
         anyvalid = true;
-        if(rightelm2[j] < leftelm2[j]) {
-          op[out_idx_2[j]] = rightelm2[j];
+        if(leftelm2[j] < rightelm2[j]) {
+          op[out_idx_2[j]++] = leftelm2[j];
+          left_idx_2[j]++;
+        } else if(rightelm2[j] < leftelm2[j]) {
+          op[out_idx_2[j]++] = rightelm2[j];
           right_idx_2[j]++;
         } else {
-          op[out_idx_2[j]] = leftelm2[j];
           left_idx_2[j]++;
+          right_idx_2[j]++;
         }
-        out_idx_2[j]++;
       }
     }
   }
@@ -829,84 +1301,275 @@ void set_merge_vreg(const T* lp, const T* rp, T* op,
   }
 }
 
+// outp should have left_size + right_size capacity
 template <class T>
-std::vector<T> set_merge(const T* leftp, size_t left_size,
-                         const T* rightp, size_t right_size) {
-  if(left_size == 0) {
-    std::vector<T> ret(right_size);
-    auto retp = ret.data();
-    for(size_t i = 0; i < right_size; i++) retp[i] = rightp[i];
-    return ret;
-  }
-  if(right_size == 0) {
-    std::vector<T> ret(left_size);
-    auto retp = ret.data();
-    for(size_t i = 0; i < left_size; i++) retp[i] = leftp[i];
-    return ret;
+size_t set_symmetric_difference_impl(const T* leftp, size_t left_size,
+                                     const T* rightp, size_t right_size,
+                                     T* outp) {
+  if(left_size == 0 || right_size == 0) {
+    auto srcp = left_size == 0 ? rightp : leftp;
+    auto size = left_size + right_size;
+    for(size_t i = 0; i < size; i++) outp[i] = srcp[i];
+    return size;
   }
 
-  size_t each = ceil_div(left_size, size_t(SET_VLEN));
-  if(each % 2 == 0) each++;
-  
   size_t left_idx[SET_VLEN];
   size_t right_idx[SET_VLEN];
   size_t left_idx_stop[SET_VLEN];
   size_t right_idx_stop[SET_VLEN];
   size_t out_idx[SET_VLEN];
-  std::vector<T> out(left_size + right_size);
-  auto outp = out.data();
-  for(int i = 0; i < SET_VLEN; i++) {
-    size_t pos = each * i;
-    if(pos < left_size) {
-      left_idx[i] = pos;
-    } else {
-      left_idx[i] = left_size;
-    }
-  }
-
-  advance_to_split_vreg(left_idx, left_size, leftp);
+  size_t out_idx_save[SET_VLEN];
 
-  T left_start[SET_VLEN];
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    if(left_idx[i] < left_size) left_start[i] = leftp[left_idx[i]];
-    else left_start[i] = 0;
-  }
-  lower_bound(rightp, right_size, left_start, SET_VLEN, right_idx);
-  right_idx[0] = 0;
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    if(left_idx[i] == left_size) right_idx[i] = right_size; // left is not valid
-  }
+  set_operation_split(leftp, left_size, rightp, right_size,
+                      left_idx, right_idx, left_idx_stop, right_idx_stop);
   out_idx[0] = 0;
+  out_idx_save[0] = 0;
   for(int i = 1; i < SET_VLEN; i++) {
-    out_idx[i] = (left_idx[i] - left_idx[i-1]) +
-      (right_idx[i] - right_idx[i-1])
+    out_idx[i] = (left_idx[i] - left_idx[i-1])
+      + (right_idx[i] - right_idx[i-1])
       + out_idx[i-1];
+    out_idx_save[i] = out_idx[i];
   }
-  for(int i = 0; i < SET_VLEN - 1; i++) {
-    left_idx_stop[i] = left_idx[i + 1];
-    right_idx_stop[i] = right_idx[i + 1];
-  }
-  left_idx_stop[SET_VLEN-1] = left_size;
-  right_idx_stop[SET_VLEN-1] = right_size;
-  set_merge_vreg(leftp, rightp, outp, 
-                 left_idx, right_idx,
-                 left_idx_stop, right_idx_stop,
-                 out_idx);
+  set_symmetric_difference_vreg(leftp, rightp, outp,
+                                left_idx, right_idx,
+                                left_idx_stop, right_idx_stop,
+                                out_idx);
 
+  // each part ends before the start of the next part,
+  // so it can be compacted in place
+  size_t current = 0;
   for(size_t i = 0; i < SET_VLEN; i++) {
+    auto crnt_size = out_idx[i] - out_idx_save[i];
+    if(current != out_idx_save[i]) {
+#pragma cdir nodep
+#pragma _NEC ivdep
+      for(size_t j = 0; j < crnt_size; j++) {
+        outp[current + j] = outp[out_idx_save[i] + j];
+      }
+    }
+    current += crnt_size;
     for(size_t j = 0; j < left_idx_stop[i] - left_idx[i]; j++) {
-      outp[out_idx[i] + j] = leftp[left_idx[i] + j];
+      outp[current + j] = leftp[left_idx[i] + j];
     }
+    current += left_idx_stop[i] - left_idx[i];
     for(size_t j = 0; j < right_idx_stop[i] - right_idx[i]; j++) {
-      outp[out_idx[i] + j] = rightp[right_idx[i] + j];
+      outp[current + j] = rightp[right_idx[i] + j];
     }
+    current += right_idx_stop[i] - right_idx[i];
   }
-  return out;
+  return current;
 }
 
+// same as set_intersection_vreg, but only counts the matches
 template <class T>
-void set_merge_desc_vreg(const T* lp, const T* rp, T* op, 
-                         size_t* left_idx, size_t* right_idx,
+void set_count_intersection_vreg(const T* lp, const T* rp,
+                                 size_t* left_idx, size_t* right_idx,
+                                 size_t* left_idx_stop,
+                                 size_t* right_idx_stop,
+                                 size_t* out_idx) {
+#include "set_operations.incl1"
+  int anyvalid = true;
+  while(anyvalid) {
+    anyvalid = false;
+#include "set_operations.incl2"
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_0[j] != left_idx_stop_0[j] &&
+         right_idx_0[j] != right_idx_stop_0[j]) {
+        anyvalid = true;
+        if(leftelm0[j] < rightelm0[j]) {
+          left_idx_0[j]++;
+        } else {
+          if(!(rightelm0[j] < leftelm0[j])) {
+            out_idx_0[j]++;
+            left_idx_0[j]++;
+          }
+          right_idx_0[j]++;
+        }
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_1[j] != left_idx_stop_1[j] &&
+         right_idx_1[j] != right_idx_stop_1[j]) {
+        anyvalid = true;
+        if(leftelm1[j] < rightelm1[j]) {
+          left_idx_1[j]++;
+        } else {
+          if(!(rightelm1[j] < leftelm1[j])) {
+            out_idx_1[j]++;
+            left_idx_1[j]++;
+          }
+          right_idx_1[j]++;
+        }
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_2[j] != left_idx_stop_2[j] &&
+         right_idx_2[j] != right_idx_stop_2[j]) {
+        anyvalid = true;
+        if(leftelm2[j] < rightelm2[j]) {
+          left_idx_2[j]++;
+        } else {
+          if(!(rightelm2[j] < leftelm2[j])) {
+            out_idx_2[j]++;
+            left_idx_2[j]++;
+          }
+          right_idx_2[j]++;
+        }
+      }
+    }
+  }
+  for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+    out_idx[i] = out_idx_0[i];
+    out_idx[SET_VLEN_EACH * 1 + i] = out_idx_1[i];
+    out_idx[SET_VLEN_EACH * 2 + i] = out_idx_2[i];
+  }
+}
+
+template <class T>
+size_t set_count_intersection(const T* leftp, size_t left_size,
+                              const T* rightp, size_t right_size) {
+  if(left_size == 0 || right_size == 0) return 0;
+
+  size_t left_idx[SET_VLEN];
+  size_t right_idx[SET_VLEN];
+  size_t left_idx_stop[SET_VLEN];
+  size_t right_idx_stop[SET_VLEN];
+  size_t out_idx[SET_VLEN];
+
+  set_intersection_split(leftp, left_size, rightp, right_size,
+                         left_idx, right_idx, left_idx_stop, right_idx_stop);
+  for(int i = 0; i < SET_VLEN; i++) out_idx[i] = 0;
+  set_count_intersection_vreg(leftp, rightp, left_idx, right_idx,
+                              left_idx_stop, right_idx_stop, out_idx);
+  size_t count = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) count += out_idx[i];
+  return count;
+}
+
+template <class T>
+void set_merge_vreg(const T* lp, const T* rp, T* op, 
+                    size_t* left_idx, size_t* right_idx,
+                    size_t* left_idx_stop, size_t* right_idx_stop,
+                    size_t* out_idx) {
+#include "set_operations.incl1"
+  int anyvalid = true;
+  while(anyvalid) {
+    anyvalid = false;
+#include "set_operations.incl2"
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_0[j] != left_idx_stop_0[j] &&
+         right_idx_0[j] != right_idx_stop_0[j]) {
+        anyvalid = true;
+        if(rightelm0[j] < leftelm0[j]) {
+          op[out_idx_0[j]] = rightelm0[j];
+          right_idx_0[j]++;
+        } else {
+          op[out_idx_0[j]] = leftelm0[j];
+          left_idx_0[j]++;
+        }
+        out_idx_0[j]++;
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_1[j] != left_idx_stop_1[j] &&
+         right_idx_1[j] != right_idx_stop_1[j]) {
+        anyvalid = true;
+        if(rightelm1[j] < leftelm1[j]) {
+          op[out_idx_1[j]] = rightelm1[j];
+          right_idx_1[j]++;
+        } else {
+          op[out_idx_1[j]] = leftelm1[j];
+          left_idx_1[j]++;
+        }
+        out_idx_1[j]++;
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_2[j] != left_idx_stop_2[j] &&
+         right_idx_2[j] != right_idx_stop_2[j]) {
+        anyvalid = true;
+        if(rightelm2[j] < leftelm2[j]) {
+          op[out_idx_2[j]] = rightelm2[j];
+          right_idx_2[j]++;
+        } else {
+          op[out_idx_2[j]] = leftelm2[j];
+          left_idx_2[j]++;
+        }
+        out_idx_2[j]++;
+      }
+    }
+  }
+  for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+    out_idx[i] = out_idx_0[i];
+    out_idx[SET_VLEN_EACH * 1 + i] = out_idx_1[i];
+    out_idx[SET_VLEN_EACH * 2 + i] = out_idx_2[i];
+    left_idx[i] = left_idx_0[i];
+    left_idx[SET_VLEN_EACH * 1 + i] = left_idx_1[i];
+    left_idx[SET_VLEN_EACH * 2 + i] = left_idx_2[i];
+    right_idx[i] = right_idx_0[i];
+    right_idx[SET_VLEN_EACH * 1 + i] = right_idx_1[i];
+    right_idx[SET_VLEN_EACH * 2 + i] = right_idx_2[i];
+  }
+}
+
+template <class T>
+size_t set_merge_impl(const T* leftp, size_t left_size,
+                      const T* rightp, size_t right_size,
+                      T* outp) {
+  if(left_size == 0) {
+    for(size_t i = 0; i < right_size; i++) outp[i] = rightp[i];
+    return right_size;
+  }
+  if(right_size == 0) {
+    for(size_t i = 0; i < left_size; i++) outp[i] = leftp[i];
+    return left_size;
+  }
+
+  size_t left_idx[SET_VLEN];
+  size_t right_idx[SET_VLEN];
+  size_t left_idx_stop[SET_VLEN];
+  size_t right_idx_stop[SET_VLEN];
+  size_t out_idx[SET_VLEN];
+
+  set_operation_split(leftp, left_size, rightp, right_size,
+                      left_idx, right_idx, left_idx_stop, right_idx_stop);
+  out_idx[0] = 0;
+  for(int i = 1; i < SET_VLEN; i++) {
+    out_idx[i] = (left_idx[i] - left_idx[i-1]) +
+      (right_idx[i] - right_idx[i-1])
+      + out_idx[i-1];
+  }
+  set_merge_vreg(leftp, rightp, outp, 
+                 left_idx, right_idx,
+                 left_idx_stop, right_idx_stop,
+                 out_idx);
+
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    for(size_t j = 0; j < left_idx_stop[i] - left_idx[i]; j++) {
+      outp[out_idx[i] + j] = leftp[left_idx[i] + j];
+    }
+    for(size_t j = 0; j < right_idx_stop[i] - right_idx[i]; j++) {
+      outp[out_idx[i] + j] = rightp[right_idx[i] + j];
+    }
+  }
+  return left_size + right_size;
+}
+
+template <class T>
+void set_merge_desc_vreg(const T* lp, const T* rp, T* op, 
+                         size_t* left_idx, size_t* right_idx,
                          size_t* left_idx_stop, size_t* right_idx_stop,
                          size_t* out_idx) {
 #include "set_operations.incl1"
@@ -977,19 +1640,16 @@ void set_merge_desc_vreg(const T* lp, const T* rp, T* op,
 }
 
 template <class T>
-std::vector<T> set_merge_desc(const T* leftp, size_t left_size,
-                              const T* rightp, size_t right_size) {
+size_t set_merge_desc_impl(const T* leftp, size_t left_size,
+                           const T* rightp, size_t right_size,
+                           T* outp) {
   if(left_size == 0) {
-    std::vector<T> ret(right_size);
-    auto retp = ret.data();
-    for(size_t i = 0; i < right_size; i++) retp[i] = rightp[i];
-    return ret;
+    for(size_t i = 0; i < right_size; i++) outp[i] = rightp[i];
+    return right_size;
   }
   if(right_size == 0) {
-    std::vector<T> ret(left_size);
-    auto retp = ret.data();
-    for(size_t i = 0; i < left_size; i++) retp[i] = leftp[i];
-    return ret;
+    for(size_t i = 0; i < left_size; i++) outp[i] = leftp[i];
+    return left_size;
   }
 
   size_t each = ceil_div(left_size, size_t(SET_VLEN));
@@ -1000,8 +1660,6 @@ std::vector<T> set_merge_desc(const T* leftp, size_t left_size,
   size_t left_idx_stop[SET_VLEN];
   size_t right_idx_stop[SET_VLEN];
   size_t out_idx[SET_VLEN];
-  std::vector<T> out(left_size + right_size);
-  auto outp = out.data();
   for(int i = 0; i < SET_VLEN; i++) {
     size_t pos = each * i;
     if(pos < left_size) {
@@ -1048,7 +1706,7 @@ std::vector<T> set_merge_desc(const T* leftp, size_t left_size,
       outp[out_idx[i] + j] = rightp[right_idx[i] + j];
     }
   }
-  return out;
+  return left_size + right_size;
 }
 
 template <class T, class K>
@@ -1185,9 +1843,6 @@ void set_merge_pair(const T* leftp,
     for(size_t i = 0; i < left_size; i++) out_valp[i] = left_valp[i];
     return;
   }
-  size_t each = ceil_div(left_size, size_t(SET_VLEN));
-  if(each % 2 == 0) each++;
-  
   size_t left_idx[SET_VLEN];
   size_t right_idx[SET_VLEN];
   size_t left_idx_stop[SET_VLEN];
@@ -1197,27 +1852,9 @@ void set_merge_pair(const T* leftp,
   out_val.resize(left_size + right_size);
   auto outp = out.data();
   auto out_valp = out_val.data();
-  for(int i = 0; i < SET_VLEN; i++) {
-    size_t pos = each * i;
-    if(pos < left_size) {
-      left_idx[i] = pos;
-    } else {
-      left_idx[i] = left_size;
-    }
-  }
-
-  advance_to_split_vreg(left_idx, left_size, leftp);
 
-  T left_start[SET_VLEN];
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    if(left_idx[i] < left_size) left_start[i] = leftp[left_idx[i]];
-    else left_start[i] = 0;
-  }
-  lower_bound(rightp, right_size, left_start, SET_VLEN, right_idx);
-  right_idx[0] = 0;
-  for(size_t i = 0; i < SET_VLEN; i++) {
-    if(left_idx[i] == left_size) right_idx[i] = right_size; // left is not valid
-  }
+  set_operation_split(leftp, left_size, rightp, right_size,
+                      left_idx, right_idx, left_idx_stop, right_idx_stop);
   out_idx[0] = 0;
   for(int i = 1; i < SET_VLEN; i++) {
     out_idx[i] =
@@ -1225,12 +1862,6 @@ void set_merge_pair(const T* leftp,
       (right_idx[i] - right_idx[i-1]) +
       out_idx[i-1];
   }
-  for(int i = 0; i < SET_VLEN - 1; i++) {
-    left_idx_stop[i] = left_idx[i + 1];
-    right_idx_stop[i] = right_idx[i + 1];
-  }
-  left_idx_stop[SET_VLEN-1] = left_size;
-  right_idx_stop[SET_VLEN-1] = right_size;
   set_merge_pair_vreg(leftp, left_valp, rightp, right_valp, outp, out_valp,
                       left_idx, right_idx, left_idx_stop, right_idx_stop,
                       out_idx);
@@ -1444,27 +2075,949 @@ void set_merge_pair_desc(const T* leftp,
   }
 }
 
-template <class T>
-void set_separate_vreg(const T* keyp, size_t* outp, size_t* out_idx,
-                       size_t size, size_t each, size_t rest, T* current_key) {
-
-  size_t out_idx_vreg[SET_VLEN_EACH];
-  size_t current_key_vreg[SET_VLEN_EACH];
-#pragma _NEC vreg(out_idx_vreg)
-#pragma _NEC vreg(current_key_vreg)
-  for(size_t i = 0; i < SET_VLEN_EACH; i++){
-    out_idx_vreg[i] = out_idx[i];
-    current_key_vreg[i] = current_key[i];
-  }
-
-  for(size_t j = 0; j < each; j++) {
-#pragma _NEC ivdep
-#pragma _NEC vovertake
-    for(size_t i = 0; i < SET_VLEN_EACH; i++) {
-      auto loaded_key = keyp[i * each + j];
-      if(loaded_key != current_key_vreg[i]) {
-        outp[out_idx_vreg[i]++] = i * each + j;
-        current_key_vreg[i] = loaded_key;
+template <class T, class K>
+void set_intersection_pair_vreg(const T* lp, const K* lvp, const T* rp,
+                                T* op, K* ovp,
+                                size_t* left_idx, size_t* right_idx,
+                                size_t* left_idx_stop, size_t* right_idx_stop,
+                                size_t* out_idx) {
+#include "set_operations.incl1"
+  int anyvalid = true;
+  while(anyvalid) {
+    anyvalid = false;
+#include "set_operations.incl2"
+    K leftval0[SET_VLEN_EACH];
+    K leftval1[SET_VLEN_EACH];
+    K leftval2[SET_VLEN_EACH];
+#pragma _NEC vreg(leftval0)
+#pragma _NEC vreg(leftval1)
+#pragma _NEC vreg(leftval2)
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_0[j] != left_idx_stop_0[j] &&
+         right_idx_0[j] != right_idx_stop_0[j]) {
+        leftval0[j] = lvp[left_idx_0[j]];
+      }
+      if(left_idx_1[j] != left_idx_stop_1[j] &&
+         right_idx_1[j] != right_idx_stop_1[j]) {
+        leftval1[j] = lvp[left_idx_1[j]];
+      }
+      if(left_idx_2[j] != left_idx_stop_2[j] &&
+         right_idx_2[j] != right_idx_stop_2[j]) {
+        leftval2[j] = lvp[left_idx_2[j]];
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_0[j] != left_idx_stop_0[j] &&
+         right_idx_0[j] != right_idx_stop_0[j]) {
+        anyvalid = true;
+        if(leftelm0[j] < rightelm0[j]) {
+          left_idx_0[j]++;
+        } else {
+          if(!(rightelm0[j] < leftelm0[j])) {
+            op[out_idx_0[j]] = leftelm0[j];
+            ovp[out_idx_0[j]++] = leftval0[j];
+            left_idx_0[j]++;
+          }
+          right_idx_0[j]++;
+        }
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_1[j] != left_idx_stop_1[j] &&
+         right_idx_1[j] != right_idx_stop_1[j]) {
+        anyvalid = true;
+        if(leftelm1[j] < rightelm1[j]) {
+          left_idx_1[j]++;
+        } else {
+          if(!(rightelm1[j] < leftelm1[j])) {
+            op[out_idx_1[j]] = leftelm1[j];
+            ovp[out_idx_1[j]++] = leftval1[j];
+            left_idx_1[j]++;
+          }
+          right_idx_1[j]++;
+        }
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_2[j] != left_idx_stop_2[j] &&
+         right_idx_2[j] != right_idx_stop_2[j]) {
+        anyvalid = true;
+        if(leftelm2[j] < rightelm2[j]) {
+          left_idx_2[j]++;
+        } else {
+          if(!(rightelm2[j] < leftelm2[j])) {
+            op[out_idx_2[j]] = leftelm2[j];
+            ovp[out_idx_2[j]++] = leftval2[j];
+            left_idx_2[j]++;
+          }
+          right_idx_2[j]++;
+        }
+      }
+    }
+  }
+  for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+    out_idx[i] = out_idx_0[i];
+    out_idx[SET_VLEN_EACH * 1 + i] = out_idx_1[i];
+    out_idx[SET_VLEN_EACH * 2 + i] = out_idx_2[i];
+  }
+}
+
+template <class T>
+void set_intersection_index_vreg(const T* lp, const T* rp,
+                                 size_t* olp, size_t* orp,
+                                 size_t* left_idx, size_t* right_idx,
+                                 size_t* left_idx_stop, size_t* right_idx_stop,
+                                 size_t* out_idx) {
+#include "set_operations.incl1"
+  int anyvalid = true;
+  while(anyvalid) {
+    anyvalid = false;
+#include "set_operations.incl2"
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_0[j] != left_idx_stop_0[j] &&
+         right_idx_0[j] != right_idx_stop_0[j]) {
+        anyvalid = true;
+        if(leftelm0[j] < rightelm0[j]) {
+          left_idx_0[j]++;
+        } else {
+          if(!(rightelm0[j] < leftelm0[j])) {
+            olp[out_idx_0[j]] = left_idx_0[j];
+            orp[out_idx_0[j]++] = right_idx_0[j];
+            left_idx_0[j]++;
+          }
+          right_idx_0[j]++;
+        }
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_1[j] != left_idx_stop_1[j] &&
+         right_idx_1[j] != right_idx_stop_1[j]) {
+        anyvalid = true;
+        if(leftelm1[j] < rightelm1[j]) {
+          left_idx_1[j]++;
+        } else {
+          if(!(rightelm1[j] < leftelm1[j])) {
+            olp[out_idx_1[j]] = left_idx_1[j];
+            orp[out_idx_1[j]++] = right_idx_1[j];
+            left_idx_1[j]++;
+          }
+          right_idx_1[j]++;
+        }
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_2[j] != left_idx_stop_2[j] &&
+         right_idx_2[j] != right_idx_stop_2[j]) {
+        anyvalid = true;
+        if(leftelm2[j] < rightelm2[j]) {
+          left_idx_2[j]++;
+        } else {
+          if(!(rightelm2[j] < leftelm2[j])) {
+            olp[out_idx_2[j]] = left_idx_2[j];
+            orp[out_idx_2[j]++] = right_idx_2[j];
+            left_idx_2[j]++;
+          }
+          right_idx_2[j]++;
+        }
+      }
+    }
+  }
+  for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+    out_idx[i] = out_idx_0[i];
+    out_idx[SET_VLEN_EACH * 1 + i] = out_idx_1[i];
+    out_idx[SET_VLEN_EACH * 2 + i] = out_idx_2[i];
+  }
+}
+
+template <class T, class K>
+void set_union_pair_vreg(const T* lp, const K* lvp, const T* rp, const K* rvp,
+                         T* op, K* ovp, size_t* left_idx, size_t* right_idx,
+                         size_t* left_idx_stop, size_t* right_idx_stop,
+                         size_t* out_idx) {
+#include "set_operations.incl1"
+  int anyvalid = true;
+  while(anyvalid) {
+    anyvalid = false;
+#include "set_operations.incl2"
+    K leftval0[SET_VLEN_EACH];
+    K leftval1[SET_VLEN_EACH];
+    K leftval2[SET_VLEN_EACH];
+#pragma _NEC vreg(leftval0)
+#pragma _NEC vreg(leftval1)
+#pragma _NEC vreg(leftval2)
+    K rightval0[SET_VLEN_EACH];
+    K rightval1[SET_VLEN_EACH];
+    K rightval2[SET_VLEN_EACH];
+#pragma _NEC vreg(rightval0)
+#pragma _NEC vreg(rightval1)
+#pragma _NEC vreg(rightval2)
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_0[j] != left_idx_stop_0[j] &&
+         right_idx_0[j] != right_idx_stop_0[j]) {
+        leftval0[j] = lvp[left_idx_0[j]];
+        rightval0[j] = rvp[right_idx_0[j]];
+      }
+      if(left_idx_1[j] != left_idx_stop_1[j] &&
+         right_idx_1[j] != right_idx_stop_1[j]) {
+        leftval1[j] = lvp[left_idx_1[j]];
+        rightval1[j] = rvp[right_idx_1[j]];
+      }
+      if(left_idx_2[j] != left_idx_stop_2[j] &&
+         right_idx_2[j] != right_idx_stop_2[j]) {
+        leftval2[j] = lvp[left_idx_2[j]];
+        rightval2[j] = rvp[right_idx_2[j]];
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_0[j] != left_idx_stop_0[j] &&
+         right_idx_0[j] != right_idx_stop_0[j]) {
+        anyvalid = true;
+        if(rightelm0[j] < leftelm0[j]) {
+          op[out_idx_0[j]] = rightelm0[j];
+          ovp[out_idx_0[j]] = rightval0[j];
+          right_idx_0[j]++;
+        } else {
+          op[out_idx_0[j]] = leftelm0[j];
+          ovp[out_idx_0[j]] = leftval0[j];
+          if(!(leftelm0[j] < rightelm0[j])) {
+            right_idx_0[j]++;
+          }
+          left_idx_0[j]++;
+        }
+        out_idx_0[j]++;
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_1[j] != left_idx_stop_1[j] &&
+         right_idx_1[j] != right_idx_stop_1[j]) {
+        anyvalid = true;
+        if(rightelm1[j] < leftelm1[j]) {
+          op[out_idx_1[j]] = rightelm1[j];
+          ovp[out_idx_1[j]] = rightval1[j];
+          right_idx_1[j]++;
+        } else {
+          op[out_idx_1[j]] = leftelm1[j];
+          ovp[out_idx_1[j]] = leftval1[j];
+          if(!(leftelm1[j] < rightelm1[j])) {
+            right_idx_1[j]++;
+          }
+          left_idx_1[j]++;
+        }
+        out_idx_1[j]++;
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_2[j] != left_idx_stop_2[j] &&
+         right_idx_2[j] != right_idx_stop_2[j]) {
+        anyvalid = true;
+        if(rightelm2[j] < leftelm2[j]) {
+          op[out_idx_2[j]] = rightelm2[j];
+          ovp[out_idx_2[j]] = rightval2[j];
+          right_idx_2[j]++;
+        } else {
+          op[out_idx_2[j]] = leftelm2[j];
+          ovp[out_idx_2[j]] = leftval2[j];
+          if(!(leftelm2[j] < rightelm2[j])) {
+            right_idx_2[j]++;
+          }
+          left_idx_2[j]++;
+        }
+        out_idx_2[j]++;
+      }
+    }
+  }
+  for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+    out_idx[i] = out_idx_0[i];
+    out_idx[SET_VLEN_EACH * 1 + i] = out_idx_1[i];
+    out_idx[SET_VLEN_EACH * 2 + i] = out_idx_2[i];
+    left_idx[i] = left_idx_0[i];
+    left_idx[SET_VLEN_EACH * 1 + i] = left_idx_1[i];
+    left_idx[SET_VLEN_EACH * 2 + i] = left_idx_2[i];
+    right_idx[i] = right_idx_0[i];
+    right_idx[SET_VLEN_EACH * 1 + i] = right_idx_1[i];
+    right_idx[SET_VLEN_EACH * 2 + i] = right_idx_2[i];
+  }
+}
+
+template <class T, class K>
+void set_difference_pair_vreg(const T* lp, const K* lvp, const T* rp,
+                              T* op, K* ovp,
+                              size_t* left_idx, size_t* right_idx,
+                              size_t* left_idx_stop, size_t* right_idx_stop,
+                              size_t* out_idx) {
+#include "set_operations.incl1"
+  int anyvalid = true;
+  while(anyvalid) {
+    anyvalid = false;
+#include "set_operations.incl2"
+    K leftval0[SET_VLEN_EACH];
+    K leftval1[SET_VLEN_EACH];
+    K leftval2[SET_VLEN_EACH];
+#pragma _NEC vreg(leftval0)
+#pragma _NEC vreg(leftval1)
+#pragma _NEC vreg(leftval2)
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_0[j] != left_idx_stop_0[j] &&
+         right_idx_0[j] != right_idx_stop_0[j]) {
+        leftval0[j] = lvp[left_idx_0[j]];
+      }
+      if(left_idx_1[j] != left_idx_stop_1[j] &&
+         right_idx_1[j] != right_idx_stop_1[j]) {
+        leftval1[j] = lvp[left_idx_1[j]];
+      }
+      if(left_idx_2[j] != left_idx_stop_2[j] &&
+         right_idx_2[j] != right_idx_stop_2[j]) {
+        leftval2[j] = lvp[left_idx_2[j]];
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_0[j] != left_idx_stop_0[j] &&
+         right_idx_0[j] != right_idx_stop_0[j]) {
+        anyvalid = true;
+        if(leftelm0[j] < rightelm0[j]) {
+          op[out_idx_0[j]] = leftelm0[j];
+          ovp[out_idx_0[j]++] = leftval0[j];
+          left_idx_0[j]++;
+        } else {
+          if(!(rightelm0[j] < leftelm0[j])) {
+            left_idx_0[j]++;
+          }
+          right_idx_0[j]++;
+        }
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_1[j] != left_idx_stop_1[j] &&
+         right_idx_1[j] != right_idx_stop_1[j]) {
+        anyvalid = true;
+        if(leftelm1[j] < rightelm1[j]) {
+          op[out_idx_1[j]] = leftelm1[j];
+          ovp[out_idx_1[j]++] = leftval1[j];
+          left_idx_1[j]++;
+        } else {
+          if(!(rightelm1[j] < leftelm1[j])) {
+            left_idx_1[j]++;
+          }
+          right_idx_1[j]++;
+        }
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_2[j] != left_idx_stop_2[j] &&
+         right_idx_2[j] != right_idx_stop_2[j]) {
+        anyvalid = true;
+        if(leftelm2[j] < rightelm2[j]) {
+          op[out_idx_2[j]] = leftelm2[j];
+          ovp[out_idx_2[j]++] = leftval2[j];
+          left_idx_2[j]++;
+        } else {
+          if(!(rightelm2[j] < leftelm2[j])) {
+            left_idx_2[j]++;
+          }
+          right_idx_2[j]++;
+        }
+      }
+    }
+  }
+  for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+    out_idx[i] = out_idx_0[i];
+    out_idx[SET_VLEN_EACH * 1 + i] = out_idx_1[i];
+    out_idx[SET_VLEN_EACH * 2 + i] = out_idx_2[i];
+    left_idx[i] = left_idx_0[i];
+    left_idx[SET_VLEN_EACH * 1 + i] = left_idx_1[i];
+    left_idx[SET_VLEN_EACH * 2 + i] = left_idx_2[i];
+  }
+}
+
+template <class T, class K>
+void set_intersection_pair(const T* leftp,
+                           const K* left_valp,
+                           size_t left_size,
+                           const T* rightp,
+                           size_t right_size,
+                           std::vector<T>& out,
+                           std::vector<K>& out_val) {
+  if(left_size == 0 || right_size == 0) {
+    out.resize(0);
+    out_val.resize(0);
+    return;
+  }
+
+  size_t left_idx[SET_VLEN];
+  size_t right_idx[SET_VLEN];
+  size_t left_idx_stop[SET_VLEN];
+  size_t right_idx_stop[SET_VLEN];
+  size_t out_idx[SET_VLEN];
+  size_t out_idx_save[SET_VLEN];
+  std::vector<T> outtmp(left_size);
+  std::vector<K> out_valtmp(left_size);
+  auto outtmpp = outtmp.data();
+  auto out_valtmpp = out_valtmp.data();
+
+  set_intersection_split(leftp, left_size, rightp, right_size,
+                         left_idx, right_idx, left_idx_stop, right_idx_stop);
+  for(int i = 0; i < SET_VLEN; i++) {
+    out_idx[i] = left_idx[i];
+    out_idx_save[i] = left_idx[i];
+  }
+  set_intersection_pair_vreg(leftp, left_valp, rightp, outtmpp, out_valtmpp,
+                             left_idx, right_idx,
+                             left_idx_stop, right_idx_stop, out_idx);
+
+  size_t total = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    total += out_idx[i] - out_idx_save[i];
+  }
+  out.resize(total);
+  out_val.resize(total);
+  auto outp = out.data();
+  auto out_valp = out_val.data();
+  size_t current = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) {
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t j = 0; j < out_idx[i] - out_idx_save[i]; j++) {
+      outp[current + j] = outtmpp[out_idx_save[i] + j];
+      out_valp[current + j] = out_valtmpp[out_idx_save[i] + j];
+    }
+    current += out_idx[i] - out_idx_save[i];
+  }
+}
+
+template <class T>
+void set_intersection_index(const T* leftp, size_t left_size,
+                            const T* rightp, size_t right_size,
+                            std::vector<size_t>& left_pos,
+                            std::vector<size_t>& right_pos) {
+  if(left_size == 0 || right_size == 0) {
+    left_pos.resize(0);
+    right_pos.resize(0);
+    return;
+  }
+
+  size_t left_idx[SET_VLEN];
+  size_t right_idx[SET_VLEN];
+  size_t left_idx_stop[SET_VLEN];
+  size_t right_idx_stop[SET_VLEN];
+  size_t out_idx[SET_VLEN];
+  size_t out_idx_save[SET_VLEN];
+  std::vector<size_t> left_postmp(left_size);
+  std::vector<size_t> right_postmp(left_size);
+  auto left_postmpp = left_postmp.data();
+  auto right_postmpp = right_postmp.data();
+
+  set_intersection_split(leftp, left_size, rightp, right_size,
+                         left_idx, right_idx, left_idx_stop, right_idx_stop);
+  for(int i = 0; i < SET_VLEN; i++) {
+    out_idx[i] = left_idx[i];
+    out_idx_save[i] = left_idx[i];
+  }
+  set_intersection_index_vreg(leftp, rightp, left_postmpp, right_postmpp,
+                              left_idx, right_idx,
+                              left_idx_stop, right_idx_stop, out_idx);
+
+  size_t total = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    total += out_idx[i] - out_idx_save[i];
+  }
+  left_pos.resize(total);
+  right_pos.resize(total);
+  auto left_posp = left_pos.data();
+  auto right_posp = right_pos.data();
+  size_t current = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) {
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t j = 0; j < out_idx[i] - out_idx_save[i]; j++) {
+      left_posp[current + j] = left_postmpp[out_idx_save[i] + j];
+      right_posp[current + j] = right_postmpp[out_idx_save[i] + j];
+    }
+    current += out_idx[i] - out_idx_save[i];
+  }
+}
+
+template <class T, class K>
+void set_union_pair(const T* leftp,
+                    const K* left_valp,
+                    size_t left_size,
+                    const T* rightp,
+                    const K* right_valp,
+                    size_t right_size,
+                    std::vector<T>& out,
+                    std::vector<K>& out_val) {
+  if(left_size == 0 || right_size == 0) {
+    auto srcp = left_size == 0 ? rightp : leftp;
+    auto src_valp = left_size == 0 ? right_valp : left_valp;
+    auto size = left_size + right_size;
+    out.resize(size);
+    out_val.resize(size);
+    auto outp = out.data();
+    auto out_valp = out_val.data();
+    for(size_t i = 0; i < size; i++) outp[i] = srcp[i];
+    for(size_t i = 0; i < size; i++) out_valp[i] = src_valp[i];
+    return;
+  }
+
+  size_t left_idx[SET_VLEN];
+  size_t right_idx[SET_VLEN];
+  size_t left_idx_stop[SET_VLEN];
+  size_t right_idx_stop[SET_VLEN];
+  size_t out_idx[SET_VLEN];
+  size_t out_idx_save[SET_VLEN];
+  std::vector<T> outtmp(left_size + right_size);
+  std::vector<K> out_valtmp(left_size + right_size);
+  auto outtmpp = outtmp.data();
+  auto out_valtmpp = out_valtmp.data();
+
+  set_operation_split(leftp, left_size, rightp, right_size,
+                      left_idx, right_idx, left_idx_stop, right_idx_stop);
+  out_idx[0] = 0;
+  out_idx_save[0] = 0;
+  for(int i = 1; i < SET_VLEN; i++) {
+    out_idx[i] = (left_idx[i] - left_idx[i-1])
+      + (right_idx[i] - right_idx[i-1])
+      + out_idx[i-1];
+    out_idx_save[i] = out_idx[i];
+  }
+  set_union_pair_vreg(leftp, left_valp, rightp, right_valp,
+                      outtmpp, out_valtmpp,
+                      left_idx, right_idx, left_idx_stop, right_idx_stop,
+                      out_idx);
+
+  size_t total = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    total += (out_idx[i] - out_idx_save[i]) +
+      (left_idx_stop[i] - left_idx[i]) +
+      (right_idx_stop[i] - right_idx[i]);
+  }
+  out.resize(total);
+  out_val.resize(total);
+  auto outp = out.data();
+  auto out_valp = out_val.data();
+  size_t current = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    for(size_t j = 0; j < out_idx[i] - out_idx_save[i]; j++) {
+      outp[current + j] = outtmpp[out_idx_save[i] + j];
+      out_valp[current + j] = out_valtmpp[out_idx_save[i] + j];
+    }
+    current += out_idx[i] - out_idx_save[i];
+    for(size_t j = 0; j < left_idx_stop[i] - left_idx[i]; j++) {
+      outp[current + j] = leftp[left_idx[i] + j];
+      out_valp[current + j] = left_valp[left_idx[i] + j];
+    }
+    current += left_idx_stop[i] - left_idx[i];
+    for(size_t j = 0; j < right_idx_stop[i] - right_idx[i]; j++) {
+      outp[current + j] = rightp[right_idx[i] + j];
+      out_valp[current + j] = right_valp[right_idx[i] + j];
+    }
+    current += right_idx_stop[i] - right_idx[i];
+  }
+}
+
+template <class T, class K>
+void set_difference_pair(const T* leftp,
+                         const K* left_valp,
+                         size_t left_size,
+                         const T* rightp,
+                         size_t right_size,
+                         std::vector<T>& out,
+                         std::vector<K>& out_val) {
+  if(left_size == 0 || right_size == 0) {
+    out.resize(left_size);
+    out_val.resize(left_size);
+    auto outp = out.data();
+    auto out_valp = out_val.data();
+    for(size_t i = 0; i < left_size; i++) outp[i] = leftp[i];
+    for(size_t i = 0; i < left_size; i++) out_valp[i] = left_valp[i];
+    return;
+  }
+
+  size_t left_idx[SET_VLEN];
+  size_t right_idx[SET_VLEN];
+  size_t left_idx_stop[SET_VLEN];
+  size_t right_idx_stop[SET_VLEN];
+  size_t out_idx[SET_VLEN];
+  size_t out_idx_save[SET_VLEN];
+  std::vector<T> outtmp(left_size);
+  std::vector<K> out_valtmp(left_size);
+  auto outtmpp = outtmp.data();
+  auto out_valtmpp = out_valtmp.data();
+
+  set_operation_split(leftp, left_size, rightp, right_size,
+                      left_idx, right_idx, left_idx_stop, right_idx_stop);
+  for(int i = 0; i < SET_VLEN; i++) {
+    out_idx[i] = left_idx[i];
+    out_idx_save[i] = left_idx[i];
+  }
+  set_difference_pair_vreg(leftp, left_valp, rightp, outtmpp, out_valtmpp,
+                           left_idx, right_idx, left_idx_stop, right_idx_stop,
+                           out_idx);
+
+  size_t total = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    total += (out_idx[i] - out_idx_save[i]) +
+      (left_idx_stop[i] - left_idx[i]);
+  }
+  out.resize(total);
+  out_val.resize(total);
+  auto outp = out.data();
+  auto out_valp = out_val.data();
+  size_t current = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    for(size_t j = 0; j < out_idx[i] - out_idx_save[i]; j++) {
+      outp[current + j] = outtmpp[out_idx_save[i] + j];
+      out_valp[current + j] = out_valtmpp[out_idx_save[i] + j];
+    }
+    current += out_idx[i] - out_idx_save[i];
+    for(size_t j = 0; j < left_idx_stop[i] - left_idx[i]; j++) {
+      outp[current + j] = leftp[left_idx[i] + j];
+      out_valp[current + j] = left_valp[left_idx[i] + j];
+    }
+    current += left_idx_stop[i] - left_idx[i];
+  }
+}
+
+template <class T, class K>
+void set_symmetric_difference_pair_vreg(const T* lp, const K* lvp,
+                                        const T* rp, const K* rvp,
+                                        T* op, K* ovp,
+                                        size_t* left_idx, size_t* right_idx,
+                                        size_t* left_idx_stop,
+                                        size_t* right_idx_stop,
+                                        size_t* out_idx) {
+#include "set_operations.incl1"
+  int anyvalid = true;
+  while(anyvalid) {
+    anyvalid = false;
+#include "set_operations.incl2"
+    K leftval0[SET_VLEN_EACH];
+    K leftval1[SET_VLEN_EACH];
+    K leftval2[SET_VLEN_EACH];
+#pragma _NEC vreg(leftval0)
+#pragma _NEC vreg(leftval1)
+#pragma _NEC vreg(leftval2)
+    K rightval0[SET_VLEN_EACH];
+    K rightval1[SET_VLEN_EACH];
+    K rightval2[SET_VLEN_EACH];
+#pragma _NEC vreg(rightval0)
+#pragma _NEC vreg(rightval1)
+#pragma _NEC vreg(rightval2)
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_0[j] != left_idx_stop_0[j] &&
+         right_idx_0[j] != right_idx_stop_0[j]) {
+        leftval0[j] = lvp[left_idx_0[j]];
+        rightval0[j] = rvp[right_idx_0[j]];
+      }
+      if(left_idx_1[j] != left_idx_stop_1[j] &&
+         right_idx_1[j] != right_idx_stop_1[j]) {
+        leftval1[j] = lvp[left_idx_1[j]];
+        rightval1[j] = rvp[right_idx_1[j]];
+      }
+      if(left_idx_2[j] != left_idx_stop_2[j] &&
+         right_idx_2[j] != right_idx_stop_2[j]) {
+        leftval2[j] = lvp[left_idx_2[j]];
+        rightval2[j] = rvp[right_idx_2[j]];
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_0[j] != left_idx_stop_0[j] &&
+         right_idx_0[j] != right_idx_stop_0[j]) {
+        anyvalid = true;
+        if(leftelm0[j] < rightelm0[j]) {
+          op[out_idx_0[j]] = leftelm0[j];
+          ovp[out_idx_0[j]++] = leftval0[j];
+          left_idx_0[j]++;
+        } else if(rightelm0[j] < leftelm0[j]) {
+          op[out_idx_0[j]] = rightelm0[j];
+          ovp[out_idx_0[j]++] = rightval0[j];
+          right_idx_0[j]++;
+        } else {
+          left_idx_0[j]++;
+          right_idx_0[j]++;
+        }
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_1[j] != left_idx_stop_1[j] &&
+         right_idx_1[j] != right_idx_stop_1[j]) {
+        anyvalid = true;
+        if(leftelm1[j] < rightelm1[j]) {
+          op[out_idx_1[j]] = leftelm1[j];
+          ovp[out_idx_1[j]++] = leftval1[j];
+          left_idx_1[j]++;
+        } else if(rightelm1[j] < leftelm1[j]) {
+          op[out_idx_1[j]] = rightelm1[j];
+          ovp[out_idx_1[j]++] = rightval1[j];
+          right_idx_1[j]++;
+        } else {
+          left_idx_1[j]++;
+          right_idx_1[j]++;
+        }
+      }
+    }
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(int j = 0; j < SET_VLEN_EACH; j++) {
+      if(left_idx_2[j] != left_idx_stop_2[j] &&
+         right_idx_2[j] != right_idx_stop_2[j]) {
+        anyvalid = true;
+        if(leftelm2[j] < rightelm2[j]) {
+          op[out_idx_2[j]] = leftelm2[j];
+          ovp[out_idx_2[j]++] = leftval2[j];
+          left_idx_2[j]++;
+        } else if(rightelm2[j] < leftelm2[j]) {
+          op[out_idx_2[j]] = rightelm2[j];
+          ovp[out_idx_2[j]++] = rightval2[j];
+          right_idx_2[j]++;
+        } else {
+          left_idx_2[j]++;
+          right_idx_2[j]++;
+        }
+      }
+    }
+  }
+  for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+    out_idx[i] = out_idx_0[i];
+    out_idx[SET_VLEN_EACH * 1 + i] = out_idx_1[i];
+    out_idx[SET_VLEN_EACH * 2 + i] = out_idx_2[i];
+    left_idx[i] = left_idx_0[i];
+    left_idx[SET_VLEN_EACH * 1 + i] = left_idx_1[i];
+    left_idx[SET_VLEN_EACH * 2 + i] = left_idx_2[i];
+    right_idx[i] = right_idx_0[i];
+    right_idx[SET_VLEN_EACH * 1 + i] = right_idx_1[i];
+    right_idx[SET_VLEN_EACH * 2 + i] = right_idx_2[i];
+  }
+}
+
+template <class T, class K>
+void set_symmetric_difference_pair(const T* leftp,
+                                   const K* left_valp,
+                                   size_t left_size,
+                                   const T* rightp,
+                                   const K* right_valp,
+                                   size_t right_size,
+                                   std::vector<T>& out,
+                                   std::vector<K>& out_val) {
+  if(left_size == 0 || right_size == 0) {
+    auto srcp = left_size == 0 ? rightp : leftp;
+    auto src_valp = left_size == 0 ? right_valp : left_valp;
+    auto size = left_size + right_size;
+    out.resize(size);
+    out_val.resize(size);
+    auto outp = out.data();
+    auto out_valp = out_val.data();
+    for(size_t i = 0; i < size; i++) outp[i] = srcp[i];
+    for(size_t i = 0; i < size; i++) out_valp[i] = src_valp[i];
+    return;
+  }
+
+  size_t left_idx[SET_VLEN];
+  size_t right_idx[SET_VLEN];
+  size_t left_idx_stop[SET_VLEN];
+  size_t right_idx_stop[SET_VLEN];
+  size_t out_idx[SET_VLEN];
+  size_t out_idx_save[SET_VLEN];
+  std::vector<T> outtmp(left_size + right_size);
+  std::vector<K> out_valtmp(left_size + right_size);
+  auto outtmpp = outtmp.data();
+  auto out_valtmpp = out_valtmp.data();
+
+  set_operation_split(leftp, left_size, rightp, right_size,
+                      left_idx, right_idx, left_idx_stop, right_idx_stop);
+  out_idx[0] = 0;
+  out_idx_save[0] = 0;
+  for(int i = 1; i < SET_VLEN; i++) {
+    out_idx[i] = (left_idx[i] - left_idx[i-1])
+      + (right_idx[i] - right_idx[i-1])
+      + out_idx[i-1];
+    out_idx_save[i] = out_idx[i];
+  }
+  set_symmetric_difference_pair_vreg(leftp, left_valp, rightp, right_valp,
+                                     outtmpp, out_valtmpp,
+                                     left_idx, right_idx,
+                                     left_idx_stop, right_idx_stop,
+                                     out_idx);
+
+  size_t total = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    total += (out_idx[i] - out_idx_save[i]) +
+      (left_idx_stop[i] - left_idx[i]) +
+      (right_idx_stop[i] - right_idx[i]);
+  }
+  out.resize(total);
+  out_val.resize(total);
+  auto outp = out.data();
+  auto out_valp = out_val.data();
+  size_t current = 0;
+  for(size_t i = 0; i < SET_VLEN; i++) {
+    for(size_t j = 0; j < out_idx[i] - out_idx_save[i]; j++) {
+      outp[current + j] = outtmpp[out_idx_save[i] + j];
+      out_valp[current + j] = out_valtmpp[out_idx_save[i] + j];
+    }
+    current += out_idx[i] - out_idx_save[i];
+    for(size_t j = 0; j < left_idx_stop[i] - left_idx[i]; j++) {
+      outp[current + j] = leftp[left_idx[i] + j];
+      out_valp[current + j] = left_valp[left_idx[i] + j];
+    }
+    current += left_idx_stop[i] - left_idx[i];
+    for(size_t j = 0; j < right_idx_stop[i] - right_idx[i]; j++) {
+      outp[current + j] = rightp[right_idx[i] + j];
+      out_valp[current + j] = right_valp[right_idx[i] + j];
+    }
+    current += right_idx_stop[i] - right_idx[i];
+  }
+}
+
+template <class T>
+void set_separate_vreg(const T* keyp, size_t* outp, size_t* out_idx,
+                       size_t size, size_t each, size_t rest, T* current_key) {
+
+  size_t out_idx_vreg[SET_VLEN_EACH];
+  size_t current_key_vreg[SET_VLEN_EACH];
+#pragma _NEC vreg(out_idx_vreg)
+#pragma _NEC vreg(current_key_vreg)
+  for(size_t i = 0; i < SET_VLEN_EACH; i++){
+    out_idx_vreg[i] = out_idx[i];
+    current_key_vreg[i] = current_key[i];
+  }
+
+  for(size_t j = 0; j < each; j++) {
+#pragma _NEC ivdep
+#pragma _NEC vovertake
+    for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+      auto loaded_key = keyp[i * each + j];
+      if(loaded_key != current_key_vreg[i]) {
+        outp[out_idx_vreg[i]++] = i * each + j;
+        current_key_vreg[i] = loaded_key;
+      }
+    }
+  }
+  auto offset = SET_VLEN_EACH * each;
+  auto out_idx_rest = out_idx[SET_VLEN_EACH];
+  auto current_key_rest = current_key[SET_VLEN_EACH];
+#pragma _NEC ivdep
+  for(size_t i = 0; i < rest; i++) {
+    auto loaded_key = keyp[offset + i];
+    if(loaded_key != current_key_rest) {
+      outp[out_idx_rest++] = offset + i;
+      current_key_rest = loaded_key;
+    }
+  }
+  for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+    out_idx[i] = out_idx_vreg[i];
+  }
+  out_idx[SET_VLEN_EACH] = out_idx_rest;
+}
+
+template <class T>
+std::vector<size_t> set_separate(const T* keyp, size_t size) {
+  if(size == 0) {return std::vector<size_t>(1);} 
+  size_t each = size / SET_VLEN_EACH;
+  if(each % 2 == 0 && each > 0) each--;
+  size_t rest = size - each * SET_VLEN_EACH;
+  std::vector<size_t> out(size);
+  auto outp = out.data();
+  if(each == 0) {
+    auto current = keyp[0];
+    outp[0] = 0;
+    size_t out_idx = 1;
+    for(size_t i = 1; i < size; i++) {
+      auto loaded = keyp[i];
+      if(loaded != current) {
+        outp[out_idx++] = i;
+        current = loaded;
+      }
+    }
+    std::vector<size_t> ret(out_idx+1);
+    auto retp = ret.data();
+    for(size_t i = 0; i < out_idx; i++) {
+      retp[i] = outp[i];
+    }
+    retp[out_idx] = size;
+    return ret;
+  } else {
+    size_t out_idx[SET_VLEN_EACH+1];
+    T current_key[SET_VLEN_EACH+1];
+    current_key[0] = keyp[0]; // size > 0
+    for(int i = 1; i < SET_VLEN_EACH+1; i++) {
+      current_key[i] = keyp[each * i - 1]; // each > 0
+    }
+    for(int i = 0; i < SET_VLEN_EACH+1; i++) {
+      out_idx[i] = each * i;
+    }
+
+    set_separate_vreg(keyp, outp, out_idx, size, each, rest, current_key);
+
+    size_t total = 0;
+    for(size_t i = 0; i < SET_VLEN_EACH+1; i++) {
+      total += out_idx[i] - each * i;
+    }
+    std::vector<size_t> ret(total+2);
+    size_t* retp = ret.data();
+    size_t current = 0;
+    for(size_t i = 0; i < SET_VLEN_EACH+1; i++) {
+      auto crnt_size = out_idx[i] - each * i;
+      for(size_t j = 0; j < crnt_size; j++) {
+        retp[current + j + 1] = out[each * i + j];
+      }
+      current += crnt_size;
+    }
+    retp[current+1] = size;
+    return ret;
+  }
+}
+
+// same as set_separate_vreg, but also writes the key
+template <class T>
+void run_length_encode_vreg(const T* keyp, T* out_keyp, size_t* out_offsetp,
+                            size_t* out_idx, size_t size, size_t each,
+                            size_t rest, T* current_key) {
+  size_t out_idx_vreg[SET_VLEN_EACH];
+  T current_key_vreg[SET_VLEN_EACH];
+#pragma _NEC vreg(out_idx_vreg)
+#pragma _NEC vreg(current_key_vreg)
+  for(size_t i = 0; i < SET_VLEN_EACH; i++){
+    out_idx_vreg[i] = out_idx[i];
+    current_key_vreg[i] = current_key[i];
+  }
+
+  for(size_t j = 0; j < each; j++) {
+#pragma _NEC ivdep
+#pragma _NEC vovertake
+    for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+      auto loaded_key = keyp[i * each + j];
+      if(loaded_key != current_key_vreg[i]) {
+        out_keyp[out_idx_vreg[i]] = loaded_key;
+        out_offsetp[out_idx_vreg[i]++] = i * each + j;
+        current_key_vreg[i] = loaded_key;
       }
     }
   }
@@ -1475,7 +3028,8 @@ void set_separate_vreg(const T* keyp, size_t* outp, size_t* out_idx,
   for(size_t i = 0; i < rest; i++) {
     auto loaded_key = keyp[offset + i];
     if(loaded_key != current_key_rest) {
-      outp[out_idx_rest++] = offset + i;
+      out_keyp[out_idx_rest] = loaded_key;
+      out_offsetp[out_idx_rest++] = offset + i;
       current_key_rest = loaded_key;
     }
   }
@@ -1485,32 +3039,29 @@ void set_separate_vreg(const T* keyp, size_t* outp, size_t* out_idx,
   out_idx[SET_VLEN_EACH] = out_idx_rest;
 }
 
+// out_keyp and out_offsetp should have size capacity;
+// returns the number of runs
 template <class T>
-std::vector<size_t> set_separate(const T* keyp, size_t size) {
-  if(size == 0) {return std::vector<size_t>(1);} 
+size_t run_length_encode_impl(const T* keyp, size_t size,
+                              T* out_keyp, size_t* out_offsetp) {
+  if(size == 0) return 0;
   size_t each = size / SET_VLEN_EACH;
   if(each % 2 == 0 && each > 0) each--;
   size_t rest = size - each * SET_VLEN_EACH;
-  std::vector<size_t> out(size);
-  auto outp = out.data();
+  out_keyp[0] = keyp[0];
+  out_offsetp[0] = 0;
   if(each == 0) {
     auto current = keyp[0];
-    outp[0] = 0;
     size_t out_idx = 1;
     for(size_t i = 1; i < size; i++) {
       auto loaded = keyp[i];
       if(loaded != current) {
-        outp[out_idx++] = i;
+        out_keyp[out_idx] = loaded;
+        out_offsetp[out_idx++] = i;
         current = loaded;
       }
     }
-    std::vector<size_t> ret(out_idx+1);
-    auto retp = ret.data();
-    for(size_t i = 0; i < out_idx; i++) {
-      retp[i] = outp[i];
-    }
-    retp[out_idx] = size;
-    return ret;
+    return out_idx;
   } else {
     size_t out_idx[SET_VLEN_EACH+1];
     T current_key[SET_VLEN_EACH+1];
@@ -1518,31 +3069,104 @@ std::vector<size_t> set_separate(const T* keyp, size_t size) {
     for(int i = 1; i < SET_VLEN_EACH+1; i++) {
       current_key[i] = keyp[each * i - 1]; // each > 0
     }
-    for(int i = 0; i < SET_VLEN_EACH+1; i++) {
+    // the first part never outputs position 0, so it fits after it
+    out_idx[0] = 1;
+    for(int i = 1; i < SET_VLEN_EACH+1; i++) {
       out_idx[i] = each * i;
     }
 
-    set_separate_vreg(keyp, outp, out_idx, size, each, rest, current_key);
+    run_length_encode_vreg(keyp, out_keyp, out_offsetp, out_idx,
+                           size, each, rest, current_key);
 
-    size_t total = 0;
-    for(size_t i = 0; i < SET_VLEN_EACH+1; i++) {
-      total += out_idx[i] - each * i;
-    }
-    std::vector<size_t> ret(total+2);
-    size_t* retp = ret.data();
-    size_t current = 0;
-    for(size_t i = 0; i < SET_VLEN_EACH+1; i++) {
+    size_t current = out_idx[0];
+    for(size_t i = 1; i < SET_VLEN_EACH+1; i++) {
       auto crnt_size = out_idx[i] - each * i;
+#pragma cdir nodep
+#pragma _NEC ivdep
       for(size_t j = 0; j < crnt_size; j++) {
-        retp[current + j + 1] = out[each * i + j];
+        out_keyp[current + j] = out_keyp[each * i + j];
+        out_offsetp[current + j] = out_offsetp[each * i + j];
       }
       current += crnt_size;
     }
-    retp[current+1] = size;
-    return ret;
+    return current;
+  }
+}
+
+// each lane writes a contiguous part of the output; endp is the
+// inclusive prefix sum of the counts, which should not be zero
+template <class T>
+void run_length_decode_vreg(const T* keyp, const size_t* endp, T* outp,
+                            size_t* run, size_t* pos, size_t* pos_stop,
+                            size_t each) {
+  size_t run_vreg[SET_VLEN_EACH];
+  size_t end_vreg[SET_VLEN_EACH];
+  size_t pos_vreg[SET_VLEN_EACH];
+  size_t pos_stop_vreg[SET_VLEN_EACH];
+#pragma _NEC vreg(run_vreg)
+#pragma _NEC vreg(end_vreg)
+#pragma _NEC vreg(pos_vreg)
+#pragma _NEC vreg(pos_stop_vreg)
+  for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+    run_vreg[i] = run[i];
+    pos_vreg[i] = pos[i];
+    pos_stop_vreg[i] = pos_stop[i];
+    if(pos_vreg[i] < pos_stop_vreg[i]) end_vreg[i] = endp[run_vreg[i]];
+    else end_vreg[i] = 0;
+  }
+  for(size_t j = 0; j < each; j++) {
+#pragma _NEC ivdep
+    for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+      if(pos_vreg[i] < pos_stop_vreg[i]) {
+        if(pos_vreg[i] == end_vreg[i]) {
+          run_vreg[i]++;
+          end_vreg[i] = endp[run_vreg[i]];
+        }
+        outp[pos_vreg[i]++] = keyp[run_vreg[i]];
+      }
+    }
   }
 }
 
+template <class T>
+void run_length_decode_impl(const T* keyp, const size_t* countp,
+                            size_t num_runs, T* outp) {
+  if(num_runs == 0) return;
+  size_t zero_count = 0;
+  for(size_t i = 0; i < num_runs; i++) zero_count += (countp[i] == 0);
+  if(zero_count > 0) {
+    size_t nonzero_size = num_runs - zero_count;
+    std::vector<T> nonzero_key(nonzero_size);
+    std::vector<size_t> nonzero_count(nonzero_size);
+    auto nonzero_keyp = nonzero_key.data();
+    auto nonzero_countp = nonzero_count.data();
+    size_t current = 0;
+    for(size_t i = 0; i < num_runs; i++) {
+      if(countp[i] != 0) {
+        nonzero_keyp[current] = keyp[i];
+        nonzero_countp[current++] = countp[i];
+      }
+    }
+    run_length_decode_impl(nonzero_keyp, nonzero_countp, nonzero_size, outp);
+    return;
+  }
+  std::vector<size_t> end(num_runs);
+  auto endp = end.data();
+  prefix_sum(countp, endp, num_runs);
+  size_t total = endp[num_runs - 1];
+  size_t each = ceil_div(total, size_t(SET_VLEN_EACH));
+  size_t pos[SET_VLEN_EACH];
+  size_t pos_stop[SET_VLEN_EACH];
+  size_t run[SET_VLEN_EACH];
+  for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+    pos[i] = std::min(each * i, total);
+    pos_stop[i] = std::min(each * (i + 1), total);
+  }
+  // the run that contains pos is the first one whose end is larger
+  upper_bound(endp, num_runs, pos, SET_VLEN_EACH, run);
+  run_length_decode_vreg(keyp, endp, outp, run, pos, pos_stop, each);
+}
+
 template <class T>
 void set_unique_vreg(const T* keyp, T* outp, size_t* out_idx,
                      size_t size, size_t each, size_t rest, T* current_key) {
@@ -1585,13 +3209,11 @@ void set_unique_vreg(const T* keyp, T* outp, size_t* out_idx,
 }
 
 template <class T>
-std::vector<T> set_unique(const T* keyp, size_t size) {
-  if(size == 0) {return std::vector<T>();} 
+size_t set_unique_impl(const T* keyp, size_t size, T* outp) {
+  if(size == 0) return 0;
   size_t each = size / SET_VLEN_EACH;
   if(each % 2 == 0 && each > 0) each--;
   size_t rest = size - each * SET_VLEN_EACH;
-  std::vector<T> out(size);
-  auto outp = out.data();
   if(each == 0) {
     auto current = keyp[0];
     outp[0] = current;
@@ -1603,12 +3225,7 @@ std::vector<T> set_unique(const T* keyp, size_t size) {
         current = loaded;
       }
     }
-    std::vector<T> ret(out_idx);
-    auto retp = ret.data();
-    for(size_t i = 0; i < out_idx; i++) {
-      retp[i] = outp[i];
-    }
-    return ret;
+    return out_idx;
   } else {
     size_t out_idx[SET_VLEN_EACH+1];
     T current_key[SET_VLEN_EACH+1];
@@ -1616,98 +3233,518 @@ std::vector<T> set_unique(const T* keyp, size_t size) {
     for(int i = 1; i < SET_VLEN_EACH+1; i++) {
       current_key[i] = keyp[each * i - 1]; // each > 0
     }
-    for(int i = 0; i < SET_VLEN_EACH+1; i++) {
+    // the first part never outputs keyp[0], so it fits after it
+    outp[0] = keyp[0];
+    out_idx[0] = 1;
+    for(int i = 1; i < SET_VLEN_EACH+1; i++) {
       out_idx[i] = each * i;
     }
 
-    set_unique_vreg(keyp, outp, out_idx, size, each, rest, current_key);
+    set_unique_vreg(keyp, outp, out_idx, size, each, rest, current_key);
+
+    size_t current = out_idx[0];
+    for(size_t i = 1; i < SET_VLEN_EACH+1; i++) {
+      auto crnt_size = out_idx[i] - each * i;
+#pragma cdir nodep
+#pragma _NEC ivdep
+      for(size_t j = 0; j < crnt_size; j++) {
+        outp[current + j] = outp[each * i + j];
+      }
+      current += crnt_size;
+    }
+    return current;
+  }
+}
+
+template <class T>
+int set_is_unique_vreg(const T* keyp, size_t size, size_t each, size_t rest,
+                       T* current_key) {
+  size_t current_key_vreg[SET_VLEN_EACH];
+#pragma _NEC vreg(current_key_vreg)
+  for(size_t i = 0; i < SET_VLEN_EACH; i++){
+    current_key_vreg[i] = current_key[i];
+  }
+
+  for(size_t j = 0; j < each; j++) {
+#pragma _NEC ivdep
+#pragma _NEC vovertake
+    for(size_t i = 0; i < SET_VLEN_EACH; i++) {
+      auto loaded_key = keyp[i * each + j];
+      if(loaded_key == current_key_vreg[i]) {
+        return false;
+      } else {
+        current_key_vreg[i] = loaded_key;
+      }
+    }
+  }
+  auto offset = SET_VLEN_EACH * each;
+  auto current_key_rest = current_key[SET_VLEN_EACH];
+#pragma _NEC ivdep
+  for(size_t i = 0; i < rest; i++) {
+    auto loaded_key = keyp[offset + i];
+    if(loaded_key == current_key_rest) {
+      return false;
+    } else {
+      current_key_rest = loaded_key;
+    }
+  }
+  return true;
+}
+
+template <class T>
+int set_is_unique(const T* keyp, size_t size) {
+  if(size == 0) {return true;} 
+  size_t size2 = size - 1;
+  size_t each = size2 / SET_VLEN_EACH;
+  if(each % 2 == 0 && each > 0) each--;
+  size_t rest = size2 - each * SET_VLEN_EACH;
+  std::vector<T> out(size);
+  auto outp = out.data();
+  if(each == 0) {
+    auto current = keyp[0];
+    outp[0] = current;
+    for(size_t i = 1; i < size; i++) {
+      auto loaded = keyp[i];
+      if(loaded == current) {
+        return false;
+      } else {
+        current = loaded;
+      }
+    }
+    return true;
+  } else {
+    T current_key[SET_VLEN_EACH+1];
+    current_key[0] = keyp[0]; // size > 0
+    for(int i = 1; i < SET_VLEN_EACH+1; i++) {
+      current_key[i] = keyp[each * i - 1]; // each > 0
+    }
+    return set_is_unique_vreg(keyp+1, size2, each, rest, current_key);
+  }
+}
+
+#endif // _SX
+
+// Output size that is enough for *_into to write directly to the output.
+inline size_t set_intersection_max_size(size_t left_size, size_t right_size) {
+#if defined(_SX) || defined(__ve__)
+  return left_size; // parts are written at their position in left
+#else
+  return std::min(left_size, right_size);
+#endif
+}
+
+inline size_t set_union_max_size(size_t left_size, size_t right_size) {
+  return left_size + right_size;
+}
+
+inline size_t set_difference_max_size(size_t left_size, size_t right_size) {
+  return left_size;
+}
+
+inline size_t set_symmetric_difference_max_size(size_t left_size,
+                                                size_t right_size) {
+  return left_size + right_size;
+}
+
+inline size_t set_merge_max_size(size_t left_size, size_t right_size) {
+  return left_size + right_size;
+}
+
+inline size_t set_merge_desc_max_size(size_t left_size, size_t right_size) {
+  return left_size + right_size;
+}
+
+inline size_t set_unique_max_size(size_t size) {
+  return size;
+}
+
+template <class T>
+size_t set_copy_into(const T* workp, size_t size, T* outp, size_t capacity,
+                     const char* name) {
+  if(size > capacity)
+    throw std::runtime_error(std::string(name) + ": capacity is too small");
+  for(size_t i = 0; i < size; i++) outp[i] = workp[i];
+  return size;
+}
+
+#if defined(_SX) || defined(__ve__)
+#define SET_DENSE_INTERSECTION_DENSITY 0.1
+#define SET_DENSE_UNION_DENSITY 0.1 // union uses dense_bitset only on VE
+#else
+#define SET_DENSE_INTERSECTION_DENSITY 0.2
+#endif
+#define SET_DENSE_MIN_SIZE 65536
+
+// density estimated from the first and the last value; more values
+// than the range means that there are duplicated values
+template <class T>
+bool set_is_dense(const T* keyp, size_t size, double density) {
+  if(size < SET_DENSE_MIN_SIZE) return false;
+  double range = static_cast<double>(keyp[size-1]) -
+    static_cast<double>(keyp[0]) + 1;
+  return size >= density * range && size <= range;
+}
+
+template <class T>
+bool set_has_duplicate(const T* keyp, size_t size) {
+  int dup = 0;
+  for(size_t i = 1; i < size; i++) dup |= (keyp[i-1] == keyp[i]);
+  return dup;
+}
+
+// Use dense_bitset for integer inputs that are dense enough; returns
+// false if it is not used (or the inputs contain duplicated values).
+template <class T>
+bool set_intersection_dense(const T* leftp, size_t left_size,
+                            const T* rightp, size_t right_size,
+                            std::vector<T>& ret, std::false_type) {
+  return false;
+}
+
+template <class T>
+bool set_intersection_dense(const T* leftp, size_t left_size,
+                            const T* rightp, size_t right_size,
+                            std::vector<T>& ret, std::true_type) {
+  if(!set_is_dense(leftp, left_size, SET_DENSE_INTERSECTION_DENSITY) ||
+     !set_is_dense(rightp, right_size, SET_DENSE_INTERSECTION_DENSITY))
+    return false;
+  // only the overlapping range is converted
+  auto lo = std::max(leftp[0], rightp[0]);
+  auto hi = std::min(leftp[left_size - 1], rightp[right_size - 1]);
+  if(hi < lo) {
+    ret.clear();
+    return true;
+  }
+  auto left_begin = std::lower_bound(leftp, leftp + left_size, lo);
+  auto left_end = std::upper_bound(left_begin, leftp + left_size, hi);
+  auto right_begin = std::lower_bound(rightp, rightp + right_size, lo);
+  auto right_end = std::upper_bound(right_begin, rightp + right_size, hi);
+  size_t left_range_size = left_end - left_begin;
+  size_t right_range_size = right_end - right_begin;
+  if(set_has_duplicate(left_begin, left_range_size) ||
+     set_has_duplicate(right_begin, right_range_size)) return false;
+  dense_bitset<T> left_set(left_begin, left_range_size);
+  dense_bitset<T> right_set(right_begin, right_range_size);
+  ret = set_intersection(left_set, right_set).to_vector();
+  return true;
+}
+
+#if defined(_SX) || defined(__ve__)
+template <class T>
+bool set_union_dense(const T* leftp, size_t left_size,
+                     const T* rightp, size_t right_size,
+                     std::vector<T>& ret, std::false_type) {
+  return false;
+}
+
+// the bitset of the union spans both inputs, so the combined range
+// should also be dense
+template <class T>
+bool set_union_dense(const T* leftp, size_t left_size,
+                     const T* rightp, size_t right_size,
+                     std::vector<T>& ret, std::true_type) {
+  if(!set_is_dense(leftp, left_size, SET_DENSE_UNION_DENSITY) ||
+     !set_is_dense(rightp, right_size, SET_DENSE_UNION_DENSITY))
+    return false;
+  double range =
+    static_cast<double>(std::max(leftp[left_size-1], rightp[right_size-1])) -
+    static_cast<double>(std::min(leftp[0], rightp[0])) + 1;
+  if(left_size + right_size < SET_DENSE_UNION_DENSITY * range) return false;
+  if(set_has_duplicate(leftp, left_size) ||
+     set_has_duplicate(rightp, right_size)) return false;
+  dense_bitset<T> left_set(leftp, left_size);
+  dense_bitset<T> right_set(rightp, right_size);
+  ret = set_union(left_set, right_set).to_vector();
+  return true;
+}
+#endif
+
+// Write the result to outp and return its size. If capacity is smaller
+// than *_max_size, a work buffer is used and the result is copied;
+// an exception is thrown if it does not fit.
+template <class T>
+size_t set_intersection_into(const T* leftp, size_t left_size,
+                             const T* rightp, size_t right_size,
+                             T* outp, size_t capacity) {
+  auto max_size = set_intersection_max_size(left_size, right_size);
+  if(capacity >= max_size)
+    return set_intersection_impl(leftp, left_size, rightp, right_size, outp);
+  std::vector<T> work(max_size);
+  auto size = set_intersection_impl(leftp, left_size, rightp, right_size,
+                                    work.data());
+  return set_copy_into(work.data(), size, outp, capacity,
+                       "set_intersection_into");
+}
+
+template <class T>
+std::vector<T> set_intersection(const T* leftp, size_t left_size,
+                                const T* rightp, size_t right_size) {
+  std::vector<T> ret;
+  if(set_intersection_dense(leftp, left_size, rightp, right_size, ret,
+                            std::is_integral<T>())) return ret;
+  ret.resize(set_intersection_max_size(left_size, right_size));
+  auto size = set_intersection_impl(leftp, left_size, rightp, right_size,
+                                    ret.data());
+  ret.resize(size);
+  return ret;
+}
+
+template <class T>
+size_t set_union_into(const T* leftp, size_t left_size,
+                      const T* rightp, size_t right_size,
+                      T* outp, size_t capacity) {
+  auto max_size = set_union_max_size(left_size, right_size);
+  if(capacity >= max_size)
+    return set_union_impl(leftp, left_size, rightp, right_size, outp);
+  std::vector<T> work(max_size);
+  auto size = set_union_impl(leftp, left_size, rightp, right_size, work.data());
+  return set_copy_into(work.data(), size, outp, capacity, "set_union_into");
+}
+
+template <class T>
+std::vector<T> set_union(const T* leftp, size_t left_size,
+                         const T* rightp, size_t right_size) {
+  std::vector<T> ret;
+#if defined(_SX) || defined(__ve__)
+  if(set_union_dense(leftp, left_size, rightp, right_size, ret,
+                     std::is_integral<T>())) return ret;
+#endif
+  ret.resize(set_union_max_size(left_size, right_size));
+  auto size = set_union_impl(leftp, left_size, rightp, right_size, ret.data());
+  ret.resize(size);
+  return ret;
+}
+
+template <class T>
+size_t set_difference_into(const T* leftp, size_t left_size,
+                           const T* rightp, size_t right_size,
+                           T* outp, size_t capacity) {
+  auto max_size = set_difference_max_size(left_size, right_size);
+  if(capacity >= max_size)
+    return set_difference_impl(leftp, left_size, rightp, right_size, outp);
+  std::vector<T> work(max_size);
+  auto size = set_difference_impl(leftp, left_size, rightp, right_size,
+                                  work.data());
+  return set_copy_into(work.data(), size, outp, capacity,
+                       "set_difference_into");
+}
+
+template <class T>
+std::vector<T> set_difference(const T* leftp, size_t left_size,
+                              const T* rightp, size_t right_size) {
+  std::vector<T> ret(set_difference_max_size(left_size, right_size));
+  auto size = set_difference_impl(leftp, left_size, rightp, right_size,
+                                  ret.data());
+  ret.resize(size);
+  return ret;
+}
+
+template <class T>
+size_t set_intersection_desc_into(const T* leftp, size_t left_size,
+                                  const T* rightp, size_t right_size,
+                                  T* outp, size_t capacity) {
+  auto max_size = set_intersection_max_size(left_size, right_size);
+  if(capacity >= max_size)
+    return set_intersection_desc_impl(leftp, left_size, rightp, right_size,
+                                      outp);
+  std::vector<T> work(max_size);
+  auto size = set_intersection_desc_impl(leftp, left_size, rightp, right_size,
+                                         work.data());
+  return set_copy_into(work.data(), size, outp, capacity,
+                       "set_intersection_desc_into");
+}
+
+template <class T>
+std::vector<T> set_intersection_desc(const T* leftp, size_t left_size,
+                                     const T* rightp, size_t right_size) {
+  std::vector<T> ret(set_intersection_max_size(left_size, right_size));
+  auto size = set_intersection_desc_impl(leftp, left_size, rightp, right_size,
+                                         ret.data());
+  ret.resize(size);
+  return ret;
+}
+
+template <class T>
+size_t set_union_desc_into(const T* leftp, size_t left_size,
+                           const T* rightp, size_t right_size,
+                           T* outp, size_t capacity) {
+  auto max_size = set_union_max_size(left_size, right_size);
+  if(capacity >= max_size)
+    return set_union_desc_impl(leftp, left_size, rightp, right_size, outp);
+  std::vector<T> work(max_size);
+  auto size = set_union_desc_impl(leftp, left_size, rightp, right_size,
+                                  work.data());
+  return set_copy_into(work.data(), size, outp, capacity,
+                       "set_union_desc_into");
+}
+
+template <class T>
+std::vector<T> set_union_desc(const T* leftp, size_t left_size,
+                              const T* rightp, size_t right_size) {
+  std::vector<T> ret(set_union_max_size(left_size, right_size));
+  auto size = set_union_desc_impl(leftp, left_size, rightp, right_size,
+                                  ret.data());
+  ret.resize(size);
+  return ret;
+}
+
+template <class T>
+size_t set_difference_desc_into(const T* leftp, size_t left_size,
+                                const T* rightp, size_t right_size,
+                                T* outp, size_t capacity) {
+  auto max_size = set_difference_max_size(left_size, right_size);
+  if(capacity >= max_size)
+    return set_difference_desc_impl(leftp, left_size, rightp, right_size, outp);
+  std::vector<T> work(max_size);
+  auto size = set_difference_desc_impl(leftp, left_size, rightp, right_size,
+                                       work.data());
+  return set_copy_into(work.data(), size, outp, capacity,
+                       "set_difference_desc_into");
+}
+
+template <class T>
+std::vector<T> set_difference_desc(const T* leftp, size_t left_size,
+                                   const T* rightp, size_t right_size) {
+  std::vector<T> ret(set_difference_max_size(left_size, right_size));
+  auto size = set_difference_desc_impl(leftp, left_size, rightp, right_size,
+                                       ret.data());
+  ret.resize(size);
+  return ret;
+}
+
+template <class T>
+size_t set_symmetric_difference_into(const T* leftp, size_t left_size,
+                                     const T* rightp, size_t right_size,
+                                     T* outp, size_t capacity) {
+  auto max_size = set_symmetric_difference_max_size(left_size, right_size);
+  if(capacity >= max_size)
+    return set_symmetric_difference_impl(leftp, left_size,
+                                         rightp, right_size, outp);
+  std::vector<T> work(max_size);
+  auto size = set_symmetric_difference_impl(leftp, left_size,
+                                            rightp, right_size, work.data());
+  return set_copy_into(work.data(), size, outp, capacity,
+                       "set_symmetric_difference_into");
+}
+
+// same as std::set_symmetric_difference
+template <class T>
+std::vector<T> set_symmetric_difference(const T* leftp, size_t left_size,
+                                        const T* rightp, size_t right_size) {
+  std::vector<T> ret(set_symmetric_difference_max_size(left_size,
+                                                       right_size));
+  auto size = set_symmetric_difference_impl(leftp, left_size,
+                                            rightp, right_size, ret.data());
+  ret.resize(size);
+  return ret;
+}
+
+template <class T>
+size_t set_merge_into(const T* leftp, size_t left_size,
+                      const T* rightp, size_t right_size,
+                      T* outp, size_t capacity) {
+  auto max_size = set_merge_max_size(left_size, right_size);
+  if(capacity >= max_size)
+    return set_merge_impl(leftp, left_size, rightp, right_size, outp);
+  std::vector<T> work(max_size);
+  auto size = set_merge_impl(leftp, left_size, rightp, right_size, work.data());
+  return set_copy_into(work.data(), size, outp, capacity, "set_merge_into");
+}
+
+template <class T>
+std::vector<T> set_merge(const T* leftp, size_t left_size,
+                         const T* rightp, size_t right_size) {
+  std::vector<T> ret(set_merge_max_size(left_size, right_size));
+  auto size = set_merge_impl(leftp, left_size, rightp, right_size, ret.data());
+  ret.resize(size);
+  return ret;
+}
+
+template <class T>
+size_t set_merge_desc_into(const T* leftp, size_t left_size,
+                           const T* rightp, size_t right_size,
+                           T* outp, size_t capacity) {
+  auto max_size = set_merge_desc_max_size(left_size, right_size);
+  if(capacity >= max_size)
+    return set_merge_desc_impl(leftp, left_size, rightp, right_size, outp);
+  std::vector<T> work(max_size);
+  auto size = set_merge_desc_impl(leftp, left_size, rightp, right_size,
+                                  work.data());
+  return set_copy_into(work.data(), size, outp, capacity,
+                       "set_merge_desc_into");
+}
 
-    size_t total = 0;
-    for(size_t i = 0; i < SET_VLEN_EACH+1; i++) {
-      total += out_idx[i] - each * i;
-    }
-    std::vector<T> ret(total+1);
-    auto* retp = ret.data();
-    retp[0] = keyp[0];
-    size_t current = 0;
-    for(size_t i = 0; i < SET_VLEN_EACH+1; i++) {
-      auto crnt_size = out_idx[i] - each * i;
-      for(size_t j = 0; j < crnt_size; j++) {
-        retp[current + j + 1] = out[each * i + j];
-      }
-      current += crnt_size;
-    }
-    return ret;
-  }
+template <class T>
+std::vector<T> set_merge_desc(const T* leftp, size_t left_size,
+                              const T* rightp, size_t right_size) {
+  std::vector<T> ret(set_merge_desc_max_size(left_size, right_size));
+  auto size = set_merge_desc_impl(leftp, left_size, rightp, right_size,
+                                  ret.data());
+  ret.resize(size);
+  return ret;
 }
 
 template <class T>
-int set_is_unique_vreg(const T* keyp, size_t size, size_t each, size_t rest,
-                       T* current_key) {
-  size_t current_key_vreg[SET_VLEN_EACH];
-#pragma _NEC vreg(current_key_vreg)
-  for(size_t i = 0; i < SET_VLEN_EACH; i++){
-    current_key_vreg[i] = current_key[i];
-  }
+size_t set_unique_into(const T* keyp, size_t size,
+                       T* outp, size_t capacity) {
+  auto max_size = set_unique_max_size(size);
+  if(capacity >= max_size) return set_unique_impl(keyp, size, outp);
+  std::vector<T> work(max_size);
+  auto ret_size = set_unique_impl(keyp, size, work.data());
+  return set_copy_into(work.data(), ret_size, outp, capacity,
+                       "set_unique_into");
+}
 
-  for(size_t j = 0; j < each; j++) {
-#pragma _NEC ivdep
-#pragma _NEC vovertake
-    for(size_t i = 0; i < SET_VLEN_EACH; i++) {
-      auto loaded_key = keyp[i * each + j];
-      if(loaded_key == current_key_vreg[i]) {
-        return false;
-      } else {
-        current_key_vreg[i] = loaded_key;
-      }
-    }
-  }
-  auto offset = SET_VLEN_EACH * each;
-  auto current_key_rest = current_key[SET_VLEN_EACH];
-#pragma _NEC ivdep
-  for(size_t i = 0; i < rest; i++) {
-    auto loaded_key = keyp[offset + i];
-    if(loaded_key == current_key_rest) {
-      return false;
-    } else {
-      current_key_rest = loaded_key;
-    }
+// keys of the runs, their sizes and their start positions in one pass
+template <class T>
+void run_length_encode(const T* keyp, size_t size,
+                       std::vector<T>& unique_keys,
+                       std::vector<size_t>& counts,
+                       std::vector<size_t>& offsets) {
+  unique_keys.resize(size);
+  offsets.resize(size);
+  auto num_runs = run_length_encode_impl(keyp, size, unique_keys.data(),
+                                         offsets.data());
+  unique_keys.resize(num_runs);
+  offsets.resize(num_runs);
+  counts.resize(num_runs);
+  if(num_runs == 0) return;
+  auto offsetsp = offsets.data();
+  auto countsp = counts.data();
+  for(size_t i = 0; i < num_runs - 1; i++) {
+    countsp[i] = offsetsp[i+1] - offsetsp[i];
   }
-  return true;
+  countsp[num_runs - 1] = size - offsetsp[num_runs - 1];
 }
 
 template <class T>
-int set_is_unique(const T* keyp, size_t size) {
-  if(size == 0) {return true;} 
-  size_t size2 = size - 1;
-  size_t each = size2 / SET_VLEN_EACH;
-  if(each % 2 == 0 && each > 0) each--;
-  size_t rest = size2 - each * SET_VLEN_EACH;
-  std::vector<T> out(size);
-  auto outp = out.data();
-  if(each == 0) {
-    auto current = keyp[0];
-    outp[0] = current;
-    for(size_t i = 1; i < size; i++) {
-      auto loaded = keyp[i];
-      if(loaded == current) {
-        return false;
-      } else {
-        current = loaded;
-      }
-    }
-    return true;
-  } else {
-    T current_key[SET_VLEN_EACH+1];
-    current_key[0] = keyp[0]; // size > 0
-    for(int i = 1; i < SET_VLEN_EACH+1; i++) {
-      current_key[i] = keyp[each * i - 1]; // each > 0
-    }
-    return set_is_unique_vreg(keyp+1, size2, each, rest, current_key);
-  }
+std::vector<T> run_length_decode(const T* unique_keyp, const size_t* countp,
+                                 size_t num_runs) {
+  size_t total = 0;
+  for(size_t i = 0; i < num_runs; i++) total += countp[i];
+  std::vector<T> ret(total);
+  run_length_decode_impl(unique_keyp, countp, num_runs, ret.data());
+  return ret;
 }
 
-#endif // _SX
+template <class T>
+std::vector<T> set_unique(const T* keyp, size_t size) {
+  std::vector<T> ret(set_unique_max_size(size));
+  auto ret_size = set_unique_impl(keyp, size, ret.data());
+  ret.resize(ret_size);
+  return ret;
+}
+
+// same as set_unique(keyp, size).size(), without writing the output
+template <class T>
+size_t set_count_unique(const T* keyp, size_t size) {
+  if(size == 0) return 0;
+  size_t count = 1;
+  for(size_t i = 1; i < size; i++) {
+    count += (keyp[i] != keyp[i-1]);
+  }
+  return count;
+}
 
 template <class T>
 std::vector<T> set_intersection(const std::vector<T>& left,
@@ -1730,6 +3767,41 @@ std::vector<T> set_difference(const std::vector<T>& left,
                         right.data(), right.size());
 }
 
+template <class T>
+std::vector<T> set_intersection_desc(const std::vector<T>& left,
+                                     const std::vector<T>& right) {
+  return set_intersection_desc(left.data(), left.size(),
+                               right.data(), right.size());
+}
+
+template <class T>
+std::vector<T> set_union_desc(const std::vector<T>& left,
+                              const std::vector<T>& right) {
+  return set_union_desc(left.data(), left.size(),
+                        right.data(), right.size());
+}
+
+template <class T>
+std::vector<T> set_difference_desc(const std::vector<T>& left,
+                                   const std::vector<T>& right) {
+  return set_difference_desc(left.data(), left.size(),
+                             right.data(), right.size());
+}
+
+template <class T>
+std::vector<T> set_symmetric_difference(const std::vector<T>& left,
+                                        const std::vector<T>& right) {
+  return set_symmetric_difference(left.data(), left.size(),
+                                  right.data(), right.size());
+}
+
+template <class T>
+size_t set_count_intersection(const std::vector<T>& left,
+                              const std::vector<T>& right) {
+  return set_count_intersection(left.data(), left.size(),
+                                right.data(), right.size());
+}
+
 template <class T>
 std::vector<T> set_merge(const std::vector<T>& left,
                          const std::vector<T>& right) {
@@ -1768,55 +3840,617 @@ void set_merge_pair_desc(const std::vector<T>& left,
                       out, out_val);
 }
 
+template <class T, class K>
+void set_intersection_pair(const std::vector<T>& left,
+                           const std::vector<K>& left_val,
+                           const std::vector<T>& right,
+                           std::vector<T>& out,
+                           std::vector<K>& out_val) {
+  set_intersection_pair(left.data(), left_val.data(), left.size(),
+                        right.data(), right.size(), out, out_val);
+}
+
+template <class T>
+void set_intersection_index(const std::vector<T>& left,
+                            const std::vector<T>& right,
+                            std::vector<size_t>& left_pos,
+                            std::vector<size_t>& right_pos) {
+  set_intersection_index(left.data(), left.size(),
+                         right.data(), right.size(), left_pos, right_pos);
+}
+
+template <class T, class K>
+void set_union_pair(const std::vector<T>& left,
+                    const std::vector<K>& left_val,
+                    const std::vector<T>& right,
+                    const std::vector<K>& right_val,
+                    std::vector<T>& out,
+                    std::vector<K>& out_val) {
+  set_union_pair(left.data(), left_val.data(), left.size(),
+                 right.data(), right_val.data(), right.size(),
+                 out, out_val);
+}
+
+template <class T, class K>
+void set_difference_pair(const std::vector<T>& left,
+                         const std::vector<K>& left_val,
+                         const std::vector<T>& right,
+                         std::vector<T>& out,
+                         std::vector<K>& out_val) {
+  set_difference_pair(left.data(), left_val.data(), left.size(),
+                      right.data(), right.size(), out, out_val);
+}
+
+template <class T, class K>
+void set_symmetric_difference_pair(const std::vector<T>& left,
+                                   const std::vector<K>& left_val,
+                                   const std::vector<T>& right,
+                                   const std::vector<K>& right_val,
+                                   std::vector<T>& out,
+                                   std::vector<K>& out_val) {
+  set_symmetric_difference_pair(left.data(), left_val.data(), left.size(),
+                                right.data(), right_val.data(), right.size(),
+                                out, out_val);
+}
+
 template <class T>
 std::vector<size_t> set_separate(const std::vector<T>& key) {
   return set_separate(key.data(), key.size());
 }
 
+template <class T>
+void run_length_encode(const std::vector<T>& key,
+                       std::vector<T>& unique_keys,
+                       std::vector<size_t>& counts,
+                       std::vector<size_t>& offsets) {
+  run_length_encode(key.data(), key.size(), unique_keys, counts, offsets);
+}
+
+template <class T>
+std::vector<T> run_length_decode(const std::vector<T>& unique_keys,
+                                 const std::vector<size_t>& counts) {
+  if(unique_keys.size() != counts.size())
+    throw std::runtime_error("run_length_decode: size mismatch");
+  return run_length_decode(unique_keys.data(), counts.data(), counts.size());
+}
+
 template <class T>
 std::vector<T> set_unique(const std::vector<T>& key) {
   return set_unique(key.data(), key.size());
 }
 
+template <class T>
+size_t set_count_unique(const std::vector<T>& key) {
+  return set_count_unique(key.data(), key.size());
+}
+
 template <class T>
 int set_is_unique(const std::vector<T>& key) {
   return set_is_unique(key.data(), key.size());
 }
 
+#define SET_INTERSECTION_MULTI_BATCH 4096
+#define SET_INTERSECTION_MULTI_MERGE_RATIO 16
+
+// Intersection of many sorted lists; the smallest list gives the
+// candidates, which are probed against the other lists in increasing
+// size with lower_bound and compacted in place.
+// Each batch of candidates only searches the part of the list between
+// the previous batch and the upper bound of its last candidate.
+// On x86, lists of similar size are merged in place instead.
+template <class T>
+std::vector<T> set_intersection_multi(const T* const* listp,
+                                      const size_t* sizes,
+                                      size_t num_lists) {
+  if(num_lists == 0) return std::vector<T>();
+  std::vector<size_t> order(num_lists);
+  for(size_t i = 0; i < num_lists; i++) order[i] = i;
+  std::sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) {return sizes[a] < sizes[b];});
+  auto smallest = order[0];
+  std::vector<T> ret(listp[smallest], listp[smallest] + sizes[smallest]);
+  auto retp = ret.data();
+  size_t ret_size = ret.size();
+  // duplicated candidates need to be matched one by one
+  int is_unique = set_is_unique(retp, ret_size);
+  std::vector<size_t> pos(std::min(ret_size,
+                                   size_t(SET_INTERSECTION_MULTI_BATCH)));
+  auto posp = pos.data();
+  for(size_t l = 1; l < num_lists && ret_size > 0; l++) {
+    auto crnt_listp = listp[order[l]];
+    size_t crnt_size = sizes[order[l]];
+    size_t start = std::lower_bound(crnt_listp, crnt_listp + crnt_size,
+                                    retp[0]) - crnt_listp;
+#if !(defined(_SX) || defined(__ve__))
+    // if the sizes are close, merging is faster than searching
+    size_t end = std::upper_bound(crnt_listp + start, crnt_listp + crnt_size,
+                                  retp[ret_size - 1]) - crnt_listp;
+    if(end - start < ret_size * SET_INTERSECTION_MULTI_MERGE_RATIO) {
+      ret_size = set_intersection_branchless(retp, ret_size,
+                                             crnt_listp + start, end - start,
+                                             retp, std::less<T>());
+      continue;
+    }
+#endif
+    size_t out_idx = 0, dup_rank = 0;
+    T prev = T();
+    for(size_t b = 0; b < ret_size; b += SET_INTERSECTION_MULTI_BATCH) {
+      size_t batch_size =
+        std::min(ret_size - b, size_t(SET_INTERSECTION_MULTI_BATCH));
+      auto batchp = retp + b;
+      size_t end = std::upper_bound(crnt_listp + start,
+                                    crnt_listp + crnt_size,
+                                    batchp[batch_size - 1]) - crnt_listp;
+      lower_bound(crnt_listp + start, end - start,
+                  batchp, batch_size, posp);
+      auto searchp = crnt_listp + start;
+      size_t search_size = end - start;
+      if(is_unique) {
+        for(size_t i = 0; i < batch_size; i++) {
+          auto p = posp[i];
+          auto v = batchp[i];
+          if(p < search_size && searchp[p] == v) retp[out_idx++] = v;
+        }
+      } else {
+        for(size_t i = 0; i < batch_size; i++) {
+          auto v = batchp[i];
+          if(b + i > 0 && v == prev) dup_rank++;
+          else dup_rank = 0;
+          prev = v;
+          auto p = posp[i] + dup_rank;
+          if(p < search_size && searchp[p] == v) retp[out_idx++] = v;
+        }
+      }
+      start += posp[batch_size - 1];
+    }
+    ret_size = out_idx;
+  }
+  ret.resize(ret_size);
+  return ret;
+}
+
+template <class T>
+std::vector<T>
+set_intersection_multi(const std::vector<std::vector<T>>& lists) {
+  size_t num_lists = lists.size();
+  std::vector<const T*> listp(num_lists);
+  std::vector<size_t> sizes(num_lists);
+  for(size_t i = 0; i < num_lists; i++) {
+    listp[i] = lists[i].data();
+    sizes[i] = lists[i].size();
+  }
+  return set_intersection_multi(listp.data(), sizes.data(), num_lists);
+}
+
+// Find the positions in each run that split the k-way merge result
+// at rank; ties are ordered by run index, which keeps the merge stable.
+// The longest remaining window is bisected and its pivot is ranked
+// against all runs, so every iteration shrinks at least one window.
+template <class T, class C>
+void set_multimerge_split(const T* const* keyp, const size_t* sizes,
+                          size_t way, size_t rank, size_t* pos, C comp) {
+  std::vector<size_t> lo(way), hi(way), cnt(way);
+  for(size_t i = 0; i < way; i++) {
+    lo[i] = 0;
+    hi[i] = sizes[i];
+  }
+  while(true) {
+    size_t j = way, max_width = 0;
+    for(size_t i = 0; i < way; i++) {
+      if(hi[i] - lo[i] > max_width) {
+        max_width = hi[i] - lo[i];
+        j = i;
+      }
+    }
+    if(j == way) break;
+    size_t mid = lo[j] + max_width / 2;
+    auto pivot = keyp[j][mid];
+    size_t pivot_rank = 0;
+    for(size_t i = 0; i < way; i++) {
+      if(i < j)
+        cnt[i] = std::upper_bound(keyp[i], keyp[i] + sizes[i], pivot, comp)
+          - keyp[i];
+      else if(i > j)
+        cnt[i] = std::lower_bound(keyp[i], keyp[i] + sizes[i], pivot, comp)
+          - keyp[i];
+      else cnt[i] = mid;
+      pivot_rank += cnt[i];
+    }
+    if(pivot_rank < rank) {
+      for(size_t i = 0; i < way; i++) lo[i] = std::max(lo[i], cnt[i]);
+      lo[j] = mid + 1;
+    } else {
+      for(size_t i = 0; i < way; i++) hi[i] = std::min(hi[i], cnt[i]);
+    }
+  }
+  for(size_t i = 0; i < way; i++) pos[i] = lo[i];
+}
+
+#if defined(_SX) || defined(__ve__)
+
+#define MULTIMERGE_VLEN 256
+// minimum output per lane (multiplied by way) to make splitting worthwhile
+#define MULTIMERGE_MIN_EACH 16
+
+// true if the head of run a comes before the head of run b in lane l
+template <class T, class C>
+inline bool set_multimerge_less(const T* const* keyp,
+                                const size_t* cur, const size_t* stop,
+                                size_t lanes, size_t l,
+                                size_t a, size_t b, C comp) {
+  size_t ca = cur[a * lanes + l], cb = cur[b * lanes + l];
+  if(ca == stop[a * lanes + l]) return false;
+  if(cb == stop[b * lanes + l]) return true;
+  auto ka = keyp[a][ca];
+  auto kb = keyp[b][cb];
+  return comp(ka, kb) || (!comp(kb, ka) && a < b);
+}
+
+// k-way merge with a loser tree: each element costs log2(way)
+// comparisons and the output is written once. The output is split
+// into MULTIMERGE_VLEN slices, each merged by its own tree,
+// and the tree replay is vectorized over the slices.
+// valp and ovp can be NULL if there are no values.
+template <class T, class K, class C>
+void set_multimerge_impl(const T* const* keyp, const K* const* valp,
+                         const size_t* sizes, size_t way,
+                         T* op, K* ovp, C comp) {
+  size_t total = 0;
+  for(size_t i = 0; i < way; i++) total += sizes[i];
+  if(total == 0) return;
+  size_t lanes = std::min(size_t(MULTIMERGE_VLEN),
+                          total / (way * MULTIMERGE_MIN_EACH) + 1);
+  size_t leaf_size = 1, depth = 0;
+  while(leaf_size < way) {leaf_size *= 2; depth++;}
+
+  // [run][lane]; padding runs have cur == stop, so they never win
+  std::vector<size_t> cur(leaf_size * lanes), stop(leaf_size * lanes);
+  std::vector<size_t> out_idx(lanes), out_idx_stop(lanes);
+  std::vector<size_t> pos(way);
+  for(size_t i = 0; i < way; i++) stop[i * lanes + lanes - 1] = sizes[i];
+  for(size_t l = 1; l < lanes; l++) {
+    size_t rank = total / lanes * l;
+    set_multimerge_split(keyp, sizes, way, rank, pos.data(), comp);
+    for(size_t i = 0; i < way; i++) {
+      cur[i * lanes + l] = pos[i];
+      stop[i * lanes + l - 1] = pos[i];
+    }
+    out_idx[l] = rank;
+    out_idx_stop[l - 1] = rank;
+  }
+  out_idx_stop[lanes - 1] = total;
+  auto curp = cur.data();
+  auto stopp = stop.data();
+  auto out_idxp = out_idx.data();
+  auto out_idx_stopp = out_idx_stop.data();
+
+  // tree[0] is the winner, tree[1 .. leaf_size-1] are the losers
+  std::vector<size_t> tree(leaf_size * lanes), win(2 * leaf_size * lanes);
+  auto treep = tree.data();
+  auto winp = win.data();
+  for(size_t r = 0; r < leaf_size; r++) {
+    for(size_t l = 0; l < lanes; l++) {
+      winp[(leaf_size + r) * lanes + l] = r;
+    }
+  }
+  for(size_t n = leaf_size - 1; n > 0; n--) {
+#pragma _NEC ivdep
+    for(size_t l = 0; l < lanes; l++) {
+      auto a = winp[2 * n * lanes + l];
+      auto b = winp[(2 * n + 1) * lanes + l];
+      if(set_multimerge_less(keyp, curp, stopp, lanes, l, b, a, comp)) {
+        winp[n * lanes + l] = b;
+        treep[n * lanes + l] = a;
+      } else {
+        winp[n * lanes + l] = a;
+        treep[n * lanes + l] = b;
+      }
+    }
+  }
+  for(size_t l = 0; l < lanes; l++) treep[l] = winp[lanes + l];
+
+  size_t max_size = 0;
+  for(size_t l = 0; l < lanes; l++) {
+    max_size = std::max(max_size, out_idx_stopp[l] - out_idxp[l]);
+  }
+  std::vector<size_t> winner(lanes), node(lanes);
+  std::vector<int> active(lanes);
+  auto winnerp = winner.data();
+  auto nodep = node.data();
+  auto activep = active.data();
+  for(size_t i = 0; i < max_size; i++) {
+#pragma _NEC ivdep
+    for(size_t l = 0; l < lanes; l++) {
+      activep[l] = out_idxp[l] < out_idx_stopp[l];
+      if(activep[l]) {
+        auto w = treep[l];
+        auto c = curp[w * lanes + l];
+        op[out_idxp[l]] = keyp[w][c];
+        if(ovp) ovp[out_idxp[l]] = valp[w][c];
+        out_idxp[l]++;
+        curp[w * lanes + l] = c + 1;
+        winnerp[l] = w;
+        nodep[l] = (w + leaf_size) / 2;
+      }
+    }
+    for(size_t d = 0; d < depth; d++) {
+#pragma _NEC ivdep
+      for(size_t l = 0; l < lanes; l++) {
+        if(activep[l]) {
+          auto n = nodep[l];
+          auto challenger = treep[n * lanes + l];
+          if(set_multimerge_less(keyp, curp, stopp, lanes, l,
+                                 challenger, winnerp[l], comp)) {
+            treep[n * lanes + l] = winnerp[l];
+            winnerp[l] = challenger;
+          }
+          nodep[l] = n / 2;
+        }
+      }
+    }
+    for(size_t l = 0; l < lanes; l++) {
+      if(activep[l]) treep[l] = winnerp[l];
+    }
+  }
+}
+
+#else
+
+#ifndef MULTIMERGE_SLICE_SIZE
+#define MULTIMERGE_SLICE_SIZE (1 << 20) // output merged in cache at a time
+#endif
+#define MULTIMERGE_WAY 4 // runs merged at once
+
+// Branchless merge of up to MULTIMERGE_WAY runs; ties are taken from
+// the run with the smaller index. The heads of the runs are compared
+// as a tournament: (0, 1), (2, 3) and then the two winners. When a run
+// is exhausted, it is removed and the rest is merged with fewer runs.
+template <bool WITH_VAL, class T, class K, class C>
+size_t set_multimerge_small(const T* const* keyp, const K* const* valp,
+                            const size_t* sizes, size_t way,
+                            T* op, K* ovp, C comp) {
+  const T* kp[MULTIMERGE_WAY];
+  const K* vp[MULTIMERGE_WAY];
+  size_t idx[MULTIMERGE_WAY], size[MULTIMERGE_WAY];
+  size_t num = 0;
+  for(size_t i = 0; i < way; i++) {
+    if(sizes[i] == 0) continue;
+    kp[num] = keyp[i];
+    if(WITH_VAL) vp[num] = valp[i];
+    idx[num] = 0;
+    size[num++] = sizes[i];
+  }
+  size_t out_idx = 0;
+  while(num > 1) {
+    if(num == 4) {
+      while(idx[0] < size[0] && idx[1] < size[1] &&
+            idx[2] < size[2] && idx[3] < size[3]) {
+        auto e0 = kp[0][idx[0]], e1 = kp[1][idx[1]];
+        auto e2 = kp[2][idx[2]], e3 = kp[3][idx[3]];
+        int lt1 = comp(e1, e0);
+        int lt3 = comp(e3, e2);
+        auto e01 = lt1 ? e1 : e0;
+        auto e23 = lt3 ? e3 : e2;
+        int lt23 = comp(e23, e01);
+        op[out_idx] = lt23 ? e23 : e01;
+        if(WITH_VAL) {
+          auto v01 = lt1 ? vp[1][idx[1]] : vp[0][idx[0]];
+          auto v23 = lt3 ? vp[3][idx[3]] : vp[2][idx[2]];
+          ovp[out_idx] = lt23 ? v23 : v01;
+        }
+        out_idx++;
+        idx[0] += !lt23 & !lt1;
+        idx[1] += !lt23 & lt1;
+        idx[2] += lt23 & !lt3;
+        idx[3] += lt23 & lt3;
+      }
+    } else if(num == 3) {
+      while(idx[0] < size[0] && idx[1] < size[1] && idx[2] < size[2]) {
+        auto e0 = kp[0][idx[0]], e1 = kp[1][idx[1]], e2 = kp[2][idx[2]];
+        int lt1 = comp(e1, e0);
+        auto e01 = lt1 ? e1 : e0;
+        int lt2 = comp(e2, e01);
+        op[out_idx] = lt2 ? e2 : e01;
+        if(WITH_VAL) {
+          auto v01 = lt1 ? vp[1][idx[1]] : vp[0][idx[0]];
+          ovp[out_idx] = lt2 ? vp[2][idx[2]] : v01;
+        }
+        out_idx++;
+        idx[0] += !lt2 & !lt1;
+        idx[1] += !lt2 & lt1;
+        idx[2] += lt2;
+      }
+    } else {
+      while(idx[0] < size[0] && idx[1] < size[1]) {
+        auto e0 = kp[0][idx[0]], e1 = kp[1][idx[1]];
+        int lt1 = comp(e1, e0);
+        op[out_idx] = lt1 ? e1 : e0;
+        if(WITH_VAL) ovp[out_idx] = lt1 ? vp[1][idx[1]] : vp[0][idx[0]];
+        out_idx++;
+        idx[0] += !lt1;
+        idx[1] += lt1;
+      }
+    }
+    size_t next_num = 0;
+    for(size_t i = 0; i < num; i++) {
+      if(idx[i] == size[i]) continue;
+      kp[next_num] = kp[i];
+      if(WITH_VAL) vp[next_num] = vp[i];
+      idx[next_num] = idx[i];
+      size[next_num++] = size[i];
+    }
+    num = next_num;
+  }
+  if(num == 1) {
+    auto crnt_kp = kp[0];
+    for(size_t j = idx[0]; j < size[0]; j++) op[out_idx++] = crnt_kp[j];
+    if(WITH_VAL) {
+      auto crnt_vp = vp[0];
+      auto crnt_ovp = ovp + out_idx - (size[0] - idx[0]);
+      for(size_t j = idx[0]; j < size[0]; j++)
+        *crnt_ovp++ = crnt_vp[j];
+    }
+  }
+  return out_idx;
+}
+
+// Merge of the runs within a slice of the output: rounds of
+// set_multimerge_small go back and forth between op and work, and the
+// last round writes to op. The runs are grouped as evenly as possible,
+// so that no run is copied alone.
+template <bool WITH_VAL, class T, class K, class C>
+void set_multimerge_slice(const T** src, const K** srcv, size_t* src_size,
+                          size_t way, T* op, K* ovp, T* work, K* workv,
+                          C comp) {
+  size_t rounds = 0;
+  for(size_t w = way; w > 1; w = ceil_div(w, size_t(MULTIMERGE_WAY)))
+    rounds++;
+  if(rounds == 0) { // only one run
+    for(size_t j = 0; j < src_size[0]; j++) op[j] = src[0][j];
+    if(WITH_VAL) {
+      for(size_t j = 0; j < src_size[0]; j++) ovp[j] = srcv[0][j];
+    }
+    return;
+  }
+  T* dst = rounds % 2 ? op : work;
+  K* dstv = rounds % 2 ? ovp : workv;
+  T* other = rounds % 2 ? work : op;
+  K* otherv = rounds % 2 ? workv : ovp;
+  while(way > 1) {
+    size_t groups = ceil_div(way, size_t(MULTIMERGE_WAY));
+    size_t out_idx = 0, i = 0;
+    for(size_t g = 0; g < groups; g++) {
+      size_t group_way = way / groups + (g < way % groups);
+      auto crnt_dstv = WITH_VAL ? dstv + out_idx : dstv;
+      auto size = set_multimerge_small<WITH_VAL>(src + i, srcv + i,
+                                                 src_size + i, group_way,
+                                                 dst + out_idx, crnt_dstv,
+                                                 comp);
+      src[g] = dst + out_idx;
+      if(WITH_VAL) srcv[g] = dstv + out_idx;
+      src_size[g] = size;
+      out_idx += size;
+      i += group_way;
+    }
+    way = groups;
+    std::swap(dst, other);
+    std::swap(dstv, otherv);
+  }
+}
+
+// On x86, a loser tree is dominated by branch misprediction, so the
+// runs are merged by the branchless MULTIMERGE_WAY-way kernel in rounds.
+// The output is split by set_multimerge_split into slices of at most
+// MULTIMERGE_SLICE_SIZE, so that the rounds run in cache with a work
+// buffer of the slice size; the input is read and the output is written
+// once. valp and ovp can be NULL if there are no values.
+template <class T, class K, class C>
+void set_multimerge_impl(const T* const* keyp, const K* const* valp,
+                         const size_t* sizes, size_t way,
+                         T* op, K* ovp, C comp) {
+  size_t total = 0;
+  for(size_t i = 0; i < way; i++) total += sizes[i];
+  if(total == 0) return;
+  size_t num_slices = ceil_div(total, size_t(MULTIMERGE_SLICE_SIZE));
+  size_t slice_size = ceil_div(total, num_slices);
+  std::vector<T> work(slice_size);
+  std::vector<K> work_val(ovp ? slice_size : 0);
+  std::vector<size_t> start(way), stop(way), src_size(way);
+  std::vector<const T*> src(way);
+  std::vector<const K*> srcv(way);
+  size_t rank = 0;
+  for(size_t l = 0; l < num_slices; l++) {
+    size_t next_rank = l + 1 == num_slices ? total : slice_size * (l + 1);
+    if(l + 1 == num_slices) {
+      for(size_t i = 0; i < way; i++) stop[i] = sizes[i];
+    } else {
+      set_multimerge_split(keyp, sizes, way, next_rank, stop.data(), comp);
+    }
+    size_t slice_way = 0;
+    for(size_t i = 0; i < way; i++) {
+      if(stop[i] == start[i]) continue;
+      src[slice_way] = keyp[i] + start[i];
+      if(ovp) srcv[slice_way] = valp[i] + start[i];
+      src_size[slice_way++] = stop[i] - start[i];
+    }
+    if(ovp) {
+      set_multimerge_slice<true>(src.data(), srcv.data(), src_size.data(),
+                                 slice_way, op + rank, ovp + rank,
+                                 work.data(), work_val.data(), comp);
+    } else {
+      set_multimerge_slice<false>(src.data(), srcv.data(), src_size.data(),
+                                  slice_way, op + rank, ovp,
+                                  work.data(), work_val.data(), comp);
+    }
+    for(size_t i = 0; i < way; i++) start[i] = stop[i];
+    rank = next_rank;
+  }
+}
+
+#endif
+
+template <class T, class K, class C>
+void set_multimerge_pair_helper(std::vector<std::vector<T>>& key,
+                                std::vector<std::vector<K>>& val,
+                                std::vector<T>& out_key,
+                                std::vector<K>& out_val,
+                                C comp) {
+  size_t way = key.size();
+  if(key.size() != val.size())
+    throw std::runtime_error("set_multimerge_pair: size mismatch");
+  std::vector<const T*> keyp(way);
+  std::vector<const K*> valp(way);
+  std::vector<size_t> sizes(way);
+  size_t total = 0;
+  for(size_t i = 0; i < way; i++) {
+    if(key[i].size() != val[i].size())
+      throw std::runtime_error("set_multimerge_pair: size mismatch");
+    keyp[i] = key[i].data();
+    valp[i] = val[i].data();
+    sizes[i] = key[i].size();
+    total += sizes[i];
+  }
+  out_key.resize(total);
+  out_val.resize(total);
+  set_multimerge_impl(keyp.data(), valp.data(), sizes.data(), way,
+                      out_key.data(), out_val.data(), comp);
+}
+
+template <class T, class C>
+void set_multimerge_helper(std::vector<std::vector<T>>& key,
+                           std::vector<T>& out,
+                           C comp) {
+  size_t way = key.size();
+  std::vector<const T*> keyp(way);
+  std::vector<size_t> sizes(way);
+  size_t total = 0;
+  for(size_t i = 0; i < way; i++) {
+    keyp[i] = key[i].data();
+    sizes[i] = key[i].size();
+    total += sizes[i];
+  }
+  out.resize(total);
+  set_multimerge_impl(keyp.data(), static_cast<const int* const*>(0),
+                      sizes.data(), way, out.data(), static_cast<int*>(0),
+                      comp);
+}
+
 template <class T, class K>
 void set_multimerge_pair(std::vector<std::vector<T>>& key,
                          std::vector<std::vector<K>>& val,
                          std::vector<T>& out_key,
                          std::vector<K>& out_val) {
   size_t part_size = key.size();
-  if(part_size == 1 || part_size == 0) {
+  if(part_size == 0) {
+    out_key.clear();
+    out_val.clear();
+  } else if(part_size == 1) {
     out_key.swap(key[0]);
     out_val.swap(val[0]);
   } else if(part_size == 2) {
     set_merge_pair(key[0], val[0], key[1], val[1], out_key, out_val);
   } else {
-    size_t next_part_size = ceil_div(part_size, size_t(2));
-    std::vector<std::vector<T>> key_left(next_part_size);
-    std::vector<std::vector<K>> val_left(next_part_size);
-    for(size_t i = 0; i < next_part_size; i++) {
-      key_left[i].swap(key[i]);
-      val_left[i].swap(val[i]);
-    }
-    std::vector<T> out_key_left;
-    std::vector<K> out_val_left;
-    set_multimerge_pair(key_left, val_left, out_key_left, out_val_left);
-    std::vector<std::vector<T>> key_right(part_size - next_part_size);
-    std::vector<std::vector<K>> val_right(part_size - next_part_size);
-    for(size_t i = 0; i < part_size - next_part_size; i++) {
-      key_right[i].swap(key[i+next_part_size]);
-      val_right[i].swap(val[i+next_part_size]);
-    }
-    std::vector<T> out_key_right;
-    std::vector<K> out_val_right;
-    set_multimerge_pair(key_right, val_right, out_key_right, out_val_right);
-    set_merge_pair(out_key_left, out_val_left, out_key_right, out_val_right,
-                   out_key, out_val);
-                   
+    set_multimerge_pair_helper(key, val, out_key, out_val, std::less<T>());
   }
 }
 
@@ -1826,52 +4460,29 @@ void set_multimerge_pair_desc(std::vector<std::vector<T>>& key,
                               std::vector<T>& out_key,
                               std::vector<K>& out_val) {
   size_t part_size = key.size();
-  if(part_size == 1 || part_size == 0) {
+  if(part_size == 0) {
+    out_key.clear();
+    out_val.clear();
+  } else if(part_size == 1) {
     out_key.swap(key[0]);
     out_val.swap(val[0]);
   } else if(part_size == 2) {
     set_merge_pair_desc(key[0], val[0], key[1], val[1], out_key, out_val);
   } else {
-    size_t next_part_size = ceil_div(part_size, size_t(2));
-    std::vector<std::vector<T>> key_left(next_part_size);
-    std::vector<std::vector<K>> val_left(next_part_size);
-    for(size_t i = 0; i < next_part_size; i++) {
-      key_left[i].swap(key[i]);
-      val_left[i].swap(val[i]);
-    }
-    std::vector<T> out_key_left;
-    std::vector<K> out_val_left;
-    set_multimerge_pair_desc(key_left, val_left, out_key_left, out_val_left);
-    std::vector<std::vector<T>> key_right(part_size - next_part_size);
-    std::vector<std::vector<K>> val_right(part_size - next_part_size);
-    for(size_t i = 0; i < part_size - next_part_size; i++) {
-      key_right[i].swap(key[i+next_part_size]);
-      val_right[i].swap(val[i+next_part_size]);
-    }
-    std::vector<T> out_key_right;
-    std::vector<K> out_val_right;
-    set_multimerge_pair_desc(key_right, val_right, out_key_right, 
-                             out_val_right);
-    set_merge_pair_desc(out_key_left, out_val_left, out_key_right, 
-                        out_val_right, out_key, out_val);
+    set_multimerge_pair_helper(key, val, out_key, out_val,
+                               std::greater<T>());
   }
 }
 
-
 template <class T>
 void
 set_multimerge(std::vector<std::vector<T>>& key,  // destructive
                std::vector<T>& out) {
   auto way = key.size();
-  auto step = 1;
-  while(step < way) {
-    for(size_t i = 0; i < way; i+=step*2) {
-      if(i + step < way)
-        key[i] = set_merge(key[i], key[i+step]);
-    }
-    step *= 2;
-  }
-  out.swap(key[0]);
+  if(way == 0) out.clear();
+  else if(way == 1) out.swap(key[0]);
+  else if(way == 2) out = set_merge(key[0], key[1]);
+  else set_multimerge_helper(key, out, std::less<T>());
 }
 
 template <class T>
@@ -1879,15 +4490,10 @@ void
 set_multimerge_desc(std::vector<std::vector<T>>& key, 
                     std::vector<T>& out) {
   auto way = key.size();
-  auto step = 1;
-  while(step < way) {
-    for(size_t i = 0; i < way; i+=step*2) {
-      if(i + step < way)
-        key[i] = set_merge_desc(key[i], key[i+step]);
-    }
-    step *= 2;
-  }
-  out.swap(key[0]);
+  if(way == 0) out.clear();
+  else if(way == 1) out.swap(key[0]);
+  else if(way == 2) out = set_merge_desc(key[0], key[1]);
+  else set_multimerge_helper(key, out, std::greater<T>());
 }
 
 }  
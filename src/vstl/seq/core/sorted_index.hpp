@@ -0,0 +1,194 @@
+#ifndef SORTED_INDEX_HPP
+#define SORTED_INDEX_HPP
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstddef>
+#include <stdint.h>
+
+#if defined(_SX) || defined(__ve__)
+#define SORTED_INDEX_VLEN 256
+#else
+#define SORTED_INDEX_VLEN 32 // queries searched at the same time
+// prefetch only if the tree is larger than this (bytes); otherwise
+// searching SORTED_INDEX_VLEN queries at the same time is enough
+#define SORTED_INDEX_PREFETCH_MIN (4 * 1024 * 1024)
+#endif
+#define SORTED_INDEX_LINE_SIZE 64 // bytes; the tree is aligned to this
+
+namespace vstl {
+namespace seq {
+
+// Index of sorted data for repeated lower_bound / upper_bound.
+// The data are stored in Eytzinger (BFS) layout: node k has children
+// 2k and 2k+1, and the root is 1. Since a query goes down one level
+// per iteration without branch, SORTED_INDEX_VLEN queries are searched
+// level by level at the same time; on x86, the nodes 4 levels below
+// (for 4 byte type), which share one cache line, are prefetched if the
+// tree does not fit in the cache.
+// The position in the sorted data is calculated from the node,
+// so only the tree is stored.
+template <class T>
+class sorted_index {
+public:
+  sorted_index() : num_values(0), num_levels(0), offset(0) {}
+  sorted_index(const std::vector<T>& sorted);
+  sorted_index(const T* sortedp, size_t size);
+  void lower_bound(const T* to_find, size_t to_find_size,
+                   size_t* ret) const;
+  std::vector<size_t> lower_bound(const std::vector<T>& to_find) const;
+  void upper_bound(const T* to_find, size_t to_find_size,
+                   size_t* ret) const;
+  std::vector<size_t> upper_bound(const std::vector<T>& to_find) const;
+  size_t size() const {return num_values;}
+private:
+  void build(const T* sortedp, size_t size);
+  template <class C>
+  void search(const T* to_find, size_t to_find_size, size_t* ret,
+              C go_right) const;
+  // position of node k at level in the full tree of num_levels
+  size_t full_position(size_t k, size_t level) const {
+    return ((2 * k + 1) << (num_levels - 1 - level))
+      - (size_t(1) << num_levels) - 1;
+  }
+  // skip the positions of the nodes missing from the last level
+  size_t skip_missing(size_t full) const {
+    size_t last_end = 2 * (num_values + 1 - (size_t(1) << (num_levels - 1)));
+    size_t missing = full > last_end ? (full - last_end + 1) / 2 : 0;
+    return full - missing;
+  }
+  size_t num_values;
+  size_t num_levels;
+  size_t offset; // tree.data() + offset is aligned; its [1, size] is used
+  std::vector<T> tree;
+};
+
+template <class T>
+sorted_index<T>::sorted_index(const std::vector<T>& sorted) :
+  num_values(0), num_levels(0), offset(0) {
+  build(sorted.data(), sorted.size());
+}
+
+template <class T>
+sorted_index<T>::sorted_index(const T* sortedp, size_t size) :
+  num_values(0), num_levels(0), offset(0) {
+  build(sortedp, size);
+}
+
+// each level is built independently; the loop is vectorized
+template <class T>
+void sorted_index<T>::build(const T* sortedp, size_t size) {
+  num_values = size;
+  if(size == 0) return;
+  num_levels = 0;
+  auto tmp = size;
+  while(tmp) {++num_levels; tmp >>= 1;}
+  size_t line_elms = SORTED_INDEX_LINE_SIZE / sizeof(T);
+  if(line_elms == 0) line_elms = 1;
+  tree.resize(size + 1 + line_elms);
+  auto misalign = reinterpret_cast<uintptr_t>(tree.data()) %
+    SORTED_INDEX_LINE_SIZE;
+  offset = misalign == 0 ? 0 :
+    (SORTED_INDEX_LINE_SIZE - misalign) / sizeof(T);
+  auto treep = tree.data() + offset;
+  treep[0] = sortedp[0]; // not used
+  for(size_t level = 0; level < num_levels; level++) {
+    size_t begin = size_t(1) << level;
+    size_t end = std::min(size_t(2) << level, size + 1);
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t k = begin; k < end; k++) {
+      treep[k] = sortedp[skip_missing(full_position(k, level))];
+    }
+  }
+}
+
+// go_right(node, value) is true if the result is right of the node.
+// Nodes out of the tree are treated as go_right, so that all queries
+// use num_levels iterations; then the node at the last level minus
+// 2^num_levels is the position in the full tree of the result.
+template <class T>
+template <class C>
+void sorted_index<T>::search(const T* to_find, size_t to_find_size,
+                             size_t* ret, C go_right) const {
+  if(num_values == 0) {
+    for(size_t i = 0; i < to_find_size; i++) ret[i] = 0;
+    return;
+  }
+  auto treep = tree.data() + offset;
+  size_t n = num_values;
+  size_t levels = num_levels;
+  size_t last_node = size_t(1) << levels;
+#if !defined(_SX) && !defined(__ve__)
+  size_t line_elms = SORTED_INDEX_LINE_SIZE / sizeof(T);
+  if(line_elms == 0) line_elms = 1;
+  bool prefetch = n * sizeof(T) > SORTED_INDEX_PREFETCH_MIN;
+#endif
+  size_t node[SORTED_INDEX_VLEN];
+#pragma _NEC vreg(node)
+  T values[SORTED_INDEX_VLEN];
+#pragma _NEC vreg(values)
+  for(size_t start = 0; start < to_find_size; start += SORTED_INDEX_VLEN) {
+    size_t len = std::min(to_find_size - start, size_t(SORTED_INDEX_VLEN));
+    auto crnt_to_find = to_find + start;
+    auto crnt_ret = ret + start;
+    for(size_t j = 0; j < len; j++) {
+      node[j] = 1;
+      values[j] = crnt_to_find[j];
+    }
+    // only the last level has nodes out of the tree
+    for(size_t level = 0; level + 1 < levels; level++) {
+#pragma _NEC ivdep
+      for(size_t j = 0; j < len; j++) {
+        size_t k = node[j];
+        node[j] = 2 * k + go_right(treep[k], values[j]);
+#if !defined(_SX) && !defined(__ve__)
+        if(prefetch) __builtin_prefetch(treep + node[j] * line_elms);
+#endif
+      }
+    }
+#pragma _NEC ivdep
+    for(size_t j = 0; j < len; j++) {
+      size_t k = node[j];
+      int out_tree = k > n; // bitwise or below, to avoid branch
+      size_t safe_k = out_tree ? 0 : k;
+      node[j] = 2 * k + (out_tree | go_right(treep[safe_k], values[j]));
+    }
+    for(size_t j = 0; j < len; j++) {
+      crnt_ret[j] = skip_missing(node[j] - last_node);
+    }
+  }
+}
+
+template <class T>
+void sorted_index<T>::lower_bound(const T* to_find, size_t to_find_size,
+                                  size_t* ret) const {
+  search(to_find, to_find_size, ret, std::less<T>());
+}
+
+template <class T>
+std::vector<size_t>
+sorted_index<T>::lower_bound(const std::vector<T>& to_find) const {
+  std::vector<size_t> ret(to_find.size());
+  lower_bound(to_find.data(), to_find.size(), ret.data());
+  return ret;
+}
+
+template <class T>
+void sorted_index<T>::upper_bound(const T* to_find, size_t to_find_size,
+                                  size_t* ret) const {
+  search(to_find, to_find_size, ret, std::less_equal<T>());
+}
+
+template <class T>
+std::vector<size_t>
+sorted_index<T>::upper_bound(const std::vector<T>& to_find) const {
+  std::vector<size_t> ret(to_find.size());
+  upper_bound(to_find.data(), to_find.size(), ret.data());
+  return ret;
+}
+
+}
+}
+#endif
@@ -0,0 +1,357 @@
+#ifndef STATIC_BTREE_HPP
+#define STATIC_BTREE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstddef>
+#include <stdint.h>
+
+#if defined(_SX) || defined(__ve__)
+#define STATIC_BTREE_VLEN 256
+#else
+#define STATIC_BTREE_VLEN 64 // queries searched at the same time
+#endif
+#define STATIC_BTREE_NODE_SIZE 16 // keys per node
+#define STATIC_BTREE_ALIGN 64 // bytes; the nodes are aligned to this
+
+namespace vstl {
+namespace seq {
+
+// Static B+-tree of sorted data for repeated lower_bound / upper_bound.
+// A node has STATIC_BTREE_NODE_SIZE keys and STATIC_BTREE_NODE_SIZE + 1
+// children; the leaf layer is the sorted data itself, and the key i of
+// an internal node is the first value of its child i + 1. At each
+// level, the child is given by the number of keys less than the value,
+// which is counted by a fixed length loop that is vectorized (x86;
+// the loop is kept rolled, otherwise it is unrolled into scalar
+// compares before vectorization, and the next node is prefetched),
+// or by vectorizing multiple queries (VE). The layers are padded with
+// the last value, and a child beyond the layer means the result is the
+// end; it is clamped to the last node.
+template <class T>
+class static_btree {
+public:
+  static_btree() : num_values(0), offset(0) {}
+  static_btree(const std::vector<T>& sorted);
+  static_btree(const T* sortedp, size_t size);
+  void lower_bound(const T* to_find, size_t to_find_size,
+                   size_t* ret) const;
+  std::vector<size_t> lower_bound(const std::vector<T>& to_find) const;
+  void upper_bound(const T* to_find, size_t to_find_size,
+                   size_t* ret) const;
+  std::vector<size_t> upper_bound(const std::vector<T>& to_find) const;
+  void equal_range(const T* to_find, size_t to_find_size,
+                   size_t* lower, size_t* upper) const;
+  void equal_range(const std::vector<T>& to_find,
+                   std::vector<size_t>& lower,
+                   std::vector<size_t>& upper) const;
+  size_t size() const {return num_values;}
+private:
+  void build(const T* sortedp, size_t size);
+  template <class C>
+  void search(const T* to_find, size_t to_find_size, size_t* ret,
+              C go_right) const;
+  void search_range(const T* to_find, size_t to_find_size,
+                    size_t* lower, size_t* upper) const;
+  size_t num_values;
+  size_t offset; // tree.data() + offset is aligned
+  // from the root; layer_start is in nodes, the last one is the leaves
+  std::vector<size_t> layer_start;
+  std::vector<size_t> layer_nodes;
+  std::vector<T> tree;
+};
+
+template <class T>
+static_btree<T>::static_btree(const std::vector<T>& sorted) :
+  num_values(0), offset(0) {
+  build(sorted.data(), sorted.size());
+}
+
+template <class T>
+static_btree<T>::static_btree(const T* sortedp, size_t size) :
+  num_values(0), offset(0) {
+  build(sortedp, size);
+}
+
+template <class T>
+void static_btree<T>::build(const T* sortedp, size_t size) {
+  num_values = size;
+  if(size == 0) return;
+  const size_t B = STATIC_BTREE_NODE_SIZE;
+  // number of nodes of each layer from the leaves
+  std::vector<size_t> nodes;
+  nodes.push_back((size + B - 1) / B);
+  while(nodes.back() > 1) {
+    nodes.push_back((nodes.back() + B) / (B + 1));
+  }
+  size_t num_layers = nodes.size();
+  layer_start.resize(num_layers);
+  layer_nodes.resize(num_layers);
+  size_t total = 0;
+  for(size_t h = 0; h < num_layers; h++) {
+    layer_start[h] = total;
+    layer_nodes[h] = nodes[num_layers - 1 - h];
+    total += layer_nodes[h];
+  }
+  size_t align_elms = STATIC_BTREE_ALIGN / sizeof(T);
+  if(align_elms == 0) align_elms = 1;
+  tree.resize(total * B + align_elms);
+  auto misalign = reinterpret_cast<uintptr_t>(tree.data()) %
+    STATIC_BTREE_ALIGN;
+  offset = misalign == 0 ? 0 : (STATIC_BTREE_ALIGN - misalign) / sizeof(T);
+  auto treep = tree.data() + offset;
+  auto last = sortedp[size - 1];
+
+  auto leafp = treep + layer_start[num_layers - 1] * B;
+  size_t leaf_size = layer_nodes[num_layers - 1] * B;
+  for(size_t i = 0; i < size; i++) leafp[i] = sortedp[i];
+  for(size_t i = size; i < leaf_size; i++) leafp[i] = last;
+  // key i of node k is the first value of the leftmost leaf below
+  // its child k * (B + 1) + i + 1; leaves_below is the number of
+  // leaves below one node of the child layer
+  size_t leaves_below = 1;
+  for(size_t h = num_layers - 1; h > 0; h--) {
+    auto layerp = treep + layer_start[h - 1] * B;
+    size_t layer_size = layer_nodes[h - 1] * B;
+#pragma cdir nodep
+#pragma _NEC ivdep
+    for(size_t i = 0; i < layer_size; i++) {
+      size_t k = i / B;
+      size_t child = k * (B + 1) + i % B + 1;
+      size_t pos = child * leaves_below * B;
+      layerp[i] = pos < size ? sortedp[pos] : last;
+    }
+    leaves_below *= B + 1;
+  }
+}
+
+// go_right(key, value) is true if the result is right of the key
+template <class T>
+template <class C>
+void static_btree<T>::search(const T* to_find, size_t to_find_size,
+                             size_t* ret, C go_right) const {
+  if(num_values == 0) {
+    for(size_t i = 0; i < to_find_size; i++) ret[i] = 0;
+    return;
+  }
+  const size_t B = STATIC_BTREE_NODE_SIZE;
+  auto treep = tree.data() + offset;
+  size_t n = num_values;
+  size_t num_layers = layer_start.size();
+  auto layer_startp = layer_start.data();
+  auto layer_nodesp = layer_nodes.data();
+  size_t node[STATIC_BTREE_VLEN];
+#pragma _NEC vreg(node)
+  T values[STATIC_BTREE_VLEN];
+#pragma _NEC vreg(values)
+  for(size_t start = 0; start < to_find_size; start += STATIC_BTREE_VLEN) {
+    size_t len = std::min(to_find_size - start, size_t(STATIC_BTREE_VLEN));
+    auto crnt_to_find = to_find + start;
+    auto crnt_ret = ret + start;
+    for(size_t j = 0; j < len; j++) {
+      node[j] = 0;
+      values[j] = crnt_to_find[j];
+    }
+    for(size_t h = 0; h < num_layers; h++) {
+      auto layerp = treep + layer_startp[h] * B;
+      size_t last_child = h + 1 < num_layers ? layer_nodesp[h + 1] - 1 : 0;
+      bool is_leaf = h + 1 == num_layers;
+#if defined(_SX) || defined(__ve__)
+      size_t count[STATIC_BTREE_VLEN];
+#pragma _NEC vreg(count)
+      for(size_t j = 0; j < len; j++) count[j] = 0;
+      for(size_t i = 0; i < B; i++) {
+#pragma _NEC ivdep
+        for(size_t j = 0; j < len; j++) {
+          count[j] += go_right(layerp[node[j] * B + i], values[j]);
+        }
+      }
+#pragma _NEC ivdep
+      for(size_t j = 0; j < len; j++) {
+        if(is_leaf) node[j] = node[j] * B + count[j];
+        else node[j] = std::min(node[j] * (B + 1) + count[j], last_child);
+      }
+#else
+      int count[STATIC_BTREE_VLEN]; // narrower than size_t to vectorize
+      for(size_t j = 0; j < len; j++) {
+        auto keyp = layerp + node[j] * B;
+        auto value = values[j];
+        int crnt_count = 0;
+#pragma GCC unroll 1
+        for(size_t i = 0; i < B; i++) crnt_count += go_right(keyp[i], value);
+        count[j] = crnt_count;
+      }
+      if(is_leaf) {
+        for(size_t j = 0; j < len; j++) node[j] = node[j] * B + count[j];
+      } else {
+        auto nextp = treep + layer_startp[h + 1] * B;
+        for(size_t j = 0; j < len; j++) {
+          node[j] = std::min(node[j] * (B + 1) + count[j], last_child);
+          __builtin_prefetch(nextp + node[j] * B);
+        }
+      }
+#endif
+    }
+    for(size_t j = 0; j < len; j++) {
+      crnt_ret[j] = std::min(node[j], n);
+    }
+  }
+}
+
+// lower_bound and upper_bound in one descent: the child of each is the
+// number of keys < and <= the value. They are counted from the same
+// node until the two paths split, which is at most one node per layer.
+template <class T>
+void static_btree<T>::search_range(const T* to_find, size_t to_find_size,
+                                   size_t* lower, size_t* upper) const {
+  if(num_values == 0) {
+    for(size_t i = 0; i < to_find_size; i++) {
+      lower[i] = 0;
+      upper[i] = 0;
+    }
+    return;
+  }
+  const size_t B = STATIC_BTREE_NODE_SIZE;
+  auto treep = tree.data() + offset;
+  size_t n = num_values;
+  size_t num_layers = layer_start.size();
+  auto layer_startp = layer_start.data();
+  auto layer_nodesp = layer_nodes.data();
+  size_t lo_node[STATIC_BTREE_VLEN];
+#pragma _NEC vreg(lo_node)
+  size_t hi_node[STATIC_BTREE_VLEN];
+#pragma _NEC vreg(hi_node)
+  T values[STATIC_BTREE_VLEN];
+#pragma _NEC vreg(values)
+  for(size_t start = 0; start < to_find_size; start += STATIC_BTREE_VLEN) {
+    size_t len = std::min(to_find_size - start, size_t(STATIC_BTREE_VLEN));
+    auto crnt_to_find = to_find + start;
+    for(size_t j = 0; j < len; j++) {
+      lo_node[j] = 0;
+      hi_node[j] = 0;
+      values[j] = crnt_to_find[j];
+    }
+    for(size_t h = 0; h < num_layers; h++) {
+      auto layerp = treep + layer_startp[h] * B;
+      size_t last_child = h + 1 < num_layers ? layer_nodesp[h + 1] - 1 : 0;
+      bool is_leaf = h + 1 == num_layers;
+#if defined(_SX) || defined(__ve__)
+      size_t lo_count[STATIC_BTREE_VLEN];
+#pragma _NEC vreg(lo_count)
+      size_t hi_count[STATIC_BTREE_VLEN];
+#pragma _NEC vreg(hi_count)
+      for(size_t j = 0; j < len; j++) {
+        lo_count[j] = 0;
+        hi_count[j] = 0;
+      }
+      for(size_t i = 0; i < B; i++) {
+#pragma _NEC ivdep
+        for(size_t j = 0; j < len; j++) {
+          auto lo_key = layerp[lo_node[j] * B + i];
+          auto hi_key = hi_node[j] == lo_node[j] ? lo_key :
+            layerp[hi_node[j] * B + i];
+          lo_count[j] += lo_key < values[j];
+          hi_count[j] += hi_key <= values[j];
+        }
+      }
+#pragma _NEC ivdep
+      for(size_t j = 0; j < len; j++) {
+        if(is_leaf) {
+          lo_node[j] = lo_node[j] * B + lo_count[j];
+          hi_node[j] = hi_node[j] * B + hi_count[j];
+        } else {
+          lo_node[j] = std::min(lo_node[j] * (B + 1) + lo_count[j],
+                                last_child);
+          hi_node[j] = std::min(hi_node[j] * (B + 1) + hi_count[j],
+                                last_child);
+        }
+      }
+#else
+      int lo_count[STATIC_BTREE_VLEN];
+      int hi_count[STATIC_BTREE_VLEN];
+      for(size_t j = 0; j < len; j++) {
+        auto lo_keyp = layerp + lo_node[j] * B;
+        auto hi_keyp = layerp + hi_node[j] * B; // same line until split
+        auto value = values[j];
+        int crnt_lo_count = 0, crnt_hi_count = 0;
+#pragma GCC unroll 1
+        for(size_t i = 0; i < B; i++) {
+          crnt_lo_count += lo_keyp[i] < value;
+          crnt_hi_count += hi_keyp[i] <= value;
+        }
+        lo_count[j] = crnt_lo_count;
+        hi_count[j] = crnt_hi_count;
+      }
+      if(is_leaf) {
+        for(size_t j = 0; j < len; j++) {
+          lo_node[j] = lo_node[j] * B + lo_count[j];
+          hi_node[j] = hi_node[j] * B + hi_count[j];
+        }
+      } else {
+        auto nextp = treep + layer_startp[h + 1] * B;
+        for(size_t j = 0; j < len; j++) {
+          lo_node[j] = std::min(lo_node[j] * (B + 1) + lo_count[j],
+                                last_child);
+          hi_node[j] = std::min(hi_node[j] * (B + 1) + hi_count[j],
+                                last_child);
+          __builtin_prefetch(nextp + lo_node[j] * B);
+          if(hi_node[j] != lo_node[j])
+            __builtin_prefetch(nextp + hi_node[j] * B);
+        }
+      }
+#endif
+    }
+    for(size_t j = 0; j < len; j++) {
+      lower[start + j] = std::min(lo_node[j], n);
+      upper[start + j] = std::min(hi_node[j], n);
+    }
+  }
+}
+
+template <class T>
+void static_btree<T>::lower_bound(const T* to_find, size_t to_find_size,
+                                  size_t* ret) const {
+  search(to_find, to_find_size, ret, std::less<T>());
+}
+
+template <class T>
+std::vector<size_t>
+static_btree<T>::lower_bound(const std::vector<T>& to_find) const {
+  std::vector<size_t> ret(to_find.size());
+  lower_bound(to_find.data(), to_find.size(), ret.data());
+  return ret;
+}
+
+template <class T>
+void static_btree<T>::upper_bound(const T* to_find, size_t to_find_size,
+                                  size_t* ret) const {
+  search(to_find, to_find_size, ret, std::less_equal<T>());
+}
+
+template <class T>
+std::vector<size_t>
+static_btree<T>::upper_bound(const std::vector<T>& to_find) const {
+  std::vector<size_t> ret(to_find.size());
+  upper_bound(to_find.data(), to_find.size(), ret.data());
+  return ret;
+}
+
+template <class T>
+void static_btree<T>::equal_range(const T* to_find, size_t to_find_size,
+                                  size_t* lower, size_t* upper) const {
+  search_range(to_find, to_find_size, lower, upper);
+}
+
+template <class T>
+void static_btree<T>::equal_range(const std::vector<T>& to_find,
+                                  std::vector<size_t>& lower,
+                                  std::vector<size_t>& upper) const {
+  lower.resize(to_find.size());
+  upper.resize(to_find.size());
+  equal_range(to_find.data(), to_find.size(), lower.data(), upper.data());
+}
+
+}
+}
+#endif